@@ -9,7 +9,8 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 /// \file include/mpi_dispatcher/mpi_dispatcher.hpp
-/// \brief A master-worker parallelization scheme using non-blocking MPI communications.
+/// \brief A master-worker parallelization scheme using non-blocking MPI communications
+///        and a decentralized dispatcher based on one-sided MPI communications.
 /// \author Andrey Antipov (andrey.e.antipov@gmail.com)
 /// \author Igor Krivenko (igor.s.krivenko@gmail.com)
 
@@ -136,6 +137,58 @@ private:
     void fill_stack_();
 };
 
+/// \brief Decentralized job dispatcher.
+///
+/// Processes claim jobs themselves by atomically incrementing a shared counter, which is stored
+/// in an MPI window on the root process and is updated with MPI_Fetch_and_op(). Unlike with
+/// \ref MPIMaster, no process has to poll for and respond to requests of the other processes.
+/// Jobs are claimed in the order of the list passed to the constructor.
+///
+/// Construction, \ref gather_dispatch_map() and destruction are collective operations.
+struct MPIJobCounter {
+    /// MPI communicator.
+    MPI_Comm Comm;
+    /// Rank of the process storing the counter.
+    int const root;
+    /// A list of IDs of all jobs to be completed in the order they are claimed.
+    std::vector<JobId> task_numbers;
+    /// A mapping from job IDs to IDs of the workers that have claimed the jobs
+    /// (filled by \ref gather_dispatch_map()).
+    std::map<JobId, WorkerId> DispatchMap;
+
+    /// Constructor.
+    /// \param[in] Comm MPI communicator to duplicate.
+    /// \param[in] task_numbers A list of IDs of all jobs to be completed in the order they are to be claimed.
+    /// \param[in] root Rank of the process to store the counter.
+    MPIJobCounter(MPI_Comm const& Comm, std::vector<JobId> task_numbers, int root = 0);
+    MPIJobCounter(MPIJobCounter const&) = delete;
+    MPIJobCounter& operator=(MPIJobCounter const&) = delete;
+    /// Destructor.
+    ~MPIJobCounter();
+
+    /// Claim the next job.
+    /// \param[out] job ID of the claimed job.
+    /// \return false if all jobs have already been claimed.
+    bool claim(JobId& job);
+
+    /// Wait until all processes have claimed their last jobs and fill \ref DispatchMap
+    /// on all processes.
+    /// \return Reference to \ref DispatchMap.
+    std::map<JobId, WorkerId> const& gather_dispatch_map();
+
+private:
+    // MPI window exposing the counter
+    MPI_Win Win;
+    // The counter (only allocated on the root process)
+    long* Counter = nullptr;
+    // Positions of the jobs claimed by this process in task_numbers
+    std::vector<long> Claimed;
+    // Has this process found the counter exhausted?
+    bool Exhausted = false;
+    // Is the passive target access epoch open?
+    bool Locked = false;
+};
+
 ///@}
 
 } // namespace pMPI
@@ -23,9 +23,7 @@
 #include <cstddef>
 #include <iostream>
 #include <map>
-#include <memory>
 #include <numeric>
-#include <tuple>
 #include <vector>
 
 namespace pMPI {
@@ -69,9 +67,30 @@ template <typename PartType> struct PrepareWrap {
     void run() { x.prepare(); }
 };
 
-/// \brief This structure carries a list of wrappers and uses the mpi_dispatcher mechanism
+/// \brief Wrapper around a computable object that calls the prepare() and compute() methods
+/// of the wrapped object and carries information about the complexity of these calls.
+/// \tparam PartType Type of the wrapped object.
+template <typename PartType> struct PrepareAndComputeWrap {
+    /// Reference to the wrapped object.
+    PartType& x;
+    /// Complexity of calls to x.prepare() and x.compute().
+    int complexity;
+
+    PrepareAndComputeWrap() = default;
+    /// Constructor.
+    /// \param[in] x Reference to the wrapped object.
+    /// \param[in] complexity Complexity of calls to x.prepare() and x.compute().
+    explicit PrepareAndComputeWrap(PartType& x, int complexity = 1) : x(x), complexity(complexity) {}
+    /// Call prepare() and compute() of the wrapped object \ref x.
+    void run() {
+        x.prepare();
+        x.compute();
+    }
+};
+
+/// \brief This structure carries a list of wrappers and uses the decentralized dispatcher \ref MPIJobCounter
 /// to distribute the wrappers over MPI ranks and to call run() for all of them in parallel.
-/// \tparam WrapType Type of the wrappers, one of \ref PrepareWrap and \ref ComputeWrap.
+/// \tparam WrapType Type of the wrappers, one of \ref PrepareWrap, \ref ComputeWrap and \ref PrepareAndComputeWrap.
 template <typename WrapType> struct mpi_skel {
     /// List of wrappers
     std::vector<WrapType> parts;
@@ -88,77 +107,32 @@ std::map<pMPI::JobId, pMPI::WorkerId> mpi_skel<WrapType>::run(MPI_Comm const& Co
     int comm_rank = pMPI::rank(Comm);
     int comm_size = pMPI::size(Comm);
     int const root = 0;
-    MPI_Barrier(Comm);
 
     if(comm_rank == root) {
         std::cout << "Calculating " << parts.size() << " jobs using " << comm_size << " procs." << std::endl;
     }
 
-    std::unique_ptr<pMPI::MPIMaster> disp;
-
-    if(comm_rank == root) {
-        // prepare one Master on a root process for distributing parts.size() jobs
-        std::vector<pMPI::JobId> job_order(parts.size());
-        std::iota(job_order.begin(), job_order.end(), 0);
-
-        auto comp1 = [this](std::size_t l, std::size_t r) -> int {
-            return (parts[l].complexity > parts[r].complexity);
-        };
-        std::sort(job_order.begin(), job_order.end(), comp1);
-        disp.reset(new pMPI::MPIMaster(Comm, job_order, true));
-    }
-
-    MPI_Barrier(Comm);
-
-    // Start calculating data
-    for(pMPI::MPIWorker worker(Comm, root); !worker.is_finished();) {
-        if(comm_rank == root)
-            disp->order();
-        worker.receive_order();
-        if(worker.is_working()) { // for a specific worker
-            JobId p = worker.current_job();
-            if(VerboseOutput)
-                std::cout << "[" << p + 1 << "/" << parts.size() << "] P" << comm_rank << " : part " << p << " ["
-                          << parts[p].complexity << "] run;" << std::endl;
-            parts[p].run();
-            worker.report_job_done();
-        }
-        if(comm_rank == root)
-            disp->check_workers(); // check if there are free workers
+    // All processes agree on the order in which the jobs are claimed: most complex first
+    std::vector<pMPI::JobId> job_order(parts.size());
+    std::iota(job_order.begin(), job_order.end(), 0);
+    std::stable_sort(job_order.begin(), job_order.end(), [this](pMPI::JobId l, pMPI::JobId r) {
+        return parts[l].complexity > parts[r].complexity;
+    });
+
+    // Processes claim jobs one by one until all of them are taken
+    pMPI::MPIJobCounter counter(Comm, job_order, root);
+    for(pMPI::JobId p; counter.claim(p);) {
+        if(VerboseOutput)
+            std::cout << "[" << p + 1 << "/" << parts.size() << "] P" << comm_rank << " : part " << p << " ["
+                      << parts[p].complexity << "] run;" << std::endl;
+        parts[p].run();
     }
 
-    // at this moment all communication is finished
-    MPI_Barrier(Comm);
     // Now spread the information, who did what.
+    std::map<pMPI::JobId, pMPI::WorkerId> job_map = counter.gather_dispatch_map();
     if(VerboseOutput && comm_rank == root)
         std::cout << "done." << std::endl;
 
-    MPI_Barrier(Comm);
-    std::map<pMPI::JobId, pMPI::WorkerId> job_map;
-    if(comm_rank == root) {
-        job_map = disp->DispatchMap;
-        long n_jobs = job_map.size();
-        std::vector<pMPI::JobId> jobs(n_jobs);
-        std::vector<pMPI::WorkerId> workers(n_jobs);
-
-        auto it = job_map.cbegin();
-        for(int i = 0; i < n_jobs; ++i, ++it) {
-            std::tie(jobs[i], workers[i]) = *it;
-        }
-
-        MPI_Bcast(&n_jobs, 1, MPI_LONG, root, Comm);
-        MPI_Bcast(jobs.data(), n_jobs, MPI_INT, root, Comm);
-        MPI_Bcast(workers.data(), n_jobs, MPI_INT, root, Comm);
-    } else {
-        long n_jobs;
-        MPI_Bcast(&n_jobs, 1, MPI_LONG, root, Comm);
-        std::vector<pMPI::JobId> jobs(n_jobs);
-        MPI_Bcast(jobs.data(), n_jobs, MPI_INT, root, Comm);
-        std::vector<pMPI::WorkerId> workers(n_jobs);
-        MPI_Bcast(workers.data(), n_jobs, MPI_INT, root, Comm);
-        for(std::size_t i = 0; i < n_jobs; ++i)
-            job_map[jobs[i]] = workers[i];
-    }
     return job_map;
 }
 
@@ -19,6 +19,7 @@
 #include "mpi_dispatcher/mpi_dispatcher.hpp"
 #include "mpi_dispatcher/mpi_skel.hpp"
 
+#include "pomerol/BinaryArchive.hpp"
 #include "pomerol/DensityMatrix.hpp"
 #include "pomerol/EnsembleAverage.hpp"
 #include "pomerol/FieldOperatorContainer.hpp"
@@ -34,6 +35,7 @@
 #include "pomerol/Susceptibility.hpp"
 #include "pomerol/TwoParticleGF.hpp"
 #include "pomerol/TwoParticleGFContainer.hpp"
+#include "pomerol/TwoParticleGFTerms.hpp"
 
 namespace Pomerol {
 
@@ -0,0 +1,164 @@
+//
+// This file is part of pomerol, an exact diagonalization library aimed at
+// solving condensed matter models of interacting fermions.
+//
+// Copyright (C) 2016-2021 A. Antipov, I. Krivenko and contributors
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// \file include/pomerol/BinaryArchive.hpp
+/// \brief Binary checkpoint files.
+/// \author Igor Krivenko (igor.s.krivenko@gmail.com)
+
+#ifndef POMEROL_INCLUDE_POMEROL_BINARYARCHIVE_HPP
+#define POMEROL_INCLUDE_POMEROL_BINARYARCHIVE_HPP
+
+#include "Misc.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Pomerol {
+
+/// \addtogroup Misc
+///@{
+
+/// \brief Binary checkpoint file opened for writing.
+///
+/// A checkpoint file starts with a header that identifies the format and its version, followed by
+/// a sequence of tagged sections written by the \p save() methods of the stored objects. Arrays within
+/// the sections (Fock state lists, eigenvalues, eigenvectors, matrix elements) are stored in the native
+/// binary representation and start at offsets that are multiples of \ref Alignment. This way they can be
+/// read with a single bulk operation directly into the memory of the loaded object, or memory-mapped.
+class BinaryOutputArchive {
+    /// The output file stream.
+    std::ofstream Stream;
+
+public:
+    /// Version of the checkpoint format.
+    static constexpr std::uint32_t FormatVersion = 1;
+    /// Alignment of sections and arrays within the file in bytes.
+    static constexpr std::size_t Alignment = 64;
+
+    /// Create a checkpoint file and write the header.
+    /// \param[in] FileName Name of the file.
+    explicit BinaryOutputArchive(std::string const& FileName);
+
+    /// Start a new section.
+    /// \param[in] Tag Name of the section (up to 8 characters).
+    void beginSection(std::string const& Tag);
+
+    /// Write a scalar value.
+    /// \tparam T Trivially copyable type of the value.
+    /// \param[in] Value The value.
+    template <typename T> void write(T const& Value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be written");
+        writeRaw(&Value, sizeof(T));
+    }
+
+    /// Write an array of values. Its size is stored, and the data starts at an aligned offset.
+    /// \tparam T Trivially copyable type of the elements.
+    /// \param[in] Data Pointer to the first element of the array.
+    /// \param[in] Size Number of elements in the array.
+    template <typename T> void writeArray(T const* Data, std::size_t Size) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be written");
+        beginArray(Size);
+        writeRaw(Data, Size * sizeof(T));
+    }
+
+    /// Start an array of values, whose elements are then written one by one with \ref write().
+    /// The result is indistinguishable from that of \ref writeArray().
+    /// \param[in] Size Number of elements in the array.
+    void beginArray(std::size_t Size) {
+        write(std::uint64_t(Size));
+        align();
+    }
+
+    /// Write a dense matrix.
+    /// \tparam C Whether the matrix is complex.
+    /// \param[in] M The matrix.
+    template <bool C> void writeDenseMatrix(MatrixType<C> const& M);
+
+    /// Write a sparse matrix with row-major storage.
+    /// \tparam C Whether the matrix is complex.
+    /// \param[in] M The matrix.
+    template <bool C> void writeSparseMatrix(RowMajorMatrixType<C> const& M);
+
+private:
+    void writeRaw(void const* Data, std::size_t Size);
+    void align();
+};
+
+/// \brief Binary checkpoint file opened for reading.
+///
+/// Read counterpart of \ref BinaryOutputArchive. All methods throw \p std::runtime_error if the file
+/// is truncated, has an unsupported format or does not have the expected structure.
+class BinaryInputArchive {
+    /// The input file stream.
+    std::ifstream Stream;
+
+public:
+    /// Open a checkpoint file and check the header.
+    /// \param[in] FileName Name of the file.
+    explicit BinaryInputArchive(std::string const& FileName);
+
+    /// Read the beginning of a section and check its name.
+    /// \param[in] Tag Expected name of the section.
+    void beginSection(std::string const& Tag);
+
+    /// Read a scalar value.
+    /// \tparam T Trivially copyable type of the value.
+    template <typename T> T read() {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be read");
+        T Value;
+        readRaw(&Value, sizeof(T));
+        return Value;
+    }
+
+    /// Read the size of an array written by \ref BinaryOutputArchive::writeArray().
+    /// It must be followed by a call to \ref readArrayData().
+    std::size_t readArraySize();
+
+    /// Read the elements of an array.
+    /// \tparam T Trivially copyable type of the elements.
+    /// \param[out] Data Pointer to the memory for the elements.
+    /// \param[in] Size Number of elements returned by the preceding call to \ref readArraySize().
+    template <typename T> void readArrayData(T* Data, std::size_t Size) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be read");
+        align();
+        readRaw(Data, Size * sizeof(T));
+    }
+
+    /// Read an array into a vector.
+    /// \tparam T Trivially copyable type of the elements.
+    template <typename T> std::vector<T> readVector() {
+        std::vector<T> V(readArraySize());
+        readArrayData(V.data(), V.size());
+        return V;
+    }
+
+    /// Read a dense matrix.
+    /// \tparam C Whether the matrix is complex.
+    template <bool C> MatrixType<C> readDenseMatrix();
+
+    /// Read a sparse matrix with row-major storage.
+    /// \tparam C Whether the matrix is complex.
+    template <bool C> RowMajorMatrixType<C> readSparseMatrix();
+
+private:
+    void readRaw(void* Data, std::size_t Size);
+    void align();
+};
+
+///@}
+
+} // namespace Pomerol
+
+#endif // #ifndef POMEROL_INCLUDE_POMEROL_BINARYARCHIVE_HPP
@@ -85,8 +85,24 @@ public:
     /// Does a given block contain any non-negligible statistical weights?
     /// \param[in] B Index of the part (block).
     bool isRetained(BlockNumber B) const;
+
+    friend std::vector<DensityMatrix>
+    ComputeDensityMatrices(StatesClassification const& S, Hamiltonian const& H, std::vector<RealType> const& betas);
 };
 
+/// Compute many-body Gibbs density matrices for a list of inverse temperatures.
+/// The energy spectrum of the Hamiltonian is traversed once for all temperatures.
+/// Together with \ref GreensFunction::GreensFunction(GreensFunction const&, DensityMatrix const&) and
+/// \ref Susceptibility::Susceptibility(Susceptibility const&, DensityMatrix const&), this allows for
+/// temperature scans that diagonalize the Hamiltonian and compute matrix elements only once.
+/// \param[in] S Information about invariant subspaces of the Hamiltonian.
+/// \param[in] H The Hamiltonian \f$\hat H\f$.
+/// \param[in] betas List of inverse temperatures \f$\beta\f$.
+/// \return List of computed density matrices, one per element of \p betas.
+/// \pre \p H has been computed.
+std::vector<DensityMatrix>
+ComputeDensityMatrices(StatesClassification const& S, Hamiltonian const& H, std::vector<RealType> const& betas);
+
 ///@}
 
 } // namespace Pomerol
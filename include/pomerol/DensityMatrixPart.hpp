@@ -66,6 +66,11 @@ public:
     /// Compute and store the unnormalized statistical weights \f$Z w_s\f$.
     RealType computeUnnormalized();
 
+    /// Compute and store the unnormalized statistical weights \f$Z w_s\f$ from precomputed
+    /// excitation energies.
+    /// \param[in] ExcitationEnergies Energy levels of this block counted from the ground state energy.
+    RealType computeUnnormalized(RealVectorType const& ExcitationEnergies);
+
     /// Normalize the stored statistical weights by the partition function \f$Z\f$.
     /// \param[in] Z The partition function.
     void normalize(RealType Z);
@@ -16,6 +16,7 @@
 #ifndef POMEROL_INCLUDE_POMEROL_FIELDOPERATORCONTAINER_HPP
 #define POMEROL_INCLUDE_POMEROL_FIELDOPERATORCONTAINER_HPP
 
+#include "BinaryArchive.hpp"
 #include "Hamiltonian.hpp"
 #include "IndexClassification.hpp"
 #include "Misc.hpp"
@@ -80,8 +81,32 @@ public:
     }
 
     /// Compute all stored creation and annihilation operators.
+    /// Parts of all creation operators are distributed among MPI processes and,
+    /// in a single-process run with OpenMP enabled, among threads.
+    /// Annihilation operators are obtained as Hermitian conjugates of the creation operators.
+    /// \param[in] comm MPI communicator used to parallelize the computation.
     /// \pre \ref prepareAll() has been called.
-    void computeAll();
+    void computeAll(MPI_Comm const& comm = MPI_COMM_WORLD);
+
+    /// Free memory occupied by the sparse matrices made by conversion of the canonical
+    /// row-major matrices of all stored operators (see \ref MonomialOperatorPart::releaseConversions()).
+    /// Only the row-major matrices of the creation operators are kept.
+    void releaseConversions();
+
+    /// Write matrix elements of all stored creation operators to a checkpoint file.
+    /// \param[in] ar The checkpoint file.
+    /// \pre \ref computeAll() has been called.
+    void saveAll(BinaryOutputArchive& ar) const;
+
+    /// Read matrix elements of creation operators from a checkpoint file written by \ref saveAll(),
+    /// and obtain the annihilation operators as their Hermitian conjugates. This is an alternative to
+    /// \ref computeAll(). Operators absent from the file are left untouched.
+    /// \param[in] ar The checkpoint file.
+    /// \pre \ref prepareAll() has been called.
+    void loadAll(BinaryInputArchive& ar);
+
+    /// Return the set of single-particle indices for which the operators are stored.
+    std::set<ParticleIndex> getIndices() const;
 
     /// Return a reference to a creation operator by its single-particle index.
     /// \param[in] in Single-particle index.
@@ -89,6 +114,10 @@ public:
     /// Return a reference to a annihilation operator by its single-particle index.
     /// \param[in] in Single-particle index.
     AnnihilationOperator const& getAnnihilationOperator(ParticleIndex in) const;
+
+private:
+    // Set parts of an annihilation operator from those of the conjugate creation operator
+    static void setFromAdjoint(AnnihilationOperator& c, CreationOperator const& cdag);
 };
 
 ///@}
@@ -0,0 +1,439 @@
+//
+// This file is part of pomerol, an exact diagonalization library aimed at
+// solving condensed matter models of interacting fermions.
+//
+// Copyright (C) 2016-2021 A. Antipov, I. Krivenko and contributors
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// \file include/pomerol/FrozenTerms.hpp
+/// \brief Structure-of-arrays storage of terms of a two-particle Green's function part.
+/// \author Igor Krivenko (igor.s.krivenko@gmail.com)
+
+#ifndef POMEROL_INCLUDE_FROZENTERMS_HPP
+#define POMEROL_INCLUDE_FROZENTERMS_HPP
+
+#include "BinaryArchive.hpp"
+#include "Misc.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace Pomerol {
+
+/// \addtogroup 2PGF
+///@{
+
+/// Triplet of complex frequencies.
+using FreqTuple = std::tuple<ComplexType, ComplexType, ComplexType>;
+/// List of complex frequency triplets.
+using FreqVec = std::vector<FreqTuple>;
+
+/// \brief A list of complex frequency triplets in the structure-of-arrays form.
+///
+/// Real and imaginary parts of frequencies \f$z_1, z_2, z_3\f$, as well as of their
+/// combinations \f$z_1+z_2\f$, \f$z_2+z_3\f$ and \f$z_1+z_2+z_3\f$, are stored in separate
+/// contiguous arrays. This is the form of the frequency list expected by the evaluation kernels of
+/// \ref FrozenNonResonantTerms and \ref FrozenResonantTerms.
+struct FreqArrays {
+    /// Real parts of \f$z_1\f$, \f$z_2\f$, \f$z_3\f$, \f$z_1+z_2\f$, \f$z_2+z_3\f$, \f$z_1+z_2+z_3\f$.
+    std::array<std::vector<RealType>, 6> Re;
+    /// Imaginary parts of \f$z_1\f$, \f$z_2\f$, \f$z_3\f$, \f$z_1+z_2\f$, \f$z_2+z_3\f$, \f$z_1+z_2+z_3\f$.
+    std::array<std::vector<RealType>, 6> Im;
+
+    /// Positions of the frequency combinations in \ref Re and \ref Im.
+    enum : std::size_t { Z1 = 0, Z2 = 1, Z3 = 2, Z12 = 3, Z23 = 4, Z123 = 5 };
+
+    /// Constructor.
+    /// \param[in] freqs List of frequency triplets \f$(z_1, z_2, z_3)\f$ of a \ref TwoParticleGF.
+    /// \param[in] Permutation Permutation of operators \f$\{c_i, c_j, c^\dagger_k\}\f$ of
+    ///                        a \ref TwoParticleGFPart. The stored frequencies are the
+    ///                        correspondingly permuted triplets \f$(z_1, z_2, -z_3)\f$.
+    FreqArrays(FreqVec const& freqs, Permutation3 const& Permutation);
+
+    /// Number of stored frequency triplets.
+    std::size_t size() const { return Re[Z1].size(); }
+};
+
+namespace Detail {
+
+// Layout of frozen terms in a checkpoint file: the precision flag and the pole error are followed by
+// NFields arrays of each of the two groups of terms. The groups are identified by the values of their
+// flags listed in GroupFlags. WriteArray(Flag, Field) writes one array.
+template <typename WriteArrayType>
+void save_frozen_terms(BinaryOutputArchive& ar,
+                       bool Single,
+                       RealType PoleError,
+                       std::array<bool, 2> const& GroupFlags,
+                       std::size_t NFields,
+                       WriteArrayType const& WriteArray) {
+    ar.write(std::uint8_t(Single));
+    ar.write(PoleError);
+    for(bool Flag : GroupFlags) {
+        for(std::size_t Field = 0; Field < NFields; ++Field)
+            WriteArray(Flag, Field);
+    }
+}
+
+} // namespace Detail
+
+/// \brief Non-resonant terms of a \ref TwoParticleGFPart in the structure-of-arrays form.
+///
+/// Coefficients and poles of the terms are stored in separate contiguous arrays. Terms with
+/// \ref TwoParticleGFPart::NonResonantTerm::isz4 == false and == true are kept in two separate groups,
+/// so that the evaluation loops contain no branches and can be vectorized by the compiler.
+/// A term occupies 40 bytes, or 28 bytes if the poles are stored in single precision.
+class FrozenNonResonantTerms {
+    /// A group of terms sharing the same value of the \p isz4 flag.
+    struct Group {
+        /// Positions of the arrays in checkpoint files.
+        enum : std::size_t { CoeffReField, CoeffImField, P1Field, P2Field, P3Field, NFields };
+        /// Arrays in the order of storage in checkpoint files.
+        static const std::array<std::vector<RealType> Group::*, NFields> RealArrays;
+        /// Arrays stored instead of \ref RealArrays if the poles are in single precision (or nullptr).
+        static const std::array<std::vector<float> Group::*, NFields> FloatArrays;
+
+        /// Real parts of the coefficients \f$C\f$.
+        std::vector<RealType> CoeffRe;
+        /// Imaginary parts of the coefficients \f$C\f$.
+        std::vector<RealType> CoeffIm;
+        /// Poles \f$P_1\f$.
+        std::vector<RealType> P1;
+        /// Middle poles, \f$P_2\f$ (\p isz4 == false) or \f$P_1+P_2+P_3\f$ (\p isz4 == true).
+        std::vector<RealType> P2;
+        /// Poles \f$P_3\f$.
+        std::vector<RealType> P3;
+        /// Poles \f$P_1\f$, middle poles and poles \f$P_3\f$ rounded to single precision.
+        /// Only one of the two sets of pole arrays is in use.
+        std::vector<float> P1f, P2f, P3f;
+
+        std::size_t size() const { return CoeffRe.size(); }
+        void clear();
+        void reserve(std::size_t Size, bool Single);
+        void push_back(ComplexType Coeff, RealType P1, RealType P2, RealType P3, bool Single, RealType& PoleError);
+        void accumulate(FreqArrays const& z,
+                        std::size_t Begin,
+                        std::size_t End,
+                        std::size_t Middle,
+                        RealType* ResRe,
+                        RealType* ResIm) const;
+    };
+
+    /// Terms with \p isz4 == false.
+    Group TermsZ2;
+    /// Terms with \p isz4 == true.
+    Group TermsZ4;
+    /// Values of \p isz4 of the groups in the order of storage in checkpoint files.
+    static constexpr std::array<bool, 2> GroupFlags = {{false, true}};
+
+    /// Value of a term stored in one of \ref Group::RealArrays.
+    template <typename Term> static RealType field(Term const& t, std::size_t Field) {
+        switch(Field) {
+        case Group::CoeffReField: return t.Coeff.real();
+        case Group::CoeffImField: return t.Coeff.imag();
+        case Group::P1Field: return t.Poles[0];
+        case Group::P2Field: return t.isz4 ? t.Poles[0] + t.Poles[1] + t.Poles[2] : t.Poles[1];
+        default: return t.Poles[2];
+        }
+    }
+
+    /// Are the poles stored in single precision?
+    bool SinglePrecisionPoles = false;
+    /// Maximal absolute error of the poles introduced by rounding to single precision.
+    RealType PoleError = 0;
+
+public:
+    FrozenNonResonantTerms() = default;
+
+    /// Copy terms from a sequence of \ref TwoParticleGFPart::NonResonantTerm.
+    /// \tparam TermRange Type of the sequence of terms.
+    /// \param[in] terms Sequence of terms.
+    /// \param[in] SinglePrecisionPoles Round the poles to single precision.
+    template <typename TermRange> void assign(TermRange const& terms, bool SinglePrecisionPoles = false) {
+        clear();
+        this->SinglePrecisionPoles = SinglePrecisionPoles;
+        std::size_t N = 0, NZ4 = 0;
+        for(auto const& t : terms) {
+            ++N;
+            NZ4 += t.isz4;
+        }
+        TermsZ2.reserve(N - NZ4, SinglePrecisionPoles);
+        TermsZ4.reserve(NZ4, SinglePrecisionPoles);
+        for(auto const& t : terms) {
+            (t.isz4 ? TermsZ4 : TermsZ2)
+                .push_back(t.Coeff,
+                           field(t, Group::P1Field),
+                           field(t, Group::P2Field),
+                           field(t, Group::P3Field),
+                           SinglePrecisionPoles,
+                           PoleError);
+        }
+    }
+
+    /// Write a sequence of \ref TwoParticleGFPart::NonResonantTerm to a checkpoint file in the format of
+    /// \ref save(), as if they were copied with \ref assign(). The terms are streamed into the file
+    /// without making a structure-of-arrays copy.
+    /// \tparam TermRange Type of the sequence of terms.
+    /// \param[in] ar The checkpoint file.
+    /// \param[in] terms Sequence of terms.
+    template <typename TermRange> static void save(BinaryOutputArchive& ar, TermRange const& terms) {
+        std::size_t N = 0, NZ4 = 0;
+        for(auto const& t : terms) {
+            ++N;
+            NZ4 += t.isz4;
+        }
+        Detail::save_frozen_terms(ar, false, 0, GroupFlags, Group::NFields, [&](bool isz4, std::size_t Field) {
+            ar.beginArray(isz4 ? NZ4 : N - NZ4);
+            for(auto const& t : terms) {
+                if(t.isz4 == isz4)
+                    ar.write(field(t, Field));
+            }
+        });
+    }
+
+    /// Number of stored terms.
+    std::size_t size() const { return TermsZ2.size() + TermsZ4.size(); }
+
+    /// Are the poles stored in single precision?
+    bool hasSinglePrecisionPoles() const { return SinglePrecisionPoles; }
+    /// Return the maximal absolute error of the poles introduced by rounding to single precision.
+    /// The relative error of a term evaluated at \f$z_1, z_2, z_3\f$ does not exceed this value times
+    /// \f$\sum_i |z_i - P_i|^{-1}\f$ (to first order), i.e. \f$3\beta/\pi\f$ times this value
+    /// for fermionic Matsubara frequencies.
+    RealType getPoleError() const { return PoleError; }
+
+    /// Remove all terms.
+    void clear();
+
+    /// Write the terms to a checkpoint file.
+    /// \param[in] ar The checkpoint file.
+    void save(BinaryOutputArchive& ar) const;
+    /// Replace the stored terms with those read from a checkpoint file written by \ref save().
+    /// \param[in] ar The checkpoint file.
+    void load(BinaryInputArchive& ar);
+
+    /// Evaluate the sum of all terms at frequencies \p z[Begin], ..., \p z[End-1] and add
+    /// the result to \p ResRe[0], ..., \p ResRe[End-Begin-1] (real parts) and
+    /// \p ResIm[0], ..., \p ResIm[End-Begin-1] (imaginary parts).
+    /// \param[in] z Frequencies.
+    /// \param[in] Begin Index of the first frequency.
+    /// \param[in] End Index past the last frequency.
+    /// \param[inout] ResRe Real parts of the results.
+    /// \param[inout] ResIm Imaginary parts of the results.
+    void accumulate(FreqArrays const& z, std::size_t Begin, std::size_t End, RealType* ResRe, RealType* ResIm) const;
+};
+
+/// \brief Resonant terms of a \ref TwoParticleGFPart in the structure-of-arrays form.
+///
+/// Coefficients and poles of the terms are stored in separate contiguous arrays. Terms with
+/// \ref TwoParticleGFPart::ResonantTerm::isz1z2 == true and == false are kept in two separate groups,
+/// and the resonance condition is resolved with a branch-free selection, so that the evaluation
+/// loops can be vectorized by the compiler.
+/// A term occupies 56 bytes, or 44 bytes if the poles are stored in single precision.
+class FrozenResonantTerms {
+    /// A group of terms sharing the same value of the \p isz1z2 flag.
+    struct Group {
+        /// Positions of the arrays in checkpoint files.
+        enum : std::size_t {
+            ResCoeffReField,
+            ResCoeffImField,
+            NonResCoeffReField,
+            NonResCoeffImField,
+            P1Field,
+            P3Field,
+            PResField,
+            NFields
+        };
+        /// Arrays in the order of storage in checkpoint files.
+        static const std::array<std::vector<RealType> Group::*, NFields> RealArrays;
+        /// Arrays stored instead of \ref RealArrays if the poles are in single precision (or nullptr).
+        static const std::array<std::vector<float> Group::*, NFields> FloatArrays;
+
+        /// Real parts of the coefficients \f$R\f$.
+        std::vector<RealType> ResCoeffRe;
+        /// Imaginary parts of the coefficients \f$R\f$.
+        std::vector<RealType> ResCoeffIm;
+        /// Real parts of the coefficients \f$N\f$.
+        std::vector<RealType> NonResCoeffRe;
+        /// Imaginary parts of the coefficients \f$N\f$.
+        std::vector<RealType> NonResCoeffIm;
+        /// Poles \f$P_1\f$.
+        std::vector<RealType> P1;
+        /// Poles \f$P_3\f$.
+        std::vector<RealType> P3;
+        /// Resonant combinations of poles, \f$P_1+P_2\f$ (\p isz1z2 == true) or
+        /// \f$P_2+P_3\f$ (\p isz1z2 == false).
+        std::vector<RealType> PRes;
+        /// Poles \f$P_1\f$, \f$P_3\f$ and resonant combinations of poles rounded to single precision.
+        /// Only one of the two sets of pole arrays is in use.
+        std::vector<float> P1f, P3f, PResf;
+
+        std::size_t size() const { return ResCoeffRe.size(); }
+        void clear();
+        void reserve(std::size_t Size, bool Single);
+        void push_back(ComplexType ResCoeff,
+                       ComplexType NonResCoeff,
+                       RealType P1,
+                       RealType P3,
+                       RealType PRes,
+                       bool Single,
+                       RealType& PoleError);
+        void accumulate(FreqArrays const& z,
+                        std::size_t Begin,
+                        std::size_t End,
+                        std::size_t Res,
+                        RealType DeltaTolerance,
+                        RealType* ResRe,
+                        RealType* ResIm) const;
+    };
+
+    /// Terms with \p isz1z2 == true.
+    Group TermsZ12;
+    /// Terms with \p isz1z2 == false.
+    Group TermsZ23;
+    /// Values of \p isz1z2 of the groups in the order of storage in checkpoint files.
+    static constexpr std::array<bool, 2> GroupFlags = {{true, false}};
+
+    /// Value of a term stored in one of \ref Group::RealArrays.
+    template <typename Term> static RealType field(Term const& t, std::size_t Field) {
+        switch(Field) {
+        case Group::ResCoeffReField: return t.ResCoeff.real();
+        case Group::ResCoeffImField: return t.ResCoeff.imag();
+        case Group::NonResCoeffReField: return t.NonResCoeff.real();
+        case Group::NonResCoeffImField: return t.NonResCoeff.imag();
+        case Group::P1Field: return t.Poles[0];
+        case Group::P3Field: return t.Poles[2];
+        default: return t.isz1z2 ? t.Poles[0] + t.Poles[1] : t.Poles[1] + t.Poles[2];
+        }
+    }
+
+    /// Are the poles stored in single precision?
+    bool SinglePrecisionPoles = false;
+    /// Maximal absolute error of the poles introduced by rounding to single precision.
+    RealType PoleError = 0;
+
+public:
+    FrozenResonantTerms() = default;
+
+    /// Copy terms from a sequence of \ref TwoParticleGFPart::ResonantTerm.
+    /// \tparam TermRange Type of the sequence of terms.
+    /// \param[in] terms Sequence of terms.
+    /// \param[in] SinglePrecisionPoles Round the poles to single precision.
+    template <typename TermRange> void assign(TermRange const& terms, bool SinglePrecisionPoles = false) {
+        clear();
+        this->SinglePrecisionPoles = SinglePrecisionPoles;
+        std::size_t N = 0, NZ12 = 0;
+        for(auto const& t : terms) {
+            ++N;
+            NZ12 += t.isz1z2;
+        }
+        TermsZ23.reserve(N - NZ12, SinglePrecisionPoles);
+        TermsZ12.reserve(NZ12, SinglePrecisionPoles);
+        for(auto const& t : terms) {
+            (t.isz1z2 ? TermsZ12 : TermsZ23)
+                .push_back(t.ResCoeff,
+                           t.NonResCoeff,
+                           field(t, Group::P1Field),
+                           field(t, Group::P3Field),
+                           field(t, Group::PResField),
+                           SinglePrecisionPoles,
+                           PoleError);
+        }
+    }
+
+    /// Write a sequence of \ref TwoParticleGFPart::ResonantTerm to a checkpoint file in the format of
+    /// \ref save(), as if they were copied with \ref assign(). The terms are streamed into the file
+    /// without making a structure-of-arrays copy.
+    /// \tparam TermRange Type of the sequence of terms.
+    /// \param[in] ar The checkpoint file.
+    /// \param[in] terms Sequence of terms.
+    template <typename TermRange> static void save(BinaryOutputArchive& ar, TermRange const& terms) {
+        std::size_t N = 0, NZ12 = 0;
+        for(auto const& t : terms) {
+            ++N;
+            NZ12 += t.isz1z2;
+        }
+        Detail::save_frozen_terms(ar, false, 0, GroupFlags, Group::NFields, [&](bool isz1z2, std::size_t Field) {
+            ar.beginArray(isz1z2 ? NZ12 : N - NZ12);
+            for(auto const& t : terms) {
+                if(t.isz1z2 == isz1z2)
+                    ar.write(field(t, Field));
+            }
+        });
+    }
+
+    /// Number of stored terms.
+    std::size_t size() const { return TermsZ12.size() + TermsZ23.size(); }
+
+    /// Are the poles stored in single precision?
+    bool hasSinglePrecisionPoles() const { return SinglePrecisionPoles; }
+    /// Return the maximal absolute error of the poles introduced by rounding to single precision
+    /// (cf. \ref FrozenNonResonantTerms::getPoleError()).
+    RealType getPoleError() const { return PoleError; }
+
+    /// Remove all terms.
+    void clear();
+
+    /// Write the terms to a checkpoint file.
+    /// \param[in] ar The checkpoint file.
+    void save(BinaryOutputArchive& ar) const;
+    /// Replace the stored terms with those read from a checkpoint file written by \ref save().
+    /// \param[in] ar The checkpoint file.
+    void load(BinaryInputArchive& ar);
+
+    /// Evaluate the sum of all terms at frequencies \p z[Begin], ..., \p z[End-1] and add
+    /// the result to \p ResRe[0], ..., \p ResRe[End-Begin-1] (real parts) and
+    /// \p ResIm[0], ..., \p ResIm[End-Begin-1] (imaginary parts).
+    /// \param[in] z Frequencies.
+    /// \param[in] Begin Index of the first frequency.
+    /// \param[in] End Index past the last frequency.
+    /// \param[in] DeltaTolerance Tolerance for the resonance detection.
+    /// \param[inout] ResRe Real parts of the results.
+    /// \param[inout] ResIm Imaginary parts of the results.
+    void accumulate(FreqArrays const& z,
+                    std::size_t Begin,
+                    std::size_t End,
+                    RealType DeltaTolerance,
+                    RealType* ResRe,
+                    RealType* ResIm) const;
+};
+
+/// Evaluate the sum of non-resonant and resonant terms at a list of frequencies and add the results to \p data.
+/// The frequencies are processed in fixed-size blocks, which are distributed among OpenMP threads.
+/// \param[in] NonResonant Non-resonant terms.
+/// \param[in] Resonant Resonant terms.
+/// \param[in] DeltaTolerance Tolerance for the resonance detection.
+/// \param[in] z Frequencies.
+/// \param[inout] data Values of the terms at \p z are added to elements of this vector.
+///                    Its size must be equal to that of \p z.
+void EvaluateFrozenTerms(FrozenNonResonantTerms const& NonResonant,
+                         FrozenResonantTerms const& Resonant,
+                         RealType DeltaTolerance,
+                         FreqArrays const& z,
+                         std::vector<ComplexType>& data);
+
+/// Evaluate the sum of non-resonant and resonant terms at a list of frequencies and add the results to \p data.
+/// Unlike \ref EvaluateFrozenTerms(), this function runs in the calling thread, so that it can be used
+/// within an OpenMP parallel region without spawning nested teams of threads.
+/// \param[in] NonResonant Non-resonant terms.
+/// \param[in] Resonant Resonant terms.
+/// \param[in] DeltaTolerance Tolerance for the resonance detection.
+/// \param[in] z Frequencies.
+/// \param[inout] data Values of the terms at \p z are added to elements of this vector.
+///                    Its size must be equal to that of \p z.
+void EvaluateFrozenTermsSerial(FrozenNonResonantTerms const& NonResonant,
+                               FrozenResonantTerms const& Resonant,
+                               RealType DeltaTolerance,
+                               FreqArrays const& z,
+                               std::vector<ComplexType>& data);
+
+///@}
+
+} // namespace Pomerol
+
+#endif // #ifndef POMEROL_INCLUDE_FROZENTERMS_HPP
@@ -26,6 +26,8 @@
 #include "Thermal.hpp"
 
 #include <cstddef>
+#include <map>
+#include <memory>
 #include <vector>
 
 namespace Pomerol {
@@ -64,7 +66,17 @@ class GreensFunction : public Thermal, public ComputableObject {
     /// The list of all \ref GreensFunctionPart's contributing to this GF.
     std::vector<GreensFunctionPart> parts;
 
+    /// Temperature-independent products of matrix elements of the parts, indexed by the 'outer' subspace.
+    using ProductsMap = std::map<BlockNumber, std::shared_ptr<GreensFunctionPart::MatrixElementProducts const>>;
+    /// Products of matrix elements shared by all objects constructed from this one for other density matrices.
+    std::shared_ptr<ProductsMap> Products;
+
 public:
+    /// Keep the temperature-independent products of matrix elements computed by \ref compute().
+    /// They are reused by objects constructed from this one for other density matrices,
+    /// which inherit this flag.
+    bool KeepMatrixElementProducts = false;
+
     /// Constructor.
     /// \param[in] S Information about invariant subspaces of the Hamiltonian.
     /// \param[in] H The Hamiltonian.
@@ -81,6 +93,16 @@ public:
     /// \param[in] GF \ref GreensFunction object to be copied.
     GreensFunction(GreensFunction const& GF);
 
+    /// Construct a Green's function of the same operators \f$c\f$ and \f$c^\dagger\f$
+    /// for another density matrix, e.g. at another temperature. The temperature-independent
+    /// products of matrix elements computed by \p GF (or by any other object sharing them) are
+    /// reused, so that \ref compute() only has to combine them with the new statistical weights.
+    /// The products are available only if \p GF has been computed with \ref KeepMatrixElementProducts set.
+    /// \param[in] GF \ref GreensFunction object to take the operators and the matrix elements from.
+    /// \param[in] DM Many-body density matrix \f$\hat\rho\f$.
+    /// \pre \p DM is defined for the same Hamiltonian as the density matrix of \p GF.
+    GreensFunction(GreensFunction const& GF, DensityMatrix const& DM);
+
     /// Select all relevant parts of \f$c\f$ and \f$c^\dagger\f$
     /// and allocate resources for the \ref GreensFunctionPart's.
     void prepare();
@@ -105,6 +127,16 @@ public:
     /// \param[in] tau Imaginary time point.
     ComplexType of_tau(RealType tau) const;
 
+    /// Return the GF values calculated at a list of complex frequencies.
+    /// This method is much faster than repeated calls to \ref operator()(ComplexType) const.
+    /// \param[in] z List of complex frequencies \f$z\f$.
+    std::vector<ComplexType> evaluate(std::vector<ComplexType> const& z) const;
+
+    /// Return the GF values calculated at a list of Matsubara frequencies.
+    /// This method is much faster than repeated calls to \ref operator()(long) const.
+    /// \param[in] MatsubaraNumbers List of Matsubara indices \f$n\f$ (\f$\omega_n=\pi(2n+1)/\beta\f$).
+    std::vector<ComplexType> evaluate(std::vector<long> const& MatsubaraNumbers) const;
+
     /// Is this Green's function identically zero?
     bool isVanishing() const { return Vanishing; }
 };
@@ -16,6 +16,7 @@
 #ifndef POMEROL_INCLUDE_POMEROL_HAMILTONIAN_HPP
 #define POMEROL_INCLUDE_POMEROL_HAMILTONIAN_HPP
 
+#include "BinaryArchive.hpp"
 #include "ComputableObject.hpp"
 #include "HamiltonianPart.hpp"
 #include "HilbertSpace.hpp"
@@ -24,8 +25,15 @@
 #include "StatesClassification.hpp"
 
 #include "mpi_dispatcher/misc.hpp"
+#include "mpi_dispatcher/mpi_dispatcher.hpp"
+
+#include <libcommute/loperator/sparse_state_vector.hpp>
 
 #include <cmath>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
@@ -54,7 +62,27 @@ class Hamiltonian : public ComputableObject {
     /// The ground state energy.
     RealType GroundEnergy = -HUGE_VAL;
 
+    /// Constant shifts of the eigenvalues within each block set by \ref setBlockShifts().
+    std::vector<RealType> BlockShifts;
+
+    /// Window exposing the locally stored eigenvector matrices in the distributed storage mode.
+    /// It is declared after \ref parts to be destroyed before the matrices attached to it.
+    std::unique_ptr<EigenvectorsWindow> Window;
+
 public:
+    /// Parameters of the iterative eigensolver. Blocks diagonalized with the iterative eigensolver retain
+    /// only the eigenstates with energies within \ref LanczosParameters::EnergyWindow above the ground state
+    /// energy, as if \ref reduce() had been called for them. Matrices of such blocks are assembled in the sparse
+    /// form, therefore the parameters should be set before calling \ref prepare().
+    LanczosParameters Lanczos;
+
+    /// Distributed storage mode. If enabled, matrices of the blocks are not broadcast. Each process keeps
+    /// only the blocks it has prepared and diagonalized, while eigenvalues of all blocks are replicated.
+    /// Eigenvectors of remote blocks are fetched on demand via \ref HamiltonianPart::fetchMatrix().
+    /// This flag should be set before calling \ref prepare(). \ref compute() and \ref reduce() are collective
+    /// operations in this mode, and so is destruction of the object.
+    bool DistributedStorage = false;
+
     /// Constructor.
     /// \param[in] S Information about invariant subspaces of the Hamiltonian.
     explicit Hamiltonian(StatesClassification const& S) : S(S) {}
@@ -71,16 +99,63 @@ public:
                  MPI_Comm const& comm = MPI_COMM_WORLD);
 
     /// Diagonalize matrices of all diagonal blocks in parallel.
+    ///
+    /// The blocks are distributed among processes of \p comm. If \p comm contains only one process and
+    /// OpenMP support is enabled, the blocks are diagonalized by the OpenMP threads instead, largest first.
+    /// The largest blocks are diagonalized one at a time with all threads working on the same block.
     /// \param[in] comm MPI communicator used to parallelize the computation.
     /// \pre \ref prepare() has been called.
     void compute(MPI_Comm const& comm = MPI_COMM_WORLD);
 
+    /// Fill and diagonalize matrices of all diagonal blocks in parallel.
+    ///
+    /// This is equivalent to calling \ref prepare() and \ref compute() in a row, but every block is filled and
+    /// diagonalized by the same process. Only the results of the diagonalization are communicated.
+    /// \tparam ScalarType Scalar type (either double or std::complex<double>) of the expression \p H.
+    /// \tparam IndexTypes Types of indices carried by operators in the expression \p H.
+    /// \param[in] H Expression of the Hamiltonian.
+    /// \param[in] HS Hilbert space.
+    /// \param[in] comm MPI communicator used to parallelize the computation.
+    template <typename ScalarType, typename... IndexTypes>
+    void prepareAndCompute(Operators::expression<ScalarType, IndexTypes...> const& H,
+                           HilbertSpace<IndexTypes...> const& HS,
+                           MPI_Comm const& comm = MPI_COMM_WORLD);
+
     /// Discard all eigenvalues exceeding a given cutoff and truncate the size of all diagonalized
-    /// blocks accordingly.
+    /// blocks accordingly. This is a collective operation in the \ref DistributedStorage mode.
     /// \param[in] Cutoff Maximum allowed excitation energy (energy level calculated w.r.t. the ground state energy).
     /// \pre \ref compute() has been called.
     void reduce(RealType Cutoff);
 
+    /// Shift all eigenvalues within each block by a block-specific constant and update the ground state energy.
+    /// This is equivalent to adding a perturbation \f$\hat V\f$ that commutes with the Hamiltonian and takes
+    /// a constant value \f$V_B\f$ within each invariant subspace \f$B\f$, such as \f$-\delta\mu\hat N\f$
+    /// or \f$-h\hat S_z\f$ (see \ref ComputeBlockValues()). The invariant subspaces, eigenvectors and
+    /// matrices of operators in the eigenbasis stay valid, so that scans over \f$\mu\f$ or magnetic field
+    /// require only one diagonalization. Objects depending on the eigenvalues, such as \ref DensityMatrix,
+    /// have to be recomputed after each call.
+    ///
+    /// The shifts are counted from the eigenvalues obtained in \ref compute(), i.e. each call replaces
+    /// the shifts set by the previous one. Eigenstates discarded by \ref reduce() or by the iterative
+    /// eigensolver are not restored.
+    /// \param[in] Shifts List of shifts \f$V_B\f$, one per block.
+    /// \pre \ref compute() has been called.
+    void setBlockShifts(std::vector<RealType> const& Shifts);
+
+    /// Write eigenvalues and eigenvectors of all blocks to a checkpoint file. In the \ref DistributedStorage mode,
+    /// eigenvectors of the remote blocks are fetched, so that only one process has to call this method.
+    /// \param[in] ar The checkpoint file.
+    /// \pre \ref compute() has been called.
+    void save(BinaryOutputArchive& ar) const;
+
+    /// Read eigenvalues and eigenvectors of all blocks from a checkpoint file written by \ref save().
+    /// This is an alternative to \ref prepare() and \ref compute(). Every calling process reads and stores
+    /// all blocks, regardless of \ref DistributedStorage.
+    /// \param[in] ar The checkpoint file.
+    /// \pre The \ref StatesClassification object passed to the constructor has the same invariant subspaces
+    ///      as the one used to \ref save() the Hamiltonian (e.g. it has been loaded from the same file).
+    void load(BinaryInputArchive& ar);
+
     /// Is the Hamiltonian a complex-valued matrix?
     bool isComplex() const { return Complex; }
 
@@ -115,9 +190,19 @@ public:
 private:
     // Implementation details
     void computeGroundEnergy();
+    void computeBlocks(std::vector<BlockNumber> const& Blocks);
+    void publishEigenvectors();
+    void broadcastEigenvalues(MPI_Comm const& comm);
+    void finalizeCompute(MPI_Comm const& comm);
 
+    template <bool C> void createParts(LOperatorTypeRC<C> const& HOp);
     template <bool C> void prepareImpl(LOperatorTypeRC<C> const& HOp, const MPI_Comm& comm);
     template <bool C> void computeImpl(MPI_Comm const& comm);
+    template <bool C> void saveImpl(BinaryOutputArchive& ar) const;
+    template <bool C> void loadImpl(BinaryInputArchive& ar);
+    template <bool C> void prepareAndComputeImpl(LOperatorTypeRC<C> const& HOp, MPI_Comm const& comm);
+    template <bool C>
+    void broadcastEigensystems(std::map<pMPI::JobId, pMPI::WorkerId>& job_map, MPI_Comm const& comm);
 };
 
 template <typename ScalarType, typename... IndexTypes>
@@ -135,6 +220,72 @@ void Hamiltonian::prepare(Operators::expression<ScalarType, IndexTypes...> const
     setStatus(Prepared);
 }
 
+template <typename ScalarType, typename... IndexTypes>
+void Hamiltonian::prepareAndCompute(Operators::expression<ScalarType, IndexTypes...> const& H,
+                                    HilbertSpace<IndexTypes...> const& HS,
+                                    MPI_Comm const& comm) {
+    if(getStatus() >= Computed)
+        return;
+    if(getStatus() >= Prepared) {
+        compute(comm);
+        return;
+    }
+
+    Complex = std::is_same<ScalarType, ComplexType>::value;
+    LOperatorType<ScalarType> HOp(H, HS.getFullHilbertSpace());
+    prepareAndComputeImpl<std::is_same<ScalarType, ComplexType>::value>(HOp, comm);
+    setStatus(Prepared);
+
+    finalizeCompute(comm);
+}
+
+/// Compute values taken by an operator \f$\hat V\f$ within the invariant subspaces of a Hamiltonian.
+/// The operator must be diagonal in the Fock basis and constant within each invariant subspace, which is
+/// the case for operators of conserved quantities such as the total particle number or \f$\hat S_z\f$.
+/// Combinations of the computed values can be passed to \ref Hamiltonian::setBlockShifts().
+/// \tparam ScalarType Scalar type (either double or std::complex<double>) of the expression \p V.
+/// \tparam IndexTypes Types of indices carried by operators in the expression \p V.
+/// \param[in] V Expression of the operator \f$\hat V\f$.
+/// \param[in] HS Hilbert space.
+/// \param[in] S Information about invariant subspaces of the Hamiltonian.
+/// \param[in] Tolerance Tolerance used to compare matrix elements of \f$\hat V\f$.
+/// \return List of values of \f$\hat V\f$, one per invariant subspace.
+template <typename ScalarType, typename... IndexTypes>
+std::vector<RealType> ComputeBlockValues(Operators::expression<ScalarType, IndexTypes...> const& V,
+                                         HilbertSpace<IndexTypes...> const& HS,
+                                         StatesClassification const& S,
+                                         RealType Tolerance = 1e-12) {
+    LOperatorType<ScalarType> VOp(V, HS.getFullHilbertSpace());
+
+    std::vector<RealType> Values(S.getNumberOfBlocks());
+    libcommute::sparse_state_vector<ScalarType> bra(S.getNumberOfStates());
+    for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+        auto const& FockStates = S.getFockStates(Block);
+        for(InnerQuantumState st = 0; st < FockStates.size(); ++st) {
+            libcommute::sparse_state_vector<ScalarType> ket(S.getNumberOfStates());
+            ket[FockStates[st]] = 1.0;
+            VOp(ket, bra);
+
+            ScalarType Value = 0;
+            libcommute::foreach(bra, [&](libcommute::sv_index_type State, ScalarType const& Amplitude) {
+                if(State == FockStates[st])
+                    Value = Amplitude;
+                else if(std::abs(Amplitude) > Tolerance)
+                    throw std::runtime_error("ComputeBlockValues: Operator is not diagonal in the Fock basis");
+            });
+
+            if(std::abs(std::imag(Value)) > Tolerance)
+                throw std::runtime_error("ComputeBlockValues: Operator has complex diagonal elements");
+            if(st == 0)
+                Values[Block] = std::real(Value);
+            else if(std::abs(std::real(Value) - Values[Block]) > Tolerance)
+                throw std::runtime_error("ComputeBlockValues: Operator is not constant within block " +
+                                         std::to_string(Block));
+        }
+    }
+    return Values;
+}
+
 ///@}
 
 } // namespace Pomerol
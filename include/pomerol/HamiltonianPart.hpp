@@ -21,18 +21,77 @@
 #include "Misc.hpp"
 #include "StatesClassification.hpp"
 
+#include "mpi_dispatcher/misc.hpp"
+
 #include <libcommute/algebra_ids.hpp>
 #include <libcommute/loperator/loperator.hpp>
 
 #include <iostream>
 #include <memory>
 #include <type_traits>
+#include <vector>
 
 namespace Pomerol {
 
 /// \addtogroup ED
 ///@{
 
+/// \brief Parameters of the iterative eigensolver.
+///
+/// Blocks of the Hamiltonian with dimension of at least \ref MinBlockSize are diagonalized using the
+/// thick-restart block Lanczos method. Instead of the full spectrum, only eigenpairs within \ref EnergyWindow
+/// above the lowest eigenvalue of a block are computed. The eigenvector matrix of such a block has as many
+/// columns as there are computed eigenpairs.
+struct LanczosParameters {
+    /// Minimal dimension of a block to be diagonalized iteratively. 0 disables the iterative eigensolver.
+    InnerQuantumState MinBlockSize = 0;
+    /// Width of the energy window.
+    RealType EnergyWindow = 10.0;
+    /// Number of vectors in a Lanczos block. Eigenvalues with degeneracies exceeding this number
+    /// may be resolved incompletely.
+    InnerQuantumState BlockSize = 8;
+    /// Initial dimension of the Krylov subspace. The subspace is enlarged when it cannot accommodate all
+    /// requested eigenpairs. Once its dimension would exceed half the block dimension,
+    /// the dense eigensolver is used instead.
+    InnerQuantumState SubspaceSize = 64;
+    /// Convergence threshold for residual norms \f$\|H\psi - E\psi\|/\max(1,|E|)\f$.
+    RealType Tolerance = 1e-10;
+    /// Maximal number of restarts.
+    unsigned int MaxRestarts = 1000;
+};
+
+/// \brief MPI window exposing locally stored eigenvector matrices to other processes.
+///
+/// This is a dynamic MPI window over a private duplicate of a communicator. Processes attach memory
+/// of the eigenvector matrices they own, and other processes read the matrices using passive target
+/// one-sided communication. Construction and destruction are collective operations.
+class EigenvectorsWindow {
+    /// Memory regions attached to the window.
+    std::vector<void*> Attached;
+
+public:
+    /// Communicator the window is created over.
+    MPI_Comm Comm;
+    /// MPI window handle.
+    MPI_Win Win;
+
+    /// Constructor.
+    /// \param[in] comm MPI communicator to duplicate.
+    explicit EigenvectorsWindow(MPI_Comm const& comm);
+    EigenvectorsWindow(EigenvectorsWindow const&) = delete;
+    EigenvectorsWindow& operator=(EigenvectorsWindow const&) = delete;
+    /// Destructor.
+    ~EigenvectorsWindow();
+
+    /// Attach a memory region to the window.
+    /// \param[in] Base Beginning of the memory region.
+    /// \param[in] Size Size of the memory region in bytes.
+    /// \return Address of the region to be used as a target displacement.
+    MPI_Aint attach(void* Base, std::size_t Size);
+    /// Detach all attached memory regions.
+    void detachAll();
+};
+
 /// \brief Part of a Hamiltonian of a quantum system.
 ///
 /// This class stores and diagonalizes a single block of the Hamiltonian matrix, which corresponds to a single
@@ -54,12 +113,27 @@ class HamiltonianPart : public ComputableObject {
     /// The type-erased real/complex matrix of this block of the Hamiltonian.
     std::shared_ptr<void> HMatrix = nullptr;
 
+    /// The type-erased real/complex sparse matrix of this block of the Hamiltonian. It is assembled
+    /// instead of the dense matrix for blocks to be diagonalized by the iterative eigensolver, and is released
+    /// upon diagonalization.
+    std::shared_ptr<void> HSparseMatrix = nullptr;
+
     /// Eigenvalues of this block.
     RealVectorType Eigenvalues;
 
+    /// Window through which the eigenvector matrix can be fetched, if it is stored by another process.
+    EigenvectorsWindow const* Window = nullptr;
+    /// Rank of the process storing the eigenvector matrix within the communicator of \ref Window.
+    int Owner = 0;
+    /// Address of the eigenvector matrix on the \ref Owner process.
+    MPI_Aint Address = 0;
+
     friend class Hamiltonian;
 
 public:
+    /// Parameters of the iterative eigensolver.
+    LanczosParameters Lanczos;
+
     /// Constructor.
     /// \tparam ScalarType Scalar type (either double or std::complex<double>) of the linear operator \p HOp.
     /// \param[in] HOp The linear operator object corresponding to the Hamiltonian.
@@ -69,15 +143,30 @@ public:
     HamiltonianPart(LOperatorType<ScalarType> const& HOp, StatesClassification const& S, BlockNumber Block)
         : S(S), Block(Block), Complex(std::is_same<ScalarType, ComplexType>::value), HOp(&HOp) {}
 
+    /// Construct a part without a linear operator. Such parts cannot be prepared, and are used to hold
+    /// eigensystems read from a checkpoint file (see \ref Hamiltonian::load()).
+    /// \param[in] S Information about invariant subspaces of the Hamiltonian.
+    /// \param[in] Block Index of the block (invariant subspace) this part corresponds to.
+    /// \param[in] Complex Whether the eigenvectors are complex-valued.
+    HamiltonianPart(StatesClassification const& S, BlockNumber Block, bool Complex)
+        : S(S), Block(Block), Complex(Complex), HOp(nullptr) {}
+
     /// Fill the matrix with elements.
+    ///
+    /// For blocks to be diagonalized by the iterative eigensolver (see \ref Lanczos), the matrix is assembled in
+    /// the sparse form by acting with the Hamiltonian on individual Fock states. Otherwise, a dense matrix is filled.
     void prepare();
 
     /// Diagonalize the matrix.
+    ///
+    /// Depending on \ref Lanczos, either the full spectrum is computed, or only the eigenpairs within
+    /// an energy window above the lowest eigenvalue. In the latter case, the stored matrix of eigenvectors
+    /// has fewer columns than rows.
     /// \pre \ref prepare() has been called.
     void compute();
 
-    /// Discard all eigenvalues exceeding a given cutoff and truncate the size of the diagonalized
-    /// matrix accordingly.
+    /// Discard all eigenvalues exceeding a given cutoff and the corresponding columns
+    /// of the eigenvector matrix.
     /// \param[in] Cutoff Maximum allowed value of the energy.
     /// \pre \ref compute() has been called.
     bool reduce(RealType Cutoff);
@@ -85,12 +174,19 @@ public:
     /// Is this object storing a complex-valued matrix?
     bool isComplex() const { return Complex; }
 
+    /// Is this object storing a sparse, not yet diagonalized matrix?
+    bool isSparse() const { return bool(HSparseMatrix); }
+
     /// Return the index of the block (invariant subspace) this part corresponds to.
     BlockNumber getBlockNumber() const { return Block; }
 
     /// Return dimension of the respective invariant subspace.
     InnerQuantumState getSize() const;
 
+    /// Return the number of computed (retained) eigenstates.
+    /// \pre \ref compute() has been called.
+    InnerQuantumState getNumberOfEigenstates() const;
+
     /// Access eigenvalues of the matrix.
     /// \pre \ref compute() has been called.
     RealVectorType const& getEigenValues() const;
@@ -111,6 +207,23 @@ public:
     /// \pre The compile-time value of \p Complex must agree with the result of \ref isComplex().
     template <bool Complex> MatrixType<Complex>& getMatrix();
 
+    /// Return a constant reference to the stored sparse matrix.
+    /// \tparam Complex Request a reference to a complex-valued matrix.
+    /// \pre \ref prepare() has been called, \ref isSparse() returns true.
+    /// \pre The compile-time value of \p Complex must agree with the result of \ref isComplex().
+    template <bool Complex> RowMajorMatrixType<Complex> const& getSparseMatrix() const;
+
+    /// Is the (eigenvector) matrix of this block stored by the calling process?
+    bool isLocal() const { return bool(HMatrix) || bool(HSparseMatrix); }
+
+    /// Return a pointer to the matrix of eigenvectors. If the matrix is stored by another process
+    /// (see \ref Hamiltonian::DistributedStorage), a local copy of it is fetched using
+    /// one-sided MPI communication.
+    /// \tparam Complex Request a pointer to a complex-valued matrix.
+    /// \pre \ref compute() has been called.
+    /// \pre The compile-time value of \p Complex must agree with the result of \ref isComplex().
+    template <bool Complex> std::shared_ptr<MatrixType<Complex> const> fetchMatrix() const;
+
     /// Return the lowest eigenvalue.
     /// \pre \ref compute() has been called.
     RealType getMinimumEigenvalue() const;
@@ -126,7 +239,12 @@ public:
     /// \param[in] part HamiltonianPart to be inserted.
     /// \return Reference to the output stream.
     friend std::ostream& operator<<(std::ostream& os, HamiltonianPart const& part) {
-        if(part.isComplex())
+        if(part.isSparse()) {
+            if(part.isComplex())
+                os << part.getSparseMatrix<true>() << std::endl;
+            else
+                os << part.getSparseMatrix<false>() << std::endl;
+        } else if(part.isComplex())
             os << part.getMatrix<true>() << std::endl;
         else
             os << part.getMatrix<false>() << std::endl;
@@ -137,10 +255,13 @@ public:
 private:
     // Implementation details
     template <bool C> void initHMatrix();
+    template <bool C> void initHSparseMatrix();
     template <bool C> void prepareImpl();
+    template <bool C> void prepareSparseImpl();
     template <bool C> void computeImpl();
 
     void checkComputed() const;
+    bool useIterativeSolver() const;
 };
 
 ///@}
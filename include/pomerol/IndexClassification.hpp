@@ -19,13 +19,20 @@
 #include "Misc.hpp"
 #include "Operators.hpp"
 
+#include <libcommute/expression/generator_fermion.hpp>
 #include <libcommute/utility.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <iostream>
 #include <map>
+#include <numeric>
+#include <set>
 #include <sstream>
 #include <stdexcept>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace Pomerol {
@@ -83,6 +90,10 @@ public:
         UpdateMaps();
     }
 
+    /// Check if a given operator index tuple is present in the map.
+    /// \param[in] info Index tuple to check.
+    bool checkInfo(IndexInfo const& info) const { return InfoToIndices.count(info) > 0; }
+
     /// Check if a given \ref ParticleIndex has a corresponding index tuple in the map.
     /// \param[in] in Particle index to check.
     bool checkIndex(ParticleIndex in) const { return in < InfoToIndices.size(); }
@@ -151,6 +162,180 @@ IndexClassification<IndexTypes...> MakeIndexClassification(Operators::expression
     return IndexClassification<IndexTypes...>(H);
 }
 
+/// A permutation \f$\sigma\f$ of single-particle indices, which represents a mapping
+/// \f$c_i \mapsto c_{\sigma(i)}\f$. Element \p i of the vector is \f$\sigma(i)\f$.
+using IndexPermutation = std::vector<ParticleIndex>;
+
+namespace Detail {
+
+// A monomial in the canonical form, i.e. as a sequence of (dagger, index) pairs with
+// the creation operators going first, and the indices going in the ascending order within
+// each group.
+using CanonicalMonomial = std::vector<std::pair<bool, ParticleIndex>>;
+
+// Bring a product of fermionic operators to the canonical form and return the sign picked up
+// in the process. The product must be normal ordered, so that only operators of the same kind are swapped.
+inline int canonicalize(CanonicalMonomial& m) {
+    int sign = 1;
+    auto key = [](std::pair<bool, ParticleIndex> const& g) { return std::make_pair(!g.first, g.second); };
+    for(std::size_t i = 1; i < m.size(); ++i) {
+        for(std::size_t j = i; j > 0 && key(m[j]) < key(m[j - 1]); --j) {
+            std::swap(m[j], m[j - 1]);
+            sign = -sign;
+        }
+    }
+    return sign;
+}
+
+// Terms of an expression in the canonical form, with all indices mapped by a permutation.
+template <typename ScalarType, typename... IndexTypes>
+std::map<CanonicalMonomial, ScalarType> canonical_terms(Operators::expression<ScalarType, IndexTypes...> const& H,
+                                                        IndexClassification<IndexTypes...> const& IndexInfo,
+                                                        IndexPermutation const& Permutation,
+                                                        RealType Tolerance) {
+    std::map<CanonicalMonomial, ScalarType> Terms;
+    for(auto const& mon : H) {
+        CanonicalMonomial m;
+        for(auto const& g : mon.monomial) {
+            if(!libcommute::is_fermion(g))
+                throw std::runtime_error("Only fermionic expressions can be analyzed for index symmetries");
+            bool dagger = static_cast<libcommute::generator_fermion<IndexTypes...> const&>(g).dagger();
+            m.emplace_back(dagger, Permutation[IndexInfo.getIndex(g.indices())]);
+        }
+        int sign = canonicalize(m);
+        Terms[m] += ScalarType(sign) * mon.coeff;
+    }
+    for(auto it = Terms.begin(); it != Terms.end();) {
+        if(std::abs(it->second) <= Tolerance)
+            it = Terms.erase(it);
+        else
+            ++it;
+    }
+    return Terms;
+}
+
+// Do two sets of canonical terms coincide within a tolerance?
+template <typename ScalarType>
+bool equal_terms(std::map<CanonicalMonomial, ScalarType> const& Terms1,
+                 std::map<CanonicalMonomial, ScalarType> const& Terms2,
+                 RealType Tolerance) {
+    if(Terms1.size() != Terms2.size())
+        return false;
+    for(auto const& t : Terms2) {
+        auto it = Terms1.find(t.first);
+        if(it == Terms1.end() || std::abs(it->second - t.second) > Tolerance)
+            return false;
+    }
+    return true;
+}
+
+// Add candidate permutations that act on one element of the index tuples:
+// transpositions of two values and a cyclic shift of all values of the element.
+template <std::size_t K, typename... IndexTypes> struct IndexPermutationCandidates {
+    using IndexInfo = std::tuple<IndexTypes...>;
+
+    static void add(IndexClassification<IndexTypes...> const& Info, std::set<IndexPermutation>& Candidates) {
+        using ValueType = typename std::tuple_element<K, IndexInfo>::type;
+        ParticleIndex N = Info.getIndexSize();
+
+        std::set<ValueType> Values;
+        for(ParticleIndex i = 0; i < N; ++i)
+            Values.insert(std::get<K>(Info.getInfo(i)));
+        std::vector<ValueType> SortedValues(Values.begin(), Values.end());
+
+        // Build a permutation from a mapping of values; discard it if some of the mapped tuples do not exist
+        auto make_candidate = [&](std::map<ValueType, ValueType> const& ValueMap) {
+            IndexPermutation Permutation(N);
+            for(ParticleIndex i = 0; i < N; ++i) {
+                IndexInfo Mapped = Info.getInfo(i);
+                auto it = ValueMap.find(std::get<K>(Mapped));
+                if(it != ValueMap.end())
+                    std::get<K>(Mapped) = it->second;
+                if(!Info.checkInfo(Mapped))
+                    return;
+                Permutation[i] = Info.getIndex(Mapped);
+            }
+            Candidates.insert(Permutation);
+        };
+
+        for(std::size_t a = 0; a < SortedValues.size(); ++a) {
+            for(std::size_t b = a + 1; b < SortedValues.size(); ++b)
+                make_candidate({{SortedValues[a], SortedValues[b]}, {SortedValues[b], SortedValues[a]}});
+        }
+        if(SortedValues.size() > 2) {
+            std::map<ValueType, ValueType> Shift;
+            for(std::size_t a = 0; a < SortedValues.size(); ++a)
+                Shift.emplace(SortedValues[a], SortedValues[(a + 1) % SortedValues.size()]);
+            make_candidate(Shift);
+        }
+
+        IndexPermutationCandidates<K + 1, IndexTypes...>::add(Info, Candidates);
+    }
+};
+
+template <typename... IndexTypes> struct IndexPermutationCandidates<sizeof...(IndexTypes), IndexTypes...> {
+    static void add(IndexClassification<IndexTypes...> const&, std::set<IndexPermutation>&) {}
+};
+
+} // namespace Detail
+
+/// Check if an expression is invariant under a permutation of single-particle indices
+/// \f$c_i \mapsto c_{\sigma(i)}\f$, \f$c^\dagger_i \mapsto c^\dagger_{\sigma(i)}\f$.
+/// \tparam ScalarType Coefficient type of expression H.
+/// \tparam IndexTypes Types of indices carried by a single creation/annihilation operator.
+/// \param[in] H Fermionic expression to be analyzed.
+/// \param[in] IndexInfo Classification of single-particle indices.
+/// \param[in] Permutation The permutation \f$\sigma\f$.
+/// \param[in] Tolerance Maximal difference between coefficients of matching terms.
+/// \pre \p H contains only fermionic operators.
+template <typename ScalarType, typename... IndexTypes>
+bool IsIndexSymmetry(Operators::expression<ScalarType, IndexTypes...> const& H,
+                     IndexClassification<IndexTypes...> const& IndexInfo,
+                     IndexPermutation const& Permutation,
+                     RealType Tolerance = 1e-12) {
+    IndexPermutation Identity(IndexInfo.getIndexSize());
+    std::iota(Identity.begin(), Identity.end(), 0);
+    if(Permutation.size() != Identity.size() ||
+       !std::is_permutation(Permutation.begin(), Permutation.end(), Identity.begin()))
+        return false;
+
+    return Detail::equal_terms(Detail::canonical_terms(H, IndexInfo, Identity, Tolerance),
+                               Detail::canonical_terms(H, IndexInfo, Permutation, Tolerance),
+                               Tolerance);
+}
+
+/// Detect permutations of single-particle indices that leave an expression (usually the Hamiltonian)
+/// invariant. The candidate permutations act on one element of the operator index tuples at a time:
+/// For each element, all transpositions of two of its values (e.g. a spin flip or an exchange of two
+/// orbitals) and the cyclic shift of all its values (e.g. a translation along a periodic chain) are tried.
+/// Products of the detected permutations are symmetries as well, but are not included in the result.
+/// \tparam ScalarType Coefficient type of expression H.
+/// \tparam IndexTypes Types of indices carried by a single creation/annihilation operator.
+/// \param[in] H Fermionic expression to be analyzed.
+/// \param[in] IndexInfo Classification of single-particle indices.
+/// \param[in] Tolerance Maximal difference between coefficients of matching terms.
+/// \return List of the detected symmetry permutations.
+/// \pre \p H contains only fermionic operators.
+template <typename ScalarType, typename... IndexTypes>
+std::vector<IndexPermutation> FindIndexSymmetries(Operators::expression<ScalarType, IndexTypes...> const& H,
+                                                  IndexClassification<IndexTypes...> const& IndexInfo,
+                                                  RealType Tolerance = 1e-12) {
+    std::set<IndexPermutation> Candidates;
+    Detail::IndexPermutationCandidates<0, IndexTypes...>::add(IndexInfo, Candidates);
+
+    IndexPermutation Identity(IndexInfo.getIndexSize());
+    std::iota(Identity.begin(), Identity.end(), 0);
+    Candidates.erase(Identity);
+
+    auto Terms = Detail::canonical_terms(H, IndexInfo, Identity, Tolerance);
+    std::vector<IndexPermutation> Symmetries;
+    for(auto const& Permutation : Candidates) {
+        if(Detail::equal_terms(Terms, Detail::canonical_terms(H, IndexInfo, Permutation, Tolerance), Tolerance))
+            Symmetries.push_back(Permutation);
+    }
+    return Symmetries;
+}
+
 ///@}
 
 } // namespace Pomerol
@@ -19,10 +19,14 @@
 #include "Index.hpp"
 #include "IndexClassification.hpp"
 
+#include <algorithm>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <set>
+#include <stdexcept>
 #include <utility>
+#include <vector>
 
 namespace Pomerol {
 
@@ -80,6 +84,20 @@ protected:
     /// Sparse storage for the plain (non-decorated) elements.
     std::map<IndexCombination4, std::shared_ptr<ElementType>> NonTrivialElements;
 
+    /// Permutations of single-particle indices that leave the elements invariant.
+    std::vector<IndexPermutation> Symmetries;
+
+    /// Return the set of index combinations related to a given one by the symmetries
+    /// (including the combination itself).
+    /// \param[in] Indices Index combination.
+    std::set<IndexCombination4> getSymmetryOrbit(IndexCombination4 const& Indices) const;
+
+    /// Store an element under an index combination and under the index combinations obtained
+    /// by swapping the first two and/or the last two indices.
+    /// \param[in] Indices Index combination.
+    /// \param[in] pElement The element.
+    void insert(IndexCombination4 const& Indices, std::shared_ptr<ElementType> pElement);
+
 public:
     /// Construct from a source object and an index classification object.
     /// The container is initially empty and shall be populated with elements
@@ -98,10 +116,20 @@ public:
     void fill(std::set<IndexCombination4> Indices = std::set<IndexCombination4>());
 
     /// Create a stored element from the source object by its index combination.
+    /// The element is also stored under all index combinations related to \p Indices by the symmetries.
     /// \param[in] Indices Index combination of the element to be created.
     /// \return Reference to the created element.
     ElementWithPermFreq<ElementType>& create(IndexCombination4 const& Indices);
 
+    /// Declare a permutation \f$\sigma\f$ of single-particle indices a symmetry of the elements,
+    /// i.e. \f$E_{ijkl} = E_{\sigma(i)\sigma(j)\sigma(k)\sigma(l)}\f$. This is the case if the Hamiltonian
+    /// is invariant under \f$c_i \mapsto c_{\sigma(i)}\f$ (see \ref IsIndexSymmetry() and
+    /// \ref FindIndexSymmetries()). Elements created afterwards are shared by all index combinations
+    /// related by the declared symmetries and their products, so that only one element per class
+    /// of equivalent combinations is computed.
+    /// \param[in] Permutation The permutation \f$\sigma\f$.
+    void addSymmetry(IndexPermutation const& Permutation);
+
     /// Check if an element for a given index combination is stored in the container.
     /// \param[in] Indices Index combination.
     bool isInContainer(IndexCombination4 const& Indices) const;
@@ -170,10 +198,8 @@ inline bool IndexContainer4<ElementType, SourceObject>::isInContainer(ParticleIn
 
 template <typename ElementType, typename SourceObject>
 inline void IndexContainer4<ElementType, SourceObject>::fill(std::set<IndexCombination4> Indices) {
-    // TODO: this method should use symmetry information
-    // Indices should be split into equivalence classes with
-    // the equivalence relation provided by a symmetry analyzer
-    // The resulting classes may be extended afterwards (optionally)
+    // Index combinations related to an already created element by the symmetries
+    // are skipped, so that one element per equivalence class is created.
 
     // remove existing elements
     ElementsMap.clear();
@@ -188,10 +214,9 @@ inline void IndexContainer4<ElementType, SourceObject>::fill(std::set<IndexCombi
 }
 
 template <typename ElementType, typename SourceObject>
-inline ElementWithPermFreq<ElementType>&
-IndexContainer4<ElementType, SourceObject>::create(IndexCombination4 const& Indices) {
-    std::shared_ptr<ElementType> pElement(Source.createElement(Indices));
-    auto iter = ElementsMap.emplace(Indices, ElementWithPermFreq<ElementType>(pElement, permutations4[0])).first;
+inline void IndexContainer4<ElementType, SourceObject>::insert(IndexCombination4 const& Indices,
+                                                               std::shared_ptr<ElementType> pElement) {
+    ElementsMap.emplace(Indices, ElementWithPermFreq<ElementType>(pElement, permutations4[0]));
 
     DEBUG("IndexContainer4::fill() at " << this << ": "
                                         << "added an element with indices " << Indices << " and frequency permutation "
@@ -200,8 +225,6 @@ IndexContainer4<ElementType, SourceObject>::create(IndexCombination4 const& Indi
     bool SameCIndices = (Indices.Index1 == Indices.Index2);
     bool SameCXIndices = (Indices.Index3 == Indices.Index4);
 
-    NonTrivialElements.emplace(Indices, pElement);
-
     if(!SameCIndices) {
         IndexCombination4 Indices2134(Indices.Index2, Indices.Index1, Indices.Index3, Indices.Index4);
         if(!isInContainer(Indices2134)) {
@@ -232,8 +255,48 @@ IndexContainer4<ElementType, SourceObject>::create(IndexCombination4 const& Indi
                                                 << ").");
         }
     }
+}
+
+template <typename ElementType, typename SourceObject>
+inline ElementWithPermFreq<ElementType>&
+IndexContainer4<ElementType, SourceObject>::create(IndexCombination4 const& Indices) {
+    std::shared_ptr<ElementType> pElement(Source.createElement(Indices));
+    NonTrivialElements.emplace(Indices, pElement);
+
+    insert(Indices, pElement);
+    for(auto const& EquivalentIndices : getSymmetryOrbit(Indices)) {
+        if(!isInContainer(EquivalentIndices))
+            insert(EquivalentIndices, pElement);
+    }
+
+    return ElementsMap.find(Indices)->second;
+}
+
+template <typename ElementType, typename SourceObject>
+inline void IndexContainer4<ElementType, SourceObject>::addSymmetry(IndexPermutation const& Permutation) {
+    IndexPermutation Identity(NumIndices);
+    std::iota(Identity.begin(), Identity.end(), 0);
+    if(Permutation.size() != NumIndices ||
+       !std::is_permutation(Permutation.begin(), Permutation.end(), Identity.begin()))
+        throw std::runtime_error("IndexContainer4: Invalid permutation of single-particle indices");
+    Symmetries.push_back(Permutation);
+}
 
-    return iter->second;
+template <typename ElementType, typename SourceObject>
+inline std::set<IndexCombination4>
+IndexContainer4<ElementType, SourceObject>::getSymmetryOrbit(IndexCombination4 const& Indices) const {
+    std::set<IndexCombination4> Orbit = {Indices};
+    std::vector<IndexCombination4> Queue = {Indices};
+    while(!Queue.empty()) {
+        IndexCombination4 Current = Queue.back();
+        Queue.pop_back();
+        for(auto const& s : Symmetries) {
+            IndexCombination4 Image(s[Current.Index1], s[Current.Index2], s[Current.Index3], s[Current.Index4]);
+            if(Orbit.insert(Image).second)
+                Queue.push_back(Image);
+        }
+    }
+    return Orbit;
 }
 
 template <typename ElementType, typename SourceObject>
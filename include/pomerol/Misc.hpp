@@ -35,8 +35,10 @@
 #include <array>
 #include <complex>
 #include <cstddef>
+#include <functional>
 #include <iostream>
 #include <type_traits>
+#include <vector>
 
 /// The main namespace of the library.
 namespace Pomerol {
@@ -150,6 +152,18 @@ struct Permutation4 {
 /// An array of all 4! = 24 permutations of 4 elements
 extern std::array<Permutation4, 24> const permutations4;
 
+/// Run independent jobs in the order of decreasing cost.
+///
+/// With OpenMP, the jobs are distributed among threads one at a time (dynamic scheduling).
+/// Nested parallel regions, such as those of multithreaded BLAS kernels, are disabled meanwhile.
+/// If \p SerialLarge is set, the jobs costlier than a fair share of one thread are run first, one
+/// after another, so that each of them can use all threads. An exception thrown by a job is
+/// rethrown after the other jobs have finished.
+/// \param[in] Costs Estimated costs of the jobs.
+/// \param[in] Job Function running the job with a given index in \p Costs.
+/// \param[in] SerialLarge Run the largest jobs one after another before the rest.
+void RunJobsByCost(std::vector<double> const& Costs, std::function<void(std::size_t)> const& Job, bool SerialLarge);
+
 ///@}
 
 } // namespace Pomerol
@@ -16,6 +16,7 @@
 #ifndef POMEROL_INCLUDE_MONOMIALOPERATOR_HPP
 #define POMEROL_INCLUDE_MONOMIALOPERATOR_HPP
 
+#include "BinaryArchive.hpp"
 #include "ComputableObject.hpp"
 #include "Hamiltonian.hpp"
 #include "HilbertSpace.hpp"
@@ -198,9 +199,29 @@ public:
     /// \pre \ref prepare() has been called.
     void compute(MPI_Comm const& comm = MPI_COMM_WORLD);
 
+    /// Free memory occupied by the sparse matrices made by conversion of the canonical
+    /// row-major matrices of all parts (see \ref MonomialOperatorPart::releaseConversions()).
+    void releaseConversions();
+
+    /// Write matrix elements of all parts to a checkpoint file.
+    /// \param[in] ar The checkpoint file.
+    /// \pre \ref compute() has been called.
+    void save(BinaryOutputArchive& ar) const;
+
+    /// Read matrix elements of all parts from a checkpoint file written by \ref save().
+    /// This is an alternative to \ref compute().
+    /// \param[in] ar The checkpoint file.
+    /// \pre \ref prepare() has been called.
+    void load(BinaryInputArchive& ar);
+
 private:
     // Implementation details
     void checkPrepared() const;
+    template <bool C> static void loadPart(MonomialOperatorPart& part, BinaryInputArchive& ar);
+
+    // Compute a list of parts, possibly belonging to different operators, in parallel
+    static void computeParts(std::vector<MonomialOperatorPart*> const& Parts, MPI_Comm const& comm);
+    template <bool C> static void broadcastPart(MonomialOperatorPart& part, int root, MPI_Comm const& comm);
 };
 
 /// A special case of a monomial operator: A single fermion creation operator \f$c^\dagger_i\f$.
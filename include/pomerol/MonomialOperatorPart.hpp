@@ -24,6 +24,7 @@
 #include <libcommute/algebra_ids.hpp>
 #include <libcommute/loperator/loperator.hpp>
 
+#include <cstddef>
 #include <memory>
 #include <ostream>
 #include <type_traits>
@@ -44,6 +45,7 @@ namespace Pomerol {
 /// \f]
 class MonomialOperatorPart : public ComputableObject {
     friend class FieldOperatorContainer;
+    friend class MonomialOperator;
 
 private:
     /// Whether the following \p libcommute::loperator object is complex-valued.
@@ -63,15 +65,21 @@ private:
 
 protected:
     /// Type-erased real/complex sparse matrix \f$\langle {\rm left}|\hat M|{\rm right}\rangle\f$
-    /// stored in the row-major order.
-    std::shared_ptr<void> elementsRowMajor;
+    /// stored in the row-major order. This is the canonical storage of a computed part.
+    /// For parts set by \ref setFromAdjoint(), it is a conversion made on first request.
+    mutable std::shared_ptr<void> elementsRowMajor;
     /// Type-erased real/complex sparse matrix \f$\langle {\rm left}|\hat M|{\rm right}\rangle\f$
-    /// stored in the column-major order.
-    std::shared_ptr<void> elementsColMajor;
+    /// stored in the column-major order. This is a conversion made on first request.
+    mutable std::shared_ptr<void> elementsColMajor;
+    /// The part this part is the Hermitian conjugate of, if it has been set by \ref setFromAdjoint().
+    MonomialOperatorPart const* AdjointOf = nullptr;
     /// Matrix elements with the absolute value below this threshold are considered negligible.
     RealType const MatrixElementTolerance = 1e-8;
 
 public:
+    /// Default number of elements in a tile of the rotated matrix formed at once by \ref compute().
+    static constexpr Eigen::Index DefaultRotationTileSize = 1 << 20;
+
     /// Constructor.
     /// \tparam ScalarType Scalar type (either double or std::complex<double>) of the linear operator \p MOp.
     /// \param[in] MOp The linear operator object corresponding to the monomial operator \f$\hat M\f$.
@@ -90,18 +98,37 @@ public:
           HFrom(HFrom),
           HTo(HTo) {}
 
+    /// Parts are not copyable: a copy would share the stored matrices and the
+    /// link to the part it is the Hermitian conjugate of (see \ref setFromAdjoint()).
+    MonomialOperatorPart(MonomialOperatorPart const&) = delete;
+    MonomialOperatorPart& operator=(MonomialOperatorPart const&) = delete;
+    /// Move constructor.
+    MonomialOperatorPart(MonomialOperatorPart&&) = default;
+
     /// Compute and store all matrix elements of \f$\hat M\f$ in the eigenbasis of the Hamiltonian.
-    void compute();
+    /// \param[in] RotationTileSize Number of elements in a tile of the rotated matrix formed at once.
+    ///                             Larger tiles use more memory, smaller ones make the products less efficient.
+    void compute(Eigen::Index RotationTileSize = DefaultRotationTileSize);
 
-    /// Reset the stored sparse matrices to those obtained from
+    /// Make this part the Hermitian conjugate of
     /// \f$\langle {\rm right}|\hat M^\dagger|{\rm left}\rangle\f$.
+    /// No matrices are copied: they are obtained from the matrix of \p part on request.
     /// \param[in] part Monomial operator part \f$\langle {\rm right}|\hat M^\dagger|{\rm left}\rangle\f$.
+    /// \pre \p part must outlive this object.
     void setFromAdjoint(MonomialOperatorPart const& part);
 
+    /// Free memory occupied by the sparse matrices made by conversion (change of the storage order or
+    /// Hermitian conjugation) of the canonical row-major matrix. They will be made again on request.
+    /// References returned by \ref getRowMajorValue() and \ref getColMajorValue() may become invalid.
+    void releaseConversions();
+
     /// Is this object storing a complex-valued sparse matrices?
     bool isComplex() const { return Complex; }
 
-    /// Return a reference to the stored row-major sparse matrix.
+    /// Return a reference to the stored row-major sparse matrix for modification.
+    /// The column-major copy made by \ref getColMajorValue() is discarded, as it would become outdated.
+    /// Throws \p std::runtime_error if this part is a Hermitian conjugate (see \ref setFromAdjoint()),
+    /// whose matrix is not owned by it.
     /// \tparam C Request a reference to the complex-valued matrix.
     /// \pre The compile-time value of \p C must agree with the result of \ref isComplex().
     template <bool C> RowMajorMatrixType<C>& getRowMajorValue();
@@ -109,15 +136,16 @@ public:
     /// \tparam C Request a reference to the complex-valued matrix.
     /// \pre The compile-time value of \p C must agree with the result of \ref isComplex().
     template <bool C> RowMajorMatrixType<C> const& getRowMajorValue() const;
-    /// Return a reference to the stored column-major sparse matrix.
-    /// \tparam C Request a reference to the complex-valued matrix.
-    /// \pre The compile-time value of \p C must agree with the result of \ref isComplex().
-    template <bool C> ColMajorMatrixType<C>& getColMajorValue();
     /// Return a constant reference to the stored column-major sparse matrix.
+    /// The matrix is made by conversion on first call.
     /// \tparam C Request a reference to the complex-valued matrix.
     /// \pre The compile-time value of \p C must agree with the result of \ref isComplex().
     template <bool C> ColMajorMatrixType<C> const& getColMajorValue() const;
 
+    /// Return the number of stored nonzero matrix elements.
+    /// \pre \ref compute() or \ref setFromAdjoint() has been called.
+    std::size_t getNumberOfNonZeros() const;
+
     /// Return the index of the right invariant subspace.
     BlockNumber getRightIndex() const { return HFrom.getBlockNumber(); }
     /// Return the index of the left invariant subspace.
@@ -137,7 +165,7 @@ public:
 
 private:
     // Implementation details
-    template <bool C, bool HC> void computeImpl();
+    template <bool C, bool HC> void computeImpl(Eigen::Index RotationTileSize);
     template <bool C> void streamOutputImpl(std::ostream& os) const;
 };
 
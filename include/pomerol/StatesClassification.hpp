@@ -16,6 +16,7 @@
 #ifndef POMEROL_INCLUDE_STATESCLASSIFICATION_HPP
 #define POMEROL_INCLUDE_STATESCLASSIFICATION_HPP
 
+#include "BinaryArchive.hpp"
 #include "HilbertSpace.hpp"
 #include "Misc.hpp"
 
@@ -101,6 +102,16 @@ public:
     /// \pre \ref compute() has been called.
     InnerQuantumState getInnerState(QuantumState in) const;
 
+    /// Write the Fock state lists to a checkpoint file.
+    /// \param[in] ar The checkpoint file.
+    /// \pre \ref compute() has been called.
+    void save(BinaryOutputArchive& ar) const;
+
+    /// Read the Fock state lists from a checkpoint file written by \ref save().
+    /// This is an alternative to \ref compute().
+    /// \param[in] ar The checkpoint file.
+    void load(BinaryInputArchive& ar);
+
 private:
     /// Initialize data members for a single un-partitioned Hilbert space.
     /// \param[in] Dim Dimension of the Hilbert space.
@@ -28,6 +28,8 @@
 #include "Thermal.hpp"
 
 #include <complex>
+#include <map>
+#include <memory>
 #include <numeric>
 #include <vector>
 
@@ -70,6 +72,11 @@ class Susceptibility : public Thermal, public ComputableObject {
     /// The list of all \ref SusceptibilityPart's contributing to this susceptibility.
     std::vector<SusceptibilityPart> parts;
 
+    /// Temperature-independent products of matrix elements of the parts, indexed by the 'outer' subspace.
+    using ProductsMap = std::map<BlockNumber, std::shared_ptr<SusceptibilityPart::MatrixElementProducts const>>;
+    /// Products of matrix elements shared by all objects constructed from this one for other density matrices.
+    std::shared_ptr<ProductsMap> Products;
+
     /// Subtract the disconnected part \f$\langle\hat A \rangle \langle\hat B \rangle\f$?
     bool SubtractDisconnected = false;
 
@@ -77,6 +84,11 @@ class Susceptibility : public Thermal, public ComputableObject {
     ComplexType ave_A = {}, ave_B = {};
 
 public:
+    /// Keep the temperature-independent products of matrix elements computed by \ref compute().
+    /// They are reused by objects constructed from this one for other density matrices,
+    /// which inherit this flag.
+    bool KeepMatrixElementProducts = false;
+
     /// Constructor.
     /// \param[in] S Information about invariant subspaces of the Hamiltonian.
     /// \param[in] H The Hamiltonian.
@@ -93,6 +105,17 @@ public:
     /// \param[in] Chi \ref Susceptibility object to be copied.
     Susceptibility(Susceptibility const& Chi);
 
+    /// Construct a susceptibility of the same operators \f$\hat A\f$ and \f$\hat B\f$
+    /// for another density matrix, e.g. at another temperature. The temperature-independent
+    /// products of matrix elements computed by \p Chi (or by any other object sharing them) are
+    /// reused, so that \ref compute() only has to combine them with the new statistical weights.
+    /// The products are available only if \p Chi has been computed with \ref KeepMatrixElementProducts set.
+    /// The disconnected part is not subtracted from the constructed object.
+    /// \param[in] Chi \ref Susceptibility object to take the operators and the matrix elements from.
+    /// \param[in] DM Many-body density matrix \f$\hat\rho\f$.
+    /// \pre \p DM is defined for the same Hamiltonian as the density matrix of \p Chi.
+    Susceptibility(Susceptibility const& Chi, DensityMatrix const& DM);
+
     /// Select all relevant parts of \f$\hat A\f$ and \f$\hat B\f$
     /// and allocate resources for the \ref SusceptibilityPart's.
     void prepare();
@@ -128,6 +151,16 @@ public:
     /// \param[in] tau Imaginary time point.
     ComplexType of_tau(RealType tau) const;
 
+    /// Return the susceptibility values calculated at a list of complex frequencies.
+    /// This method is much faster than repeated calls to \ref operator()(ComplexType) const.
+    /// \param[in] z List of complex frequencies \f$z\f$.
+    std::vector<ComplexType> evaluate(std::vector<ComplexType> const& z) const;
+
+    /// Return the susceptibility values calculated at a list of Matsubara frequencies.
+    /// This method is much faster than repeated calls to \ref operator()(long) const.
+    /// \param[in] MatsubaraNumbers List of Matsubara indices \f$n\f$ (\f$\omega_n=2\pi n/\beta\f$).
+    std::vector<ComplexType> evaluate(std::vector<long> const& MatsubaraNumbers) const;
+
     /// Is this susceptibility identically zero?
     bool isVanishing() const { return Vanishing; }
 };
@@ -28,7 +28,9 @@
 
 #include <complex>
 #include <cstddef>
+#include <memory>
 #include <ostream>
+#include <vector>
 
 namespace Pomerol {
 
@@ -45,6 +47,21 @@ namespace Pomerol {
 /// The contributions are stored as terms of the Lehmann representation, i.e. as
 /// fractions \f$\frac{R}{z - P}\f$ with real poles \f$P\f$ and complex residues \f$R\f$.
 class SusceptibilityPart : public Thermal {
+public:
+    /// A temperature-independent product of matrix elements
+    /// \f$\langle{\rm outer}|\hat A|{\rm inner}\rangle\langle{\rm inner}|\hat B|{\rm outer}\rangle\f$.
+    struct MatrixElementProduct {
+        /// Value of the product.
+        ComplexType Value;
+        /// Index of the eigenstate within the 'inner' subspace.
+        InnerQuantumState Inner;
+        /// Index of the eigenstate within the 'outer' subspace.
+        InnerQuantumState Outer;
+    };
+    /// List of products of matrix elements.
+    using MatrixElementProducts = std::vector<MatrixElementProduct>;
+
+private:
     /// Diagonal block of the Hamiltonian corresponding to the 'inner' subspace.
     HamiltonianPart const& HpartInner;
     /// Diagonal block of the Hamiltonian corresponding to the 'outer' subspace.
@@ -81,6 +98,10 @@ class SusceptibilityPart : public Thermal {
             /// \param[in] t1 First term.
             /// \param[in] t2 Second term.
             bool operator()(Term const& t1, Term const& t2) const { return t2.Pole - t1.Pole >= Tolerance; }
+            /// Exact order of the poles (a strict weak ordering used to sort the terms).
+            /// \param[in] t1 First term.
+            /// \param[in] t2 Second term.
+            bool exact_less(Term const& t1, Term const& t2) const { return t1.Pole < t2.Pole; }
         };
 
         /// Predicate: Does a term have a negligible residue?
@@ -133,7 +154,7 @@ class SusceptibilityPart : public Thermal {
     }
 
     /// List of all terms contributing to this part.
-    TermList<Term> Terms;
+    FlatTermList<Term> Terms;
 
     /// Matrix elements with magnitudes below this value are treated as negligible.
     RealType const MatrixElementTolerance = 1e-8;
@@ -141,7 +162,15 @@ class SusceptibilityPart : public Thermal {
     /// Weight of the zero-energy pole.
     ComplexType ZeroPoleWeight = 0;
 
+    /// Relevant products of matrix elements. They are shared by parts computed
+    /// at different temperatures and are kept after \ref compute() only on request.
+    std::shared_ptr<MatrixElementProducts const> Products;
+
 public:
+    /// Keep the products of matrix elements after \ref compute(), so that they can be passed to
+    /// parts computed for other density matrices (see \ref getMatrixElementProducts()).
+    bool KeepProducts = false;
+
     /// Constructor.
     /// \param[in] A Part of the monomial operator \f$\hat A\f$.
     /// \param[in] B Part of the monomial operator \f$\hat B\f$.
@@ -151,16 +180,27 @@ public:
     ///                        corresponding to the 'inner' subspace.
     /// \param[in] DMpartOuter Part of the many-body density matrix \f$\hat\rho\f$
     ///                        corresponding to the 'outer' subspace.
+    /// \param[in] Products Products of matrix elements of \p A and \p B computed by a part at
+    ///                     another temperature. If null, the products are computed by \ref compute().
     SusceptibilityPart(MonomialOperatorPart const& A,
                        MonomialOperatorPart const& B,
                        HamiltonianPart const& HpartInner,
                        HamiltonianPart const& HpartOuter,
                        DensityMatrixPart const& DMpartInner,
-                       DensityMatrixPart const& DMpartOuter);
+                       DensityMatrixPart const& DMpartOuter,
+                       std::shared_ptr<MatrixElementProducts const> Products = nullptr);
 
     /// Compute the terms contributing to this part.
+    /// Products of matrix elements are computed only if they have not been provided at construction.
     void compute();
 
+    /// Return the products of matrix elements.
+    /// The result is null unless \ref compute() has been called with \ref KeepProducts set.
+    std::shared_ptr<MatrixElementProducts const> getMatrixElementProducts() const { return Products; }
+
+    /// Return the index of the 'outer' subspace.
+    BlockNumber getOuterBlock() const { return HpartOuter.getBlockNumber(); }
+
     /// Substitute a complex frequency \f$z\f$ into this part.
     /// \param[in] z Value of the frequency \f$z\f$.
     ComplexType operator()(ComplexType z) const;
@@ -174,12 +214,18 @@ public:
     /// \param[in] tau Imaginary time point.
     ComplexType of_tau(RealType tau) const;
 
+    /// Substitute a list of complex frequencies into this part and add the results to \p out.
+    /// \param[in] z List of complex frequencies \f$z\f$.
+    /// \param[inout] out Values of this part at \p z are added to elements of this vector.
+    ///                   Its size must be equal to that of \p z.
+    void evaluate(std::vector<ComplexType> const& z, std::vector<ComplexType>& out) const;
+
     /// A difference in energies with magnitude below this value is treated as zero.
     RealType const ReduceResonanceTolerance = 1e-8;
 
 private:
     // Implementation detail of compute().
-    template <bool AComplex, bool BComplex> void computeImpl();
+    template <bool AComplex, bool BComplex> std::shared_ptr<MatrixElementProducts const> computeProducts() const;
 };
 
 ///@}
@@ -19,6 +19,8 @@
 
 #include "mpi_dispatcher/misc.hpp"
 
+#include <algorithm>
+#include <cassert>
 #include <cstddef>
 #include <set>
 #include <utility>
@@ -139,6 +141,183 @@ public:
     }
 };
 
+/// \brief A flat list of terms contributing to the Lehmann representation of a correlation function.
+///
+/// This container is a drop-in alternative to \ref TermList optimized for massive insertion of terms.
+/// Instead of looking up each new term in a tree, \ref add_term() appends it to a contiguous buffer.
+/// Once the buffer of unprocessed terms grows as large as the already processed part of the list,
+/// the buffer is sorted and merged into the processed part. The amortized cost of an insertion is
+/// logarithmic in the number of terms, and the terms end up in a flat sorted vector, which is also cheap
+/// to iterate over and to transfer via MPI.
+///
+/// The similarity of terms defined by \p TermType::Compare involves a tolerance and is not transitive,
+/// so it cannot be used for sorting. The terms are instead sorted w.r.t. the exact order of their poles,
+/// \p TermType::Compare::exact_less(), which is a strict weak ordering. Runs of neighbouring terms that are
+/// similar w.r.t. \p TermType::Compare are then reduced to one term using \p operator+=(), and a reduced
+/// term is removed if it is negligible. Similar terms that are separated by a dissimilar one in the exact order
+/// (this requires the leading poles to differ by less than the tolerance) stay separate, which does not change
+/// the value of the sum. As with \ref TermList, a single term that has not been reduced with others is kept
+/// even if it is negligible.
+///
+/// Accessors that expect a fully reduced list (\ref size(), \ref as_vector(), \ref operator()(),
+/// \ref check_terms()) require a call to \ref flush() after the last \ref add_term().
+/// \tparam TermType Type of a single term.
+template <typename TermType> class FlatTermList {
+
+    /// Type of the term comparison predicate.
+    using Compare = typename TermType::Compare;
+    /// Type of the term 'is negligible' predicate.
+    using IsNegligible = typename TermType::IsNegligible;
+
+    /// Minimal number of unprocessed terms that triggers processing of the buffer.
+    static constexpr std::size_t MinBufferSize = 1024;
+
+    /// Sorted and reduced terms followed by a buffer of unprocessed terms.
+    std::vector<TermType> data;
+    /// Number of sorted and reduced terms at the beginning of \ref data.
+    std::size_t n_sorted = 0;
+    /// The term comparison predicate.
+    Compare compare;
+    /// The 'is negligible' predicate.
+    IsNegligible is_negligible;
+
+public:
+    /// Constructor.
+    /// \param[in] compare Predicate used to sort the terms.
+    /// \param[in] is_negligible Predicate that determines whether a term can be neglected.
+    FlatTermList(Compare const& compare, IsNegligible const& is_negligible)
+        : compare(compare), is_negligible(is_negligible) {}
+
+    /// Add a new term to the container
+    /// \param[in] term Term to be added
+    void add_term(TermType const& term) {
+        data.push_back(term);
+        if(data.size() - n_sorted >= std::max(n_sorted, MinBufferSize))
+            flush();
+    }
+
+    /// Sort the buffered terms, merge them into the sorted part of the list,
+    /// reduce similar terms and remove negligible ones.
+    void flush() {
+        if(n_sorted == data.size())
+            return;
+
+        auto exact_less = [this](TermType const& t1, TermType const& t2) { return compare.exact_less(t1, t2); };
+        auto middle = data.begin() + n_sorted;
+        std::stable_sort(middle, data.end(), exact_less);
+        std::inplace_merge(data.begin(), middle, data.end(), exact_less);
+
+        // Reduce runs of similar neighbouring terms and drop the negligible results of the reduction
+        auto out = data.begin();
+        for(auto it = data.begin(); it != data.end();) {
+            TermType sum = *it;
+            bool reduced = false;
+            for(++it; it != data.end() && !compare(sum, *it) && !compare(*it, sum); ++it) {
+                sum += *it;
+                reduced = true;
+            }
+            if(!reduced || !is_negligible(sum, std::size_t(out - data.begin()) + 1))
+                *out++ = sum;
+        }
+        data.erase(out, data.end());
+
+        n_sorted = data.size();
+    }
+
+    /// Number of terms in the container.
+    std::size_t size() const {
+        assert(n_sorted == data.size());
+        return data.size();
+    }
+
+    /// Number of stored terms including the unprocessed ones. Unlike \ref size(), it does not require
+    /// a call to \ref flush().
+    std::size_t stored_size() const { return data.size(); }
+
+    /// Remove all terms from the container and release the memory occupied by them.
+    void clear() {
+        std::vector<TermType>().swap(data);
+        n_sorted = 0;
+    }
+
+    /// Replace the content of the container with a sequence of terms that is already sorted
+    /// and reduced, such as the content of another \ref FlatTermList.
+    /// \tparam Iterator Type of the iterators pointing to the terms.
+    /// \param[in] first Iterator pointing to the first term.
+    /// \param[in] last Iterator pointing past the last term.
+    template <typename Iterator> void assign_sorted(Iterator first, Iterator last) {
+        data.assign(first, last);
+        n_sorted = data.size();
+    }
+
+    /// Access the underlying sorted vector of terms.
+    std::vector<TermType> const& as_vector() const {
+        assert(n_sorted == data.size());
+        return data;
+    }
+
+    /// Access the term comparison predicate.
+    Compare const& get_compare() const { return compare; }
+
+    /// Access the 'is negligible' predicate.
+    IsNegligible const& get_is_negligible() const { return is_negligible; }
+
+    /// Forward arguments to \p TermType:::operator() of each term in the container
+    /// and return a sum of their return values.
+    /// \tparam Args Types of the arguments.
+    /// \param[in] args Arguments to be passes to the terms.
+    template <typename... Args> ComplexType operator()(Args&&... args) const {
+        assert(n_sorted == data.size());
+        ComplexType res = 0;
+        for(auto const& t : data)
+            res += t(std::forward<Args>(args)...);
+        return res;
+    }
+
+    /// Broadcast terms from a root MPI rank to all other ranks in a communicator.
+    /// \param[in] comm The MPI communicator for the broadcast operation.
+    /// \param[in] root Rank of the root MPI process.
+    void broadcast(MPI_Comm const& comm, int root) {
+        compare.broadcast(comm, root);
+
+        long n_terms;
+        if(pMPI::rank(comm) == root) { // Broadcast the terms from this process
+            flush();
+            n_terms = data.size();
+            MPI_Bcast(&n_terms, 1, MPI_LONG, root, comm);
+        } else { // Receive terms
+            MPI_Bcast(&n_terms, 1, MPI_LONG, root, comm);
+            data.resize(n_terms);
+            n_sorted = n_terms;
+        }
+        MPI_Bcast(data.data(), static_cast<int>(n_terms), TermType::mpi_datatype(), root, comm);
+
+        is_negligible.broadcast(comm, root);
+    }
+
+    /// Check if all terms in the container are properly ordered and are not negligible.
+    bool check_terms() const {
+        if(n_sorted != data.size())
+            return false;
+        if(size() == 0)
+            return true;
+        auto prev_it = data.begin();
+        if(is_negligible(*prev_it, data.size() + 1))
+            return false;
+        if(size() == 1)
+            return true;
+
+        auto it = prev_it;
+        for(++it; it != data.end(); ++it, ++prev_it) {
+            if(is_negligible(*it, data.size() + 1) || compare.exact_less(*it, *prev_it))
+                return false;
+        }
+        return true;
+    }
+};
+
+template <typename TermType> constexpr std::size_t FlatTermList<TermType>::MinBufferSize;
+
 ///@}
 
 } // namespace Pomerol
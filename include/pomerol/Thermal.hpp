@@ -18,6 +18,7 @@
 #include "Misc.hpp"
 
 #include <cmath>
+#include <vector>
 
 namespace Pomerol {
 
@@ -34,6 +35,26 @@ struct Thermal {
     /// Construct a thermal object for a given inverse temperature.
     /// \param[in] beta Inverse temperature \f$\beta\f$
     explicit Thermal(RealType beta) : beta(beta), MatsubaraSpacing(I * M_PI / beta) {}
+
+    /// Return a list of fermionic Matsubara frequencies \f$i\pi(2n+1)/\beta\f$.
+    /// \param[in] MatsubaraNumbers List of Matsubara indices \f$n\f$.
+    std::vector<ComplexType> fermionicMatsubaraGrid(std::vector<long> const& MatsubaraNumbers) const {
+        std::vector<ComplexType> grid;
+        grid.reserve(MatsubaraNumbers.size());
+        for(long n : MatsubaraNumbers)
+            grid.push_back(MatsubaraSpacing * RealType(2 * n + 1));
+        return grid;
+    }
+
+    /// Return a list of bosonic Matsubara frequencies \f$2i\pi n/\beta\f$.
+    /// \param[in] MatsubaraNumbers List of Matsubara indices \f$n\f$.
+    std::vector<ComplexType> bosonicMatsubaraGrid(std::vector<long> const& MatsubaraNumbers) const {
+        std::vector<ComplexType> grid;
+        grid.reserve(MatsubaraNumbers.size());
+        for(long n : MatsubaraNumbers)
+            grid.push_back(MatsubaraSpacing * RealType(2 * n));
+        return grid;
+    }
 };
 
 ///@}
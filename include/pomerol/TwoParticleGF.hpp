@@ -16,9 +16,11 @@
 #ifndef POMEROL_INCLUDE_TWOPARTICLEGF_HPP
 #define POMEROL_INCLUDE_TWOPARTICLEGF_HPP
 
+#include "BinaryArchive.hpp"
 #include "ComputableObject.hpp"
 #include "DensityMatrix.hpp"
 #include "Hamiltonian.hpp"
+#include "Index.hpp"
 #include "Misc.hpp"
 #include "MonomialOperator.hpp"
 #include "StatesClassification.hpp"
@@ -26,10 +28,13 @@
 #include "TwoParticleGFPart.hpp"
 
 #include "mpi_dispatcher/misc.hpp"
+#include "mpi_dispatcher/mpi_dispatcher.hpp"
 
 #include <cstddef>
+#include <map>
 #include <numeric>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace Pomerol {
@@ -37,11 +42,6 @@ namespace Pomerol {
 /// \defgroup 2PGF Two-particle Green's functions of fermions
 ///@{
 
-/// Triplet of complex frequencies.
-using FreqTuple = std::tuple<ComplexType, ComplexType, ComplexType>;
-/// List of complex frequency triplets.
-using FreqVec = std::vector<FreqTuple>;
-
 /// \brief Fermionic two-particle Matsubara Green's function.
 ///
 /// \f[ \chi_{ijkl}(\omega_{n_1},\omega_{n_2};\omega_{n_3},\omega_{n_1}+\omega_{n_2}-\omega_{n_3}) =
@@ -78,6 +78,37 @@ protected:
     /// A flag that marks an identically vanishing Green's function.
     bool Vanishing = true;
 
+    /// Number of frequencies per chunk reduced at once in the distributed output mode.
+    static constexpr std::size_t OutputChunkSize = 1 << 16;
+
+    /// Evaluate the locally computed parts at \p freqs and reduce the results to the owners of
+    /// the frequency slices.
+    /// \param[in] freqs List of frequency triplets.
+    /// \param[in] job_map Mapping from indices of the parts to the ranks of processes that computed them.
+    /// \param[in] LocalValues Values of the locally computed parts at all of \p freqs, if they have been
+    ///                        evaluated before the parts were cleared. If empty, the parts are evaluated
+    ///                        chunk by chunk.
+    /// \param[in] comm MPI communicator.
+    /// \return Values at the frequencies from the slice owned by the calling process.
+    std::vector<ComplexType> reduceDistributed(FreqVec const& freqs,
+                                               std::map<pMPI::JobId, pMPI::WorkerId> const& job_map,
+                                               std::vector<ComplexType> const& LocalValues,
+                                               MPI_Comm const& comm) const;
+
+    /// Make the terms of all parts available on all processes in a communicator. Terms of the parts
+    /// computed by each process are packed into contiguous buffers and exchanged with one collective
+    /// call per kind of terms. Afterwards, the parts are frozen (see \ref TwoParticleGFPart::freeze()).
+    /// \param[in] PartOwners Ranks of the processes that computed the parts.
+    /// \param[in] comm MPI communicator.
+    void shareTerms(std::vector<int> const& PartOwners, MPI_Comm const& comm);
+
+    /// Write the terms of all parts to a checkpoint file (see \ref saveTerms()).
+    /// \param[in] ar The checkpoint file.
+    /// \param[in] Aliases Index combinations \f$(i,j,k,l)\f$ represented by this Green's function, each paired
+    ///                    with the serial number of the frequency permutation within \ref permutations4.
+    void writeTerms(BinaryOutputArchive& ar,
+                    std::vector<std::pair<IndexCombination4, std::size_t>> const& Aliases) const;
+
     /// Extract the operator part standing at a specified position in a given permutation of the list
     /// \f$\{c_i,c_j,c^\dagger_k,c^\dagger_l\}\f$.
     /// \param[in] PermutationNumber Serial number of the permutation within \ref permutations3.
@@ -111,6 +142,19 @@ public:
     /// Minimal magnitude of the coefficient of a term for it to be taken into account with respect to
     /// the amount of terms.
     RealType MultiTermCoefficientTolerance = 1e-5;
+    /// Keep the precomputed values distributed among MPI processes. If true, \ref compute() returns
+    /// only the values at the frequencies from the slice of the list owned by the calling process
+    /// (see \ref getOutputSlice()).
+    bool DistributedOutput = false;
+    /// Round the poles of the terms to single precision when converting them to the compact form
+    /// (see \ref compactTerms()). The resulting error can be checked with \ref getPoleError().
+    bool SinglePrecisionPoles = false;
+    /// Call \ref compactTerms() at the end of \ref compute(), if the terms are not cleared.
+    bool CompactTerms = false;
+    /// If nonzero, \ref compute() called with \p clear = true and a list of frequencies does not store
+    /// all terms of a part at once. Instead, it evaluates them in batches of at most this many terms
+    /// per thread (see \ref TwoParticleGFPart::computeStreaming()). Ignored in the distributed output mode.
+    std::size_t StreamingBatchSize = 0;
 
     /// Constructor.
     /// \param[in] S Information about invariant subspaces of the Hamiltonian.
@@ -132,15 +176,31 @@ public:
     void prepare();
 
     /// Compute the parts in parallel and fill the internal cache of precomputed values.
+    ///
+    /// If \ref DistributedOutput is set, the values are computed in chunks of frequencies.
+    /// Contributions of the parts computed by different processes to each chunk are summed up with
+    /// a non-blocking reduction to the process owning the chunk, which overlaps with the evaluation
+    /// of the next chunk. If \p clear is false, no process stores values outside its own slice of
+    /// the frequency list. Otherwise, each part is evaluated and destroyed right after it has been
+    /// computed, and its values are accumulated in a process-local list. This way, only the terms of
+    /// the part being computed are stored at any time.
     /// \param[in] clear If true, computed \ref TwoParticleGFPart's will be destroyed immediately after
     ///                  filling the precomputed value cache.
     /// \param[in] freqs List of frequency triplets \f$(\omega_{n_1},\omega_{n_2},\omega_{n_3})\f$.
     /// \param[in] comm MPI communicator used to parallelize the computation.
-    /// \return A list of precomputed values.
+    /// \return A list of precomputed values (only for the owned slice of \p freqs in the distributed output mode).
     /// \pre \ref prepare() has been called.
     std::vector<ComplexType>
     compute(bool clear = false, FreqVec const& freqs = {}, MPI_Comm const& comm = MPI_COMM_WORLD);
 
+    /// Return the range of positions in a list of frequencies owned by an MPI process in the
+    /// distributed output mode.
+    /// \param[in] NFreqs Size of the frequency list.
+    /// \param[in] Rank Rank of the process.
+    /// \param[in] Size Number of processes.
+    /// \return The first position and the position past the last one.
+    static std::pair<std::size_t, std::size_t> getOutputSlice(std::size_t NFreqs, int Rank, int Size);
+
     /// Returns the single particle index of one of the operators \f$c_i,c_j,c^\dagger_k,c^\dagger_l\f$.
     /// \param[in] Position Position of the requested operator, 0--3.
     ParticleIndex getIndex(std::size_t Position) const;
@@ -160,8 +220,42 @@ public:
     ///                             \f$n_3\f$ (\f$\omega_{n_3}=\pi(2n_3+1)/\beta\f$).
     ComplexType operator()(long MatsubaraNumber1, long MatsubaraNumber2, long MatsubaraNumber3) const;
 
+    /// Return the values of the two-particle Green's function calculated at a list of complex frequency triplets.
+    /// This method ignores the precomputed value cache and requires the computed \ref TwoParticleGFPart's
+    /// to be kept (see \ref compute()). It is much faster than repeated calls to \ref operator()().
+    /// \param[in] freqs List of frequency triplets \f$(z_1, z_2, z_3)\f$.
+    std::vector<ComplexType> evaluate(FreqVec const& freqs) const;
+
+    /// Write the terms of all parts to a checkpoint file in the structure-of-arrays form.
+    /// The file can be read by \ref TwoParticleGFTerms, which evaluates the Green's function
+    /// at arbitrary frequencies without the Hamiltonian, the operators and the density matrix.
+    /// \param[in] ar The checkpoint file.
+    /// \pre \ref compute() has been called with \p clear = false, and the terms are available
+    ///      on the calling process.
+    void saveTerms(BinaryOutputArchive& ar) const;
+
+    /// Convert the terms of all parts kept by the calling process to the compact structure-of-arrays form
+    /// and release the original term lists (see \ref TwoParticleGFPart::compact()). A non-resonant term then
+    /// occupies 40 bytes instead of 48, and a resonant one 56 bytes instead of 64 (28 and 44 bytes respectively
+    /// if \ref SinglePrecisionPoles is set).
+    /// The compact terms can be evaluated, but not shared among MPI processes.
+    /// \pre \ref compute() has been called.
+    void compactTerms();
+
+    /// Return the maximal absolute error of the poles introduced by rounding to single precision
+    /// over all parts kept by the calling process (see \ref TwoParticleGFPart::getPoleError()).
+    RealType getPoleError() const;
+
+    /// Estimate the cost of computing all parts as a sum of \ref TwoParticleGFPart::estimateCost().
+    /// \pre \ref prepare() has been called.
+    double estimateCost() const;
+
     /// Is this Green's function identically zero?
     bool isVanishing() const { return Vanishing; }
+
+    /// Access the list of parts. The parts are distributed among MPI processes by \ref compute()
+    /// in the order of decreasing \ref TwoParticleGFPart::estimateCost().
+    std::vector<TwoParticleGFPart> const& getParts() const { return parts; }
 };
 
 ///@}
@@ -170,6 +264,8 @@ inline ComplexType TwoParticleGF::operator()(ComplexType z1, ComplexType z2, Com
     if(Vanishing)
         return 0;
     else {
+        if(getStatus() < Computed)
+            throw StatusMismatch("TwoParticleGF: Terms have not been computed or are kept by another process.");
         return std::accumulate(parts.begin(),
                                parts.end(),
                                ComplexType(0),
@@ -17,6 +17,7 @@
 #define POMEROL_INCLUDE_TWOPARTICLEGFCONTAINER_HPP
 
 #include "DensityMatrix.hpp"
+#include "BinaryArchive.hpp"
 #include "FieldOperatorContainer.hpp"
 #include "Hamiltonian.hpp"
 #include "Index.hpp"
@@ -57,6 +58,31 @@ public:
     /// Minimal magnitude of the coefficient of a term for it to be taken into account with respect to
     /// the amount of terms.
     RealType MultiTermCoefficientTolerance = 1e-5;
+    /// Keep the precomputed values distributed among MPI processes. If true, \ref computeAll()
+    /// returns only the values at the frequencies from the slice of the list owned by the calling process
+    /// within \p comm (see \ref TwoParticleGF::getOutputSlice()), and no process stores the complete lists.
+    bool DistributedOutput = false;
+    /// Keep the computed terms only on the processes that computed them. If true and the terms are not
+    /// cleared, \ref computeAll() does not send the terms of an element to processes outside the group
+    /// that computed it. Values of such elements are available via the collective method \ref evaluate().
+    /// On the other processes, the elements stay uncomputed, and their own evaluation methods throw.
+    bool DistributedTerms = false;
+    /// Strategy of splitting the MPI communicator in \ref computeAll(). If true, the number of processes
+    /// computing an element is proportional to its estimated cost (\ref TwoParticleGF::estimateCost()),
+    /// small groups of processes are placed within one shared memory node, and the least expensive
+    /// elements are handed out to the groups that finish their work first. Otherwise, the processes are
+    /// split into groups of equal size, and each group computes an equal number of elements.
+    bool BalancedSplit = true;
+    /// Round the poles of the terms to single precision when converting them to the compact form
+    /// (see \ref TwoParticleGF::SinglePrecisionPoles).
+    bool SinglePrecisionPoles = false;
+    /// Convert the terms of all elements to the compact form at the end of \ref computeAll(), if they are not
+    /// cleared (see \ref TwoParticleGF::compactTerms()). This is done after the terms have been distributed
+    /// among MPI processes.
+    bool CompactTerms = false;
+    /// Evaluate the terms in batches of at most this many terms per thread when they are cleared
+    /// by \ref computeAll() (see \ref TwoParticleGF::StreamingBatchSize).
+    std::size_t StreamingBatchSize = 0;
 
     /// Constructor.
     /// \tparam IndexTypes Types of indices carried by the creation and annihilation operators.
@@ -78,10 +104,21 @@ public:
           DM(DM),
           Operators(Ops) {}
 
-    /// Prepare a set of elements \f$\chi_{ijkl}\f$.
+    /// Prepare a set of elements \f$\chi_{ijkl}\f$. Elements related by the symmetries declared with
+    /// \ref addSymmetry() are represented by a single \ref TwoParticleGF object. Identically vanishing
+    /// elements (see \ref findNonVanishing()) are not created.
     /// \param[in] Indices Set of index combinations of the elements \f$\chi_{ijkl}\f$ to be prepared.
     ///            An empty set results in creation of elements for all possible index combinations \f$(i,j,k,l)\f$.
     void prepareAll(std::set<IndexCombination4> const& Indices = {});
+    /// Find all index combinations \f$(i,j,k,l)\f$ of the stored creation/annihilation operators,
+    /// for which \f$\chi_{ijkl}\f$ is not identically zero. Such elements have at least one sequence
+    /// of invariant subspaces connected by the operators \f$c_i, c_j, c^\dagger_k, c^\dagger_l\f$
+    /// in some order and including a subspace retained in the density matrix (cf. \ref TwoParticleGF::prepare()).
+    /// The combinations are found in bulk by walking the subspace connection graphs of the operators,
+    /// without creating any \ref TwoParticleGF objects.
+    /// \pre The operators have been prepared.
+    std::set<IndexCombination4> findNonVanishing() const;
+
     /// Compute all prepared elements \f$\chi_{ijkl}\f$.
     /// \param[in] clearTerms If true, computed \ref TwoParticleGFPart's of all elements will be destroyed
     ///                       immediately after filling the precomputed value cache.
@@ -95,6 +132,25 @@ public:
                                                                      MPI_Comm const& comm = MPI_COMM_WORLD,
                                                                      bool split = true);
 
+    /// Return the values of an element \f$\chi_{ijkl}\f$ calculated at a list of complex frequency triplets.
+    /// This is a collective operation: If the terms of the element are kept only by the group of processes
+    /// that computed them (see \ref DistributedTerms), the evaluation is done by the root of the group,
+    /// and the results are broadcast to all processes in \p comm.
+    /// \param[in] Indices Index combination \f$(i,j,k,l)\f$.
+    /// \param[in] freqs List of frequency triplets \f$(z_1, z_2, z_3)\f$.
+    /// \param[in] comm MPI communicator that has been passed to \ref computeAll().
+    /// \pre \ref computeAll() has been called with \p clearTerms = false.
+    std::vector<ComplexType>
+    evaluate(IndexCombination4 const& Indices, FreqVec const& freqs, MPI_Comm const& comm = MPI_COMM_WORLD) const;
+
+    /// Write the terms of all computed elements to a checkpoint file. Each \ref TwoParticleGF object is written
+    /// once together with the list of index combinations it represents, including those related by symmetries.
+    /// The elements can be read back one by one and evaluated by \ref TwoParticleGFTerms.
+    /// \param[in] ar The checkpoint file.
+    /// \pre \ref computeAll() has been called with \p clearTerms = false, and the terms of all elements
+    ///      are available on the calling process (\ref DistributedTerms = false).
+    void saveTerms(BinaryOutputArchive& ar) const;
+
 protected:
     friend class IndexContainer4<TwoParticleGF, TwoParticleGFContainer>;
 
@@ -113,15 +169,37 @@ protected:
     FieldOperatorContainer const& Operators;
 
 private:
+    // Ranks of the processes evaluating the elements whose terms have not been distributed
+    std::map<TwoParticleGF const*, int> TermOwners;
+
     // Implementation details.
     std::map<IndexCombination4, std::vector<ComplexType>>
     computeAll_nosplit(bool clearTerms, FreqVec const& freqs = {}, MPI_Comm const& comm = MPI_COMM_WORLD);
     std::map<IndexCombination4, std::vector<ComplexType>>
     computeAll_split(bool clearTerms, FreqVec const& freqs = {}, MPI_Comm const& comm = MPI_COMM_WORLD);
+    // Move values distributed among processes of one color to their owners within comm
+    static std::vector<ComplexType> redistributeOutput(std::vector<ComplexType> const& data,
+                                                       std::size_t NFreqs,
+                                                       int color,
+                                                       std::map<int, int> const& proc_colors,
+                                                       MPI_Comm const& comm);
 };
 
 ///@}
 
+namespace Detail {
+
+// Split NProcs processes into groups with sizes proportional to Weights (at least one process per group).
+// Throws std::runtime_error if NProcs is smaller than the number of groups.
+std::vector<int> proportional_counts(std::vector<double> Weights, int NProcs);
+
+// Assign groups of processes of given sizes to the processes in comm and return the group of each process.
+// A group that fits into the free part of a shared memory node is placed on one node.
+// This is a collective operation.
+std::vector<int> place_groups(std::vector<int> const& Counts, MPI_Comm const& comm);
+
+} // namespace Detail
+
 } // namespace Pomerol
 
 #endif // #ifndef POMEROL_INCLUDE_TWOPARTICLEGFCONTAINER_HPP
@@ -18,6 +18,7 @@
 
 #include "ComputableObject.hpp"
 #include "DensityMatrixPart.hpp"
+#include "FrozenTerms.hpp"
 #include "HamiltonianPart.hpp"
 #include "Misc.hpp"
 #include "MonomialOperatorPart.hpp"
@@ -30,6 +31,8 @@
 #include <array>
 #include <complex>
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 namespace Pomerol {
 
@@ -74,8 +77,9 @@ public:
         bool isz4;
 
         /// Weight \f$W\f$ used in addition of terms with different poles.
+        /// It shares the padding after the flag, which keeps the term size at a multiple of 8 bytes.
         /// \see \ref operator+=()
-        long Weight;
+        std::uint32_t Weight;
 
         /// Comparator object for non-resonant terms.
         struct Compare {
@@ -98,6 +102,12 @@ public:
                 } else
                     return t1.isz4 < t2.isz4;
             }
+            /// Exact lexicographic order of the poles (a strict weak ordering used to sort the terms).
+            /// \param[in] t1 First term.
+            /// \param[in] t2 Second term.
+            bool exact_less(NonResonantTerm const& t1, NonResonantTerm const& t2) const {
+                return t1.isz4 != t2.isz4 ? t1.isz4 < t2.isz4 : t1.Poles < t2.Poles;
+            }
             /// Broadcast this object from a root MPI rank to all other ranks in a communicator.
             /// \param[in] comm The MPI communicator for the broadcast operation.
             /// \param[in] root Rank of the root MPI process.
@@ -147,7 +157,7 @@ public:
         /// \li Coeff += AnotherTerm.Coeff
         /// \li Poles[i] = (Poles[i] * Weight + AnotherTerm.Poles[i] * AnotherTerm.Weight) /
         ///                (Weight + AnotherTerm.Weight)
-        /// \li Weight += AnotherTerm.Weight
+        /// \li Weight += AnotherTerm.Weight (saturated at the largest value of \p std::uint32_t)
         /// \param[in] AnotherTerm Term to add.
         NonResonantTerm& operator+=(NonResonantTerm const& AnotherTerm);
 
@@ -183,8 +193,9 @@ public:
         bool isz1z2;
 
         /// Weight \f$W\f$ used in addition of terms with different poles.
+        /// It shares the padding after the flag, which keeps the term size at a multiple of 8 bytes.
         /// \see \ref operator+=()
-        long Weight;
+        std::uint32_t Weight;
 
         /// Comparator object for resonant terms.
         struct Compare {
@@ -206,6 +217,12 @@ public:
                 } else
                     return t1.isz1z2 < t2.isz1z2;
             }
+            /// Exact lexicographic order of the poles (a strict weak ordering used to sort the terms).
+            /// \param[in] t1 First term.
+            /// \param[in] t2 Second term.
+            bool exact_less(ResonantTerm const& t1, ResonantTerm const& t2) const {
+                return t1.isz1z2 != t2.isz1z2 ? t1.isz1z2 < t2.isz1z2 : t1.Poles < t2.Poles;
+            }
             /// Broadcast this object from a root MPI rank to all other ranks in a communicator.
             /// \param[in] comm The MPI communicator for the broadcast operation.
             /// \param[in] root Rank of the root MPI process.
@@ -264,7 +281,7 @@ public:
         /// \li NonResCoeff += AnotherTerm.NonResCoeff
         /// \li Poles[i] = (Poles[i] * Weight + AnotherTerm.Poles[i] * AnotherTerm.Weight) /
         ///                (Weight + AnotherTerm.Weight)
-        /// \li Weight += AnotherTerm.Weight
+        /// \li Weight += AnotherTerm.Weight (saturated at the largest value of \p std::uint32_t)
         /// \param[in] AnotherTerm Term to add.
         ResonantTerm& operator+=(ResonantTerm const& AnotherTerm);
 
@@ -304,9 +321,27 @@ private:
     Permutation3 Permutation;
 
     /// List of all non-resonant terms contributing to this part.
-    TermList<NonResonantTerm> NonResonantTerms;
+    FlatTermList<NonResonantTerm> NonResonantTerms;
     /// List of all resonant terms contributing to this part.
-    TermList<ResonantTerm> ResonantTerms;
+    FlatTermList<ResonantTerm> ResonantTerms;
+
+    /// Non-resonant terms in the structure-of-arrays form (filled by \ref freeze()).
+    FrozenNonResonantTerms FrozenNonResonant;
+    /// Resonant terms in the structure-of-arrays form (filled by \ref freeze()).
+    FrozenResonantTerms FrozenResonant;
+    /// Are \ref FrozenNonResonant and \ref FrozenResonant up to date?
+    bool Frozen = false;
+    /// Have \ref NonResonantTerms and \ref ResonantTerms been released by \ref compact()?
+    bool Compact = false;
+
+    /// Wall-clock time in seconds spent in the last call to \ref compute().
+    double ComputeTime = 0;
+
+    /// Linear size of a tile of the \f$({\rm S_1}, {\rm S_3})\f$ index space processed by one thread in
+    /// \ref compute().
+    static constexpr InnerQuantumState ComputeTileSize = 32;
+    /// Cost of a multi-term relative to that of a visited matrix element in \ref estimateCost().
+    static constexpr double MultitermCost = 10;
 
     /// Adds a multi-term that has the following form:
     /// \f[
@@ -347,6 +382,8 @@ private:
     /// \param[in] Wj The second weight \f$w_j\f$.
     /// \param[in] Wk The third weight \f$w_k\f$.
     /// \param[in] Wl The fourth weight \f$w_l\f$.
+    /// \param[inout] NonResonantList List to add the non-resonant terms to.
+    /// \param[inout] ResonantList List to add the resonant terms to.
     void addMultiterm(ComplexType Coeff,
                       RealType beta,
                       RealType Ei,
@@ -356,7 +393,9 @@ private:
                       RealType Wi,
                       RealType Wj,
                       RealType Wk,
-                      RealType Wl);
+                      RealType Wl,
+                      FlatTermList<NonResonantTerm>& NonResonantList,
+                      FlatTermList<ResonantTerm>& ResonantList) const;
 
     /// A difference in energies with magnitude below this value is treated as zero.
     RealType ReduceResonanceTolerance = 1e-8;
@@ -365,9 +404,18 @@ private:
     /// Minimal magnitude of the coefficient of a term for it to be taken into account with respect to
     /// the amount of terms.
     RealType MultiTermCoefficientTolerance = 1e-5;
-
-    // compute() implementation details.
-    template <bool Complex> void computeImpl();
+    /// Round the poles to single precision in \ref freeze().
+    bool SinglePrecisionPoles = false;
+
+    // compute() and computeStreaming() implementation details.
+    template <bool Complex>
+    void computeImpl(FreqArrays const* z = nullptr,
+                     std::vector<ComplexType>* data = nullptr,
+                     std::size_t BatchSize = 0);
+    void evaluateBatch(FlatTermList<NonResonantTerm>& NonResonantList,
+                       FlatTermList<ResonantTerm>& ResonantList,
+                       FreqArrays const& z,
+                       std::vector<ComplexType>& data) const;
 
 public:
     /// Constructor.
@@ -401,9 +449,74 @@ public:
     /// Compute the terms contributing to this part.
     void compute();
 
+    /// Compute the terms contributing to this part and add its values at a list of frequencies to \p data
+    /// without ever storing all terms.
+    ///
+    /// Each thread accumulates and reduces terms in its own list as \ref compute() does. Once the list holds
+    /// \p BatchSize terms, they are evaluated at \p z, and the list is emptied. The memory used by the terms
+    /// is thereby bounded by \p BatchSize per thread. Similar terms from different batches are not merged,
+    /// so the results agree with those of \ref compute() followed by \ref evaluate() up to the tolerances
+    /// of the term reduction. The part is left without terms, i.e. in the same state as after \ref clear().
+    /// \param[in] z List of frequency triplets \f$(z_1, z_2, z_3)\f$ in the structure-of-arrays form.
+    ///              It must be constructed for the permutation returned by \ref getPermutation().
+    /// \param[inout] data Values of this part at \p z are added to elements of this vector.
+    ///                    Its size must be equal to that of \p z.
+    /// \param[in] BatchSize Maximal number of terms accumulated by a thread before they are evaluated.
+    void computeStreaming(FreqArrays const& z, std::vector<ComplexType>& data, std::size_t BatchSize);
+
+    /// Estimate the cost of \ref compute() in arbitrary units.
+    ///
+    /// The estimate is the number of matrix elements of \f$\hat O_1, \hat O_2, \hat O_3\f$ and
+    /// \f$c^\dagger_l\f$ visited for all pairs of \f$({\rm S_1}, {\rm S_3})\f$ states,
+    /// plus the expected number of nonzero products
+    /// \f$\langle 1|\hat O_1|2\rangle\langle 2|\hat O_2|3\rangle\langle 3|\hat O_3|4\rangle\langle 4|c^\dagger_l|1\rangle\f$,
+    /// each of which gives rise to a multi-term. The latter number is obtained from the numbers
+    /// of nonzero elements of the four matrices assuming they are uniformly distributed.
+    /// \pre The operator parts have been computed.
+    double estimateCost() const;
+
+    /// Return the wall-clock time in seconds spent in the last call to \ref compute()
+    /// made by this process, or 0 if \ref compute() has not been called.
+    double getComputeTime() const { return ComputeTime; }
+
     /// Purge all terms.
     void clear();
 
+    /// Store a copy of the computed terms in the structure-of-arrays form,
+    /// which speeds up subsequent calls to \ref evaluate().
+    /// \ref TwoParticleGF freezes the parts it keeps once their terms are final.
+    void freeze();
+    /// Have the terms been stored in the structure-of-arrays form by \ref freeze()?
+    bool isFrozen() const { return Frozen; }
+
+    /// Freeze the terms and release the term lists, so that only the structure-of-arrays form is kept.
+    /// The part stays computed and can be evaluated, but its terms can no longer be accessed
+    /// via \ref getNonResonantTerms() and \ref getResonantTerms(), or shared among MPI processes.
+    void compact();
+    /// Have the term lists been released by \ref compact()?
+    bool isCompact() const { return Compact; }
+
+    /// Return the maximal absolute error of the poles introduced by rounding to single precision,
+    /// or 0 if the poles are not rounded (cf. \ref FrozenNonResonantTerms::getPoleError()).
+    RealType getPoleError() const;
+
+    /// Substitute a list of frequency triplets into this part and add the results to \p data.
+    ///
+    /// The terms are evaluated by branch-free loops over blocks of frequencies, which are amenable
+    /// to SIMD vectorization. If \ref freeze() has not been called, the structure-of-arrays form
+    /// of the terms is built on the fly.
+    /// \param[in] freqs List of frequency triplets \f$(z_1, z_2, z_3)\f$.
+    /// \param[inout] data Values of this part at \p freqs are added to elements of this vector.
+    ///                    Its size must be equal to that of \p freqs.
+    void evaluate(FreqVec const& freqs, std::vector<ComplexType>& data) const;
+
+    /// Substitute a list of frequency triplets into this part and add the results to \p data.
+    /// \param[in] z List of frequency triplets \f$(z_1, z_2, z_3)\f$ in the structure-of-arrays form.
+    ///              It must be constructed for the permutation returned by \ref getPermutation().
+    /// \param[inout] data Values of this part at \p z are added to elements of this vector.
+    ///                    Its size must be equal to that of \p z.
+    void evaluate(FreqArrays const& z, std::vector<ComplexType>& data) const;
+
     /// Substitute complex frequencies \f$z_1, z_2, z_3\f$ into this part.
     /// \param[in] z1 First frequency \f$z_1\f$.
     /// \param[in] z2 Second frequency \f$z_2\f$.
@@ -419,17 +532,29 @@ public:
     ComplexType operator()(long MatsubaraNumber1, long MatsubaraNumber2, long MatsubaraNumber3) const;
 
     /// Return the number of resonant terms.
-    std::size_t getNumResonantTerms() const { return ResonantTerms.size(); }
+    std::size_t getNumResonantTerms() const { return Compact ? FrozenResonant.size() : ResonantTerms.size(); }
     /// Return the number of non-resonant terms.
-    std::size_t getNumNonResonantTerms() const { return NonResonantTerms.size(); }
+    std::size_t getNumNonResonantTerms() const {
+        return Compact ? FrozenNonResonant.size() : NonResonantTerms.size();
+    }
 
     /// Return the permutation of operators \f$\{c_i, c_j, c^\dagger_k\}\f$ for this part.
     Permutation3 const& getPermutation() const { return Permutation; }
 
     /// Access the list of the resonant terms.
-    TermList<TwoParticleGFPart::ResonantTerm> const& getResonantTerms() const { return ResonantTerms; }
+    /// Throws \ref ComputableObject::StatusMismatch if the list has been released by \ref compact().
+    FlatTermList<TwoParticleGFPart::ResonantTerm> const& getResonantTerms() const {
+        if(Compact)
+            throw StatusMismatch("2PGFPart: Resonant terms have been released by compact().");
+        return ResonantTerms;
+    }
     /// Access the list of the non-resonant terms.
-    TermList<TwoParticleGFPart::NonResonantTerm> const& getNonResonantTerms() const { return NonResonantTerms; }
+    /// Throws \ref ComputableObject::StatusMismatch if the list has been released by \ref compact().
+    FlatTermList<TwoParticleGFPart::NonResonantTerm> const& getNonResonantTerms() const {
+        if(Compact)
+            throw StatusMismatch("2PGFPart: Non-resonant terms have been released by compact().");
+        return NonResonantTerms;
+    }
 };
 
 ///@}
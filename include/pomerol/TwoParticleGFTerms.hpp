@@ -0,0 +1,91 @@
+//
+// This file is part of pomerol, an exact diagonalization library aimed at
+// solving condensed matter models of interacting fermions.
+//
+// Copyright (C) 2016-2021 A. Antipov, I. Krivenko and contributors
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// \file include/pomerol/TwoParticleGFTerms.hpp
+/// \brief Terms of a fermionic two-particle Green's function read from a checkpoint file.
+/// \author Igor Krivenko (igor.s.krivenko@gmail.com)
+
+#ifndef POMEROL_INCLUDE_TWOPARTICLEGFTERMS_HPP
+#define POMEROL_INCLUDE_TWOPARTICLEGFTERMS_HPP
+
+#include "BinaryArchive.hpp"
+#include "FrozenTerms.hpp"
+#include "Index.hpp"
+#include "Misc.hpp"
+#include "Thermal.hpp"
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+namespace Pomerol {
+
+/// \addtogroup 2PGF
+///@{
+
+/// \brief Terms of a fermionic two-particle Matsubara Green's function read from a checkpoint file.
+///
+/// This class holds the terms of all parts of a \ref TwoParticleGF written by \ref TwoParticleGF::saveTerms()
+/// or \ref TwoParticleGFContainer::saveTerms(), and evaluates the Green's function at arbitrary frequencies.
+/// It does not depend on the Hamiltonian, the operators or the density matrix, so that the evaluation
+/// can be done by a separate job. Elements stored by \ref TwoParticleGFContainer::saveTerms() are read
+/// one at a time, which keeps the memory footprint bounded by the size of the largest element.
+class TwoParticleGFTerms : public Thermal {
+
+    /// Terms of one \ref TwoParticleGFPart.
+    struct Part {
+        /// Serial number of the permutation of operators within \ref permutations3.
+        std::size_t PermutationNumber;
+        /// Tolerance for the resonance detection.
+        RealType DeltaTolerance;
+        /// The non-resonant terms.
+        FrozenNonResonantTerms NonResonant;
+        /// The resonant terms.
+        FrozenResonantTerms Resonant;
+    };
+
+    /// Index combinations \f$(i,j,k,l)\f$ represented by the stored terms, and serial numbers of
+    /// the respective frequency permutations within \ref permutations4.
+    std::map<IndexCombination4, std::size_t> Aliases;
+    /// List of the parts.
+    std::vector<Part> parts;
+
+    // Read the beginning of a section with the stored terms and return the inverse temperature
+    static RealType readHeader(BinaryInputArchive& ar);
+
+public:
+    /// Read terms of one Green's function.
+    /// \param[in] ar The checkpoint file.
+    explicit TwoParticleGFTerms(BinaryInputArchive& ar);
+
+    /// Read the number of elements written by \ref TwoParticleGFContainer::saveTerms(). It must be called
+    /// once before the elements are read with \ref TwoParticleGFTerms().
+    /// \param[in] ar The checkpoint file.
+    static std::size_t readNumberOfElements(BinaryInputArchive& ar);
+
+    /// Return the list of index combinations \f$(i,j,k,l)\f$, for which \ref evaluate() can be called.
+    std::vector<IndexCombination4> getIndices() const;
+
+    /// Return the number of stored parts.
+    std::size_t getNumParts() const { return parts.size(); }
+    /// Return the total number of stored terms.
+    std::size_t getNumTerms() const;
+
+    /// Return the values of an element \f$\chi_{ijkl}\f$ calculated at a list of complex frequency triplets.
+    /// \param[in] Indices Index combination \f$(i,j,k,l)\f$ returned by \ref getIndices().
+    /// \param[in] freqs List of frequency triplets \f$(z_1, z_2, z_3)\f$.
+    std::vector<ComplexType> evaluate(IndexCombination4 const& Indices, FreqVec const& freqs) const;
+};
+
+///@}
+
+} // namespace Pomerol
+
+#endif // #ifndef POMEROL_INCLUDE_TWOPARTICLEGFTERMS_HPP
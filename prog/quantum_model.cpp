@@ -22,6 +22,7 @@
 #include <complex>
 #include <stdexcept>
 #include <tuple>
+#include <vector>
 
 using namespace Pomerol;
 
@@ -102,8 +103,7 @@ void quantum_model::compute() {
     S.compute(HS);
 
     Hamiltonian H(S);
-    H.prepare(HExpr, HS, MPI_COMM_WORLD);
-    H.compute(MPI_COMM_WORLD);
+    H.prepareAndCompute(HExpr, HS, MPI_COMM_WORLD);
 
     if(!rank) {
         gftools::grid_object<double, gftools::enum_grid> evals1(
@@ -166,17 +166,22 @@ void quantum_model::compute() {
                 grid_object<std::complex<double>, fmatsubara_grid> gf_imfreq(
                     fmatsubara_grid(wf_min, wf_max * 4, beta, true));
                 std::string ind_str = std::to_string(ind2.Index1) + std::to_string(ind2.Index2);
-                for(auto p : gf_imfreq.grid().points()) {
-                    gf_imfreq[p] = GF(p.value());
-                }
+                std::vector<ComplexType> z_imfreq;
+                for(auto p : gf_imfreq.grid().points())
+                    z_imfreq.push_back(p.value());
+                std::vector<ComplexType> gf_imfreq_values = GF.evaluate(z_imfreq);
+                for(auto p : gf_imfreq.grid().points())
+                    gf_imfreq[p] = gf_imfreq_values[p.index()];
                 gf_imfreq.savetxt("gw_imfreq_" + ind_str + ".dat");
 
                 real_grid freq_grid(-hbw, hbw, 2 * static_cast<std::size_t>(hbw / step) + 1, true);
                 grid_object<std::complex<double>, real_grid> gf_refreq(freq_grid);
-                for(auto p : freq_grid.points()) {
-                    ComplexType val = GF(ComplexType(p.value()) + I * eta);
-                    gf_refreq[p] = val;
-                };
+                std::vector<ComplexType> z_refreq;
+                for(auto p : freq_grid.points())
+                    z_refreq.push_back(ComplexType(p.value()) + I * eta);
+                std::vector<ComplexType> gf_refreq_values = GF.evaluate(z_refreq);
+                for(auto p : freq_grid.points())
+                    gf_refreq[p] = gf_refreq_values[p.index()];
                 gf_refreq.savetxt("gw_refreq_" + ind_str + ".dat");
             }
 
@@ -9,7 +9,8 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 /// \file src/mpi_dispatcher/mpi_dispatcher.cpp
-/// \brief A master-worker parallelization scheme using non-blocking MPI communications (implementation).
+/// \brief A master-worker parallelization scheme using non-blocking MPI communications
+///        and a decentralized dispatcher based on one-sided MPI communications (implementation).
 /// \author Andrey Antipov (andrey.e.antipov@gmail.com)
 /// \author Igor Krivenko (igor.s.krivenko@gmail.com)
 
@@ -158,4 +159,70 @@ void MPIMaster::check_workers() {
     }
 }
 
+//
+// Decentralized dispatcher
+//
+
+MPIJobCounter::MPIJobCounter(MPI_Comm const& comm, std::vector<JobId> task_numbers, int root)
+    : root(root), task_numbers(std::move(task_numbers)) {
+    MPI_Comm_dup(comm, &Comm);
+    bool is_root = rank(Comm) == root;
+    MPI_Win_allocate(is_root ? sizeof(long) : 0, sizeof(long), MPI_INFO_NULL, Comm, &Counter, &Win);
+    if(is_root) {
+        MPI_Win_lock(MPI_LOCK_EXCLUSIVE, root, 0, Win);
+        *Counter = 0;
+        MPI_Win_unlock(root, Win);
+    }
+    MPI_Barrier(Comm);
+    MPI_Win_lock_all(0, Win);
+    Locked = true;
+}
+
+MPIJobCounter::~MPIJobCounter() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if(finalized)
+        return;
+    if(Locked)
+        MPI_Win_unlock_all(Win);
+    MPI_Win_free(&Win);
+    MPI_Comm_free(&Comm);
+}
+
+bool MPIJobCounter::claim(JobId& job) {
+    if(Exhausted)
+        return false;
+
+    long const one = 1;
+    long pos = 0;
+    MPI_Fetch_and_op(&one, &pos, MPI_LONG, root, 0, MPI_SUM, Win);
+    MPI_Win_flush(root, Win);
+
+    if(pos >= static_cast<long>(task_numbers.size())) {
+        Exhausted = true;
+        return false;
+    }
+    Claimed.push_back(pos);
+    job = task_numbers[pos];
+    return true;
+}
+
+std::map<JobId, WorkerId> const& MPIJobCounter::gather_dispatch_map() {
+    if(Locked) {
+        MPI_Win_unlock_all(Win);
+        Locked = false;
+    }
+
+    std::vector<WorkerId> workers(task_numbers.size(), -1);
+    WorkerId id = rank(Comm);
+    for(long pos : Claimed)
+        workers[pos] = id;
+    MPI_Allreduce(MPI_IN_PLACE, workers.data(), static_cast<int>(workers.size()), MPI_INT, MPI_MAX, Comm);
+
+    DispatchMap.clear();
+    for(std::size_t pos = 0; pos < task_numbers.size(); ++pos)
+        DispatchMap[task_numbers[pos]] = workers[pos];
+    return DispatchMap;
+}
+
 } // namespace pMPI
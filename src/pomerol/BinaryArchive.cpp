@@ -0,0 +1,177 @@
+//
+// This file is part of pomerol, an exact diagonalization library aimed at
+// solving condensed matter models of interacting fermions.
+//
+// Copyright (C) 2016-2021 A. Antipov, I. Krivenko and contributors
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// \file src/pomerol/BinaryArchive.cpp
+/// \brief Binary checkpoint files (implementation).
+/// \author Igor Krivenko (igor.s.krivenko@gmail.com)
+
+#include "pomerol/BinaryArchive.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace Pomerol {
+
+namespace {
+
+// File signature
+constexpr std::array<char, 8> Magic = {'P', 'O', 'M', 'E', 'R', 'O', 'L', 'B'};
+// Written in the native byte order, used to detect files from machines with another one
+constexpr std::uint32_t ByteOrderMark = 0x01020304;
+
+// Section names are stored as fixed-size, zero-padded character arrays
+std::array<char, 8> make_tag(std::string const& Tag) {
+    if(Tag.size() > 8)
+        throw std::runtime_error("BinaryArchive: Section name '" + Tag + "' is too long");
+    std::array<char, 8> Chars = {};
+    std::copy(Tag.begin(), Tag.end(), Chars.begin());
+    return Chars;
+}
+
+std::size_t padding(std::streamoff Offset) {
+    return (BinaryOutputArchive::Alignment - std::size_t(Offset) % BinaryOutputArchive::Alignment) %
+           BinaryOutputArchive::Alignment;
+}
+
+} // namespace
+
+//
+// BinaryOutputArchive
+//
+
+constexpr std::uint32_t BinaryOutputArchive::FormatVersion;
+constexpr std::size_t BinaryOutputArchive::Alignment;
+
+BinaryOutputArchive::BinaryOutputArchive(std::string const& FileName)
+    : Stream(FileName, std::ios::binary | std::ios::trunc) {
+    if(!Stream)
+        throw std::runtime_error("BinaryOutputArchive: Cannot open file " + FileName);
+    writeRaw(Magic.data(), Magic.size());
+    write(FormatVersion);
+    write(ByteOrderMark);
+    write(std::uint32_t(sizeof(QuantumState)));
+}
+
+void BinaryOutputArchive::beginSection(std::string const& Tag) {
+    auto Chars = make_tag(Tag);
+    align();
+    writeRaw(Chars.data(), Chars.size());
+}
+
+template <bool C> void BinaryOutputArchive::writeDenseMatrix(MatrixType<C> const& M) {
+    write(std::uint64_t(M.rows()));
+    write(std::uint64_t(M.cols()));
+    writeArray(M.data(), M.size());
+}
+template void BinaryOutputArchive::writeDenseMatrix<true>(MatrixType<true> const&);
+template void BinaryOutputArchive::writeDenseMatrix<false>(MatrixType<false> const&);
+
+template <bool C> void BinaryOutputArchive::writeSparseMatrix(RowMajorMatrixType<C> const& M) {
+    if(!M.isCompressed()) {
+        RowMajorMatrixType<C> Compressed = M;
+        Compressed.makeCompressed();
+        writeSparseMatrix<C>(Compressed);
+        return;
+    }
+    write(std::uint64_t(M.rows()));
+    write(std::uint64_t(M.cols()));
+    writeArray(M.outerIndexPtr(), M.outerSize() + 1);
+    writeArray(M.innerIndexPtr(), M.nonZeros());
+    writeArray(M.valuePtr(), M.nonZeros());
+}
+template void BinaryOutputArchive::writeSparseMatrix<true>(RowMajorMatrixType<true> const&);
+template void BinaryOutputArchive::writeSparseMatrix<false>(RowMajorMatrixType<false> const&);
+
+void BinaryOutputArchive::writeRaw(void const* Data, std::size_t Size) {
+    Stream.write(static_cast<char const*>(Data), std::streamsize(Size));
+    if(!Stream)
+        throw std::runtime_error("BinaryOutputArchive: Write error");
+}
+
+void BinaryOutputArchive::align() {
+    static std::array<char, Alignment> const Zeros = {};
+    writeRaw(Zeros.data(), padding(Stream.tellp()));
+}
+
+//
+// BinaryInputArchive
+//
+
+BinaryInputArchive::BinaryInputArchive(std::string const& FileName) : Stream(FileName, std::ios::binary) {
+    if(!Stream)
+        throw std::runtime_error("BinaryInputArchive: Cannot open file " + FileName);
+    std::array<char, 8> Signature = {};
+    readRaw(Signature.data(), Signature.size());
+    if(Signature != Magic)
+        throw std::runtime_error("BinaryInputArchive: " + FileName + " is not a pomerol checkpoint file");
+    auto Version = read<std::uint32_t>();
+    if(Version != BinaryOutputArchive::FormatVersion)
+        throw std::runtime_error("BinaryInputArchive: Unsupported format version " + std::to_string(Version));
+    if(read<std::uint32_t>() != ByteOrderMark)
+        throw std::runtime_error("BinaryInputArchive: " + FileName + " was written with another byte order");
+    if(read<std::uint32_t>() != sizeof(QuantumState))
+        throw std::runtime_error("BinaryInputArchive: " + FileName + " was written with another state index type");
+}
+
+void BinaryInputArchive::beginSection(std::string const& Tag) {
+    auto Expected = make_tag(Tag);
+    std::array<char, 8> Chars = {};
+    align();
+    readRaw(Chars.data(), Chars.size());
+    if(Chars != Expected)
+        throw std::runtime_error("BinaryInputArchive: Expected section '" + Tag + "', found '" +
+                                 std::string(Chars.begin(), std::find(Chars.begin(), Chars.end(), '\0')) + "'");
+}
+
+std::size_t BinaryInputArchive::readArraySize() {
+    return read<std::uint64_t>();
+}
+
+template <bool C> MatrixType<C> BinaryInputArchive::readDenseMatrix() {
+    auto Rows = read<std::uint64_t>();
+    auto Cols = read<std::uint64_t>();
+    MatrixType<C> M(Rows, Cols);
+    if(readArraySize() != std::size_t(M.size()))
+        throw std::runtime_error("BinaryInputArchive: Inconsistent size of a dense matrix");
+    readArrayData(M.data(), M.size());
+    return M;
+}
+template MatrixType<true> BinaryInputArchive::readDenseMatrix<true>();
+template MatrixType<false> BinaryInputArchive::readDenseMatrix<false>();
+
+template <bool C> RowMajorMatrixType<C> BinaryInputArchive::readSparseMatrix() {
+    auto Rows = read<std::uint64_t>();
+    auto Cols = read<std::uint64_t>();
+    RowMajorMatrixType<C> M(Rows, Cols);
+    if(readArraySize() != std::size_t(M.outerSize() + 1))
+        throw std::runtime_error("BinaryInputArchive: Inconsistent size of a sparse matrix");
+    readArrayData(M.outerIndexPtr(), M.outerSize() + 1);
+    std::size_t NonZeros = readArraySize();
+    M.resizeNonZeros(Eigen::Index(NonZeros));
+    readArrayData(M.innerIndexPtr(), NonZeros);
+    if(readArraySize() != NonZeros)
+        throw std::runtime_error("BinaryInputArchive: Inconsistent size of a sparse matrix");
+    readArrayData(M.valuePtr(), NonZeros);
+    return M;
+}
+template RowMajorMatrixType<true> BinaryInputArchive::readSparseMatrix<true>();
+template RowMajorMatrixType<false> BinaryInputArchive::readSparseMatrix<false>();
+
+void BinaryInputArchive::readRaw(void* Data, std::size_t Size) {
+    Stream.read(static_cast<char*>(Data), std::streamsize(Size));
+    if(!Stream)
+        throw std::runtime_error("BinaryInputArchive: Unexpected end of file");
+}
+
+void BinaryInputArchive::align() {
+    Stream.seekg(std::streamoff(padding(Stream.tellg())), std::ios::cur);
+}
+
+} // namespace Pomerol
@@ -15,6 +15,7 @@
 
 #include "pomerol/DensityMatrix.hpp"
 
+#include <cstddef>
 #include <numeric>
 
 namespace Pomerol {
@@ -95,4 +96,30 @@ bool DensityMatrix::isRetained(BlockNumber in) const {
     return parts[in].isRetained();
 }
 
+std::vector<DensityMatrix>
+ComputeDensityMatrices(StatesClassification const& S, Hamiltonian const& H, std::vector<RealType> const& betas) {
+    std::vector<DensityMatrix> DMs;
+    DMs.reserve(betas.size());
+    for(RealType beta : betas) {
+        DMs.emplace_back(S, H, beta);
+        DMs.back().prepare();
+    }
+
+    RealType GroundEnergy = H.getGroundEnergy();
+    std::vector<RealType> Z(betas.size(), 0);
+    for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+        RealVectorType ExcitationEnergies = H.getPart(Block).getEigenValues().array() - GroundEnergy;
+        for(std::size_t n = 0; n < DMs.size(); ++n)
+            Z[n] += DMs[n].parts[Block].computeUnnormalized(ExcitationEnergies);
+    }
+
+    for(std::size_t n = 0; n < DMs.size(); ++n) {
+        for(auto& p : DMs[n].parts)
+            p.normalize(Z[n]);
+        DMs[n].setStatus(DensityMatrix::Computed);
+    }
+
+    return DMs;
+}
+
 } // namespace Pomerol
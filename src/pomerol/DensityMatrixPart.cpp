@@ -25,6 +25,11 @@ RealType DensityMatrixPart::computeUnnormalized() {
     return weights.sum();
 }
 
+RealType DensityMatrixPart::computeUnnormalized(RealVectorType const& ExcitationEnergies) {
+    weights = exp(-beta * ExcitationEnergies.array());
+    return weights.sum();
+}
+
 void DensityMatrixPart::normalize(RealType Z) {
     weights /= Z;
     Z_part /= Z;
@@ -15,27 +15,80 @@
 
 #include "pomerol/FieldOperatorContainer.hpp"
 
+#include <cstdint>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace Pomerol {
 
-void FieldOperatorContainer::computeAll() {
+void FieldOperatorContainer::computeAll(MPI_Comm const& comm) {
+    // Parts of all creation operators are computed at once
+    std::vector<MonomialOperatorPart*> Parts;
     for(auto& cdag_p : mapCreationOperators) {
         auto& cdag = cdag_p.second;
-        cdag.compute();
+        if(cdag.getStatus() >= ComputableObject::Computed)
+            continue;
+        for(auto& part : cdag.parts)
+            Parts.push_back(&part);
+    }
+    MonomialOperator::computeParts(Parts, comm);
+
+    for(auto& cdag_p : mapCreationOperators) {
+        auto& cdag = cdag_p.second;
+        cdag.setStatus(ComputableObject::Computed);
+        setFromAdjoint(mapAnnihilationOperators.find(cdag_p.first)->second, cdag);
+    }
+}
 
-        auto& c = mapAnnihilationOperators.find(cdag_p.first)->second;
+void FieldOperatorContainer::setFromAdjoint(AnnihilationOperator& c, CreationOperator const& cdag) {
+    auto const& cdag_block_map = cdag.getBlockMapping();
+    for(auto cdag_map_it = cdag_block_map.right.begin(); cdag_map_it != cdag_block_map.right.end(); ++cdag_map_it) {
+        auto& cPart = c.getPartFromRightIndex(cdag_map_it->second);
+        auto const& cdagPart = cdag.getPartFromRightIndex(cdag_map_it->first);
+        cPart.setFromAdjoint(cdagPart);
+    }
+    c.setStatus(ComputableObject::Computed);
+}
 
-        auto const& cdag_block_map = cdag_p.second.getBlockMapping();
-        for(auto cdag_map_it = cdag_block_map.right.begin(); cdag_map_it != cdag_block_map.right.end(); ++cdag_map_it) {
-            auto& cPart = c.getPartFromRightIndex(cdag_map_it->second);
-            auto& cdagPart = cdag.getPartFromRightIndex(cdag_map_it->first);
-            cPart.setFromAdjoint(cdagPart);
-        }
-        c.setStatus(ComputableObject::Computed);
+void FieldOperatorContainer::saveAll(BinaryOutputArchive& ar) const {
+    ar.beginSection("FIELDOPS");
+    ar.write(std::uint64_t(mapCreationOperators.size()));
+    // Deterministic order of the operators in the file
+    for(auto p : getIndices()) {
+        ar.write(std::uint64_t(p));
+        mapCreationOperators.find(p)->second.save(ar);
     }
 }
 
+void FieldOperatorContainer::loadAll(BinaryInputArchive& ar) {
+    ar.beginSection("FIELDOPS");
+    auto N = ar.read<std::uint64_t>();
+    for(std::uint64_t n = 0; n < N; ++n) {
+        auto p = static_cast<ParticleIndex>(ar.read<std::uint64_t>());
+        auto cdag_it = mapCreationOperators.find(p);
+        if(cdag_it == mapCreationOperators.end())
+            throw std::runtime_error("Creation operator " + std::to_string(p) + " from the checkpoint file not found.");
+        auto& cdag = cdag_it->second;
+        cdag.load(ar);
+        setFromAdjoint(mapAnnihilationOperators.find(p)->second, cdag);
+    }
+}
+
+void FieldOperatorContainer::releaseConversions() {
+    for(auto& cdag_p : mapCreationOperators)
+        cdag_p.second.releaseConversions();
+    for(auto& c_p : mapAnnihilationOperators)
+        c_p.second.releaseConversions();
+}
+
+std::set<ParticleIndex> FieldOperatorContainer::getIndices() const {
+    std::set<ParticleIndex> Indices;
+    for(auto const& CX : mapCreationOperators)
+        Indices.insert(CX.first);
+    return Indices;
+}
+
 CreationOperator const& FieldOperatorContainer::getCreationOperator(ParticleIndex in) const {
     auto it = mapCreationOperators.find(in);
     if(it == mapCreationOperators.end())
@@ -0,0 +1,504 @@
+//
+// This file is part of pomerol, an exact diagonalization library aimed at
+// solving condensed matter models of interacting fermions.
+//
+// Copyright (C) 2016-2021 A. Antipov, I. Krivenko and contributors
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// \file src/pomerol/FrozenTerms.cpp
+/// \brief Structure-of-arrays storage of terms of a two-particle Green's function part (implementation).
+/// \author Igor Krivenko (igor.s.krivenko@gmail.com)
+
+#include "pomerol/FrozenTerms.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace Pomerol {
+
+//
+// FreqArrays
+//
+
+FreqArrays::FreqArrays(FreqVec const& freqs, Permutation3 const& Permutation) {
+    std::size_t size = freqs.size();
+    for(std::size_t n = 0; n < 6; ++n) {
+        Re[n].resize(size);
+        Im[n].resize(size);
+    }
+
+    for(std::size_t w = 0; w < size; ++w) {
+        std::array<ComplexType, 3> Frequencies = {
+            std::get<0>(freqs[w]), std::get<1>(freqs[w]), -std::get<2>(freqs[w])};
+        ComplexType z1 = Frequencies[Permutation.perm[0]];
+        ComplexType z2 = Frequencies[Permutation.perm[1]];
+        ComplexType z3 = Frequencies[Permutation.perm[2]];
+
+        std::array<ComplexType, 6> z = {z1, z2, z3, z1 + z2, z2 + z3, z1 + z2 + z3};
+        for(std::size_t n = 0; n < 6; ++n) {
+            Re[n][w] = z[n].real();
+            Im[n][w] = z[n].imag();
+        }
+    }
+}
+
+namespace {
+
+// Number of frequencies processed at once by EvaluateFrozenTerms()
+constexpr std::size_t FreqBlockSize = 64;
+
+// Write array number Field of a group of frozen terms
+template <typename GroupType>
+void save_group_array(BinaryOutputArchive& ar, GroupType const& G, std::size_t Field, bool Single) {
+    auto FloatArray = GroupType::FloatArrays[Field];
+    if(Single && FloatArray)
+        ar.writeArray((G.*FloatArray).data(), (G.*FloatArray).size());
+    else
+        ar.writeArray((G.*GroupType::RealArrays[Field]).data(), (G.*GroupType::RealArrays[Field]).size());
+}
+
+// Read all arrays of a group written by save_group_array() and check their sizes
+template <typename GroupType> void load_group(BinaryInputArchive& ar, GroupType& G, bool Single) {
+    G.clear();
+    std::size_t Size = 0;
+    for(std::size_t Field = 0; Field < GroupType::NFields; ++Field) {
+        auto FloatArray = GroupType::FloatArrays[Field];
+        std::size_t FieldSize;
+        if(Single && FloatArray) {
+            G.*FloatArray = ar.readVector<float>();
+            FieldSize = (G.*FloatArray).size();
+        } else {
+            G.*GroupType::RealArrays[Field] = ar.readVector<RealType>();
+            FieldSize = (G.*GroupType::RealArrays[Field]).size();
+        }
+        if(Field == 0)
+            Size = FieldSize;
+        else if(FieldSize != Size)
+            throw std::runtime_error("BinaryInputArchive: Inconsistent sizes of term arrays");
+    }
+}
+
+// Round a pole to single precision and update the maximal rounding error
+void push_back_rounded(std::vector<float>& Poles, RealType P, RealType& PoleError) {
+    float Rounded = static_cast<float>(P);
+    PoleError = std::max(PoleError, std::abs(P - static_cast<RealType>(Rounded)));
+    Poles.push_back(Rounded);
+}
+
+// Add C / ((z1 - P1)(zm - Pm)(z3 - P3)) for all terms of a group to the results.
+// Complex arithmetic is spelled out in real and imaginary parts so that the innermost
+// loop over frequencies is free of branches and library calls.
+template <typename PoleType>
+void accumulate_nonresonant(std::size_t NTerms,
+                            RealType const* CoeffRe,
+                            RealType const* CoeffIm,
+                            PoleType const* P1,
+                            PoleType const* Pm,
+                            PoleType const* P3,
+                            std::size_t NFreqs,
+                            RealType const* z1Re,
+                            RealType const* z1Im,
+                            RealType const* zmRe,
+                            RealType const* zmIm,
+                            RealType const* z3Re,
+                            RealType const* z3Im,
+                            RealType* ResRe,
+                            RealType* ResIm) {
+    for(std::size_t t = 0; t < NTerms; ++t) {
+        RealType const CRe = CoeffRe[t], CIm = CoeffIm[t];
+        RealType const p1 = P1[t], pm = Pm[t], p3 = P3[t];
+#ifdef POMEROL_USE_OPENMP
+#pragma omp simd
+#endif
+        for(std::size_t w = 0; w < NFreqs; ++w) {
+            RealType const aRe = z1Re[w] - p1, aIm = z1Im[w];
+            RealType const bRe = zmRe[w] - pm, bIm = zmIm[w];
+            RealType const cRe = z3Re[w] - p3, cIm = z3Im[w];
+            // d = a * b * c
+            RealType const abRe = aRe * bRe - aIm * bIm;
+            RealType const abIm = aRe * bIm + aIm * bRe;
+            RealType const dRe = abRe * cRe - abIm * cIm;
+            RealType const dIm = abRe * cIm + abIm * cRe;
+            // C / d = C * conj(d) / |d|^2
+            RealType const invNorm = 1.0 / (dRe * dRe + dIm * dIm);
+            ResRe[w] += (CRe * dRe + CIm * dIm) * invNorm;
+            ResIm[w] += (CIm * dRe - CRe * dIm) * invNorm;
+        }
+    }
+}
+
+// Add (|zr - Pr| < DeltaTolerance ? R : N / (zr - Pr)) / ((z1 - P1)(z3 - P3))
+// for all terms of a group to the results.
+template <typename PoleType>
+void accumulate_resonant(std::size_t NTerms,
+                         RealType const* ResCoeffRe,
+                         RealType const* ResCoeffIm,
+                         RealType const* NonResCoeffRe,
+                         RealType const* NonResCoeffIm,
+                         PoleType const* P1,
+                         PoleType const* P3,
+                         PoleType const* Pr,
+                         RealType DeltaTolerance,
+                         std::size_t NFreqs,
+                         RealType const* z1Re,
+                         RealType const* z1Im,
+                         RealType const* z3Re,
+                         RealType const* z3Im,
+                         RealType const* zrRe,
+                         RealType const* zrIm,
+                         RealType* ResRe,
+                         RealType* ResIm) {
+    RealType const DeltaTolerance2 = DeltaTolerance * DeltaTolerance;
+    for(std::size_t t = 0; t < NTerms; ++t) {
+        RealType const RRe = ResCoeffRe[t], RIm = ResCoeffIm[t];
+        RealType const NRe = NonResCoeffRe[t], NIm = NonResCoeffIm[t];
+        RealType const p1 = P1[t], p3 = P3[t], pr = Pr[t];
+#ifdef POMEROL_USE_OPENMP
+#pragma omp simd
+#endif
+        for(std::size_t w = 0; w < NFreqs; ++w) {
+            // Numerator
+            RealType const diffRe = zrRe[w] - pr, diffIm = zrIm[w];
+            RealType const diffNorm = diffRe * diffRe + diffIm * diffIm;
+            bool const resonant = diffNorm < DeltaTolerance2;
+            // Keep the discarded branch finite
+            RealType const invDiffNorm = 1.0 / (resonant ? 1.0 : diffNorm);
+            RealType const numRe = resonant ? RRe : (NRe * diffRe + NIm * diffIm) * invDiffNorm;
+            RealType const numIm = resonant ? RIm : (NIm * diffRe - NRe * diffIm) * invDiffNorm;
+            // Denominator d = (z1 - P1)(z3 - P3)
+            RealType const aRe = z1Re[w] - p1, aIm = z1Im[w];
+            RealType const cRe = z3Re[w] - p3, cIm = z3Im[w];
+            RealType const dRe = aRe * cRe - aIm * cIm;
+            RealType const dIm = aRe * cIm + aIm * cRe;
+            RealType const invNorm = 1.0 / (dRe * dRe + dIm * dIm);
+            ResRe[w] += (numRe * dRe + numIm * dIm) * invNorm;
+            ResIm[w] += (numIm * dRe - numRe * dIm) * invNorm;
+        }
+    }
+}
+
+// Evaluate the terms at the frequencies of block b and add the results to data
+void evaluate_block(FrozenNonResonantTerms const& NonResonant,
+                    FrozenResonantTerms const& Resonant,
+                    RealType DeltaTolerance,
+                    FreqArrays const& z,
+                    std::vector<ComplexType>& data,
+                    std::size_t b) {
+    std::size_t Begin = b * FreqBlockSize;
+    std::size_t End = std::min(Begin + FreqBlockSize, z.size());
+
+    std::array<RealType, FreqBlockSize> ResRe{}, ResIm{};
+    NonResonant.accumulate(z, Begin, End, ResRe.data(), ResIm.data());
+    Resonant.accumulate(z, Begin, End, DeltaTolerance, ResRe.data(), ResIm.data());
+
+    for(std::size_t w = Begin; w < End; ++w)
+        data[w] += ComplexType(ResRe[w - Begin], ResIm[w - Begin]);
+}
+
+} // namespace
+
+//
+// FrozenNonResonantTerms
+//
+
+constexpr std::array<bool, 2> FrozenNonResonantTerms::GroupFlags;
+
+const std::array<std::vector<RealType> FrozenNonResonantTerms::Group::*, FrozenNonResonantTerms::Group::NFields>
+    FrozenNonResonantTerms::Group::RealArrays = {
+        {&Group::CoeffRe, &Group::CoeffIm, &Group::P1, &Group::P2, &Group::P3}};
+const std::array<std::vector<float> FrozenNonResonantTerms::Group::*, FrozenNonResonantTerms::Group::NFields>
+    FrozenNonResonantTerms::Group::FloatArrays = {{nullptr, nullptr, &Group::P1f, &Group::P2f, &Group::P3f}};
+
+void FrozenNonResonantTerms::Group::clear() {
+    for(auto* A : {&CoeffRe, &CoeffIm, &P1, &P2, &P3})
+        A->clear();
+    for(auto* A : {&P1f, &P2f, &P3f})
+        A->clear();
+}
+
+void FrozenNonResonantTerms::Group::reserve(std::size_t Size, bool Single) {
+    for(auto* A : {&CoeffRe, &CoeffIm})
+        A->reserve(Size);
+    if(Single) {
+        for(auto* A : {&P1f, &P2f, &P3f})
+            A->reserve(Size);
+    } else {
+        for(auto* A : {&P1, &P2, &P3})
+            A->reserve(Size);
+    }
+}
+
+void FrozenNonResonantTerms::Group::push_back(ComplexType Coeff,
+                                              RealType P1,
+                                              RealType P2,
+                                              RealType P3,
+                                              bool Single,
+                                              RealType& PoleError) {
+    CoeffRe.push_back(Coeff.real());
+    CoeffIm.push_back(Coeff.imag());
+    if(Single) {
+        push_back_rounded(P1f, P1, PoleError);
+        push_back_rounded(P2f, P2, PoleError);
+        push_back_rounded(P3f, P3, PoleError);
+    } else {
+        this->P1.push_back(P1);
+        this->P2.push_back(P2);
+        this->P3.push_back(P3);
+    }
+}
+
+void FrozenNonResonantTerms::Group::accumulate(FreqArrays const& z,
+                                               std::size_t Begin,
+                                               std::size_t End,
+                                               std::size_t Middle,
+                                               RealType* ResRe,
+                                               RealType* ResIm) const {
+    std::size_t NFreqs = End - Begin;
+    RealType const* z1Re = z.Re[FreqArrays::Z1].data() + Begin;
+    RealType const* z1Im = z.Im[FreqArrays::Z1].data() + Begin;
+    RealType const* zmRe = z.Re[Middle].data() + Begin;
+    RealType const* zmIm = z.Im[Middle].data() + Begin;
+    RealType const* z3Re = z.Re[FreqArrays::Z3].data() + Begin;
+    RealType const* z3Im = z.Im[FreqArrays::Z3].data() + Begin;
+    if(P1f.empty())
+        accumulate_nonresonant(size(),
+                               CoeffRe.data(),
+                               CoeffIm.data(),
+                               P1.data(),
+                               P2.data(),
+                               P3.data(),
+                               NFreqs,
+                               z1Re,
+                               z1Im,
+                               zmRe,
+                               zmIm,
+                               z3Re,
+                               z3Im,
+                               ResRe,
+                               ResIm);
+    else
+        accumulate_nonresonant(size(),
+                               CoeffRe.data(),
+                               CoeffIm.data(),
+                               P1f.data(),
+                               P2f.data(),
+                               P3f.data(),
+                               NFreqs,
+                               z1Re,
+                               z1Im,
+                               zmRe,
+                               zmIm,
+                               z3Re,
+                               z3Im,
+                               ResRe,
+                               ResIm);
+}
+
+void FrozenNonResonantTerms::clear() {
+    TermsZ2.clear();
+    TermsZ4.clear();
+    PoleError = 0;
+}
+
+void FrozenNonResonantTerms::save(BinaryOutputArchive& ar) const {
+    Detail::save_frozen_terms(
+        ar, SinglePrecisionPoles, PoleError, GroupFlags, Group::NFields, [&](bool isz4, std::size_t Field) {
+            save_group_array(ar, isz4 ? TermsZ4 : TermsZ2, Field, SinglePrecisionPoles);
+        });
+}
+
+void FrozenNonResonantTerms::load(BinaryInputArchive& ar) {
+    SinglePrecisionPoles = ar.read<std::uint8_t>() != 0;
+    PoleError = ar.read<RealType>();
+    for(bool isz4 : GroupFlags)
+        load_group(ar, isz4 ? TermsZ4 : TermsZ2, SinglePrecisionPoles);
+}
+
+void FrozenNonResonantTerms::accumulate(FreqArrays const& z,
+                                        std::size_t Begin,
+                                        std::size_t End,
+                                        RealType* ResRe,
+                                        RealType* ResIm) const {
+    TermsZ2.accumulate(z, Begin, End, FreqArrays::Z2, ResRe, ResIm);
+    TermsZ4.accumulate(z, Begin, End, FreqArrays::Z123, ResRe, ResIm);
+}
+
+//
+// FrozenResonantTerms
+//
+
+constexpr std::array<bool, 2> FrozenResonantTerms::GroupFlags;
+
+const std::array<std::vector<RealType> FrozenResonantTerms::Group::*, FrozenResonantTerms::Group::NFields>
+    FrozenResonantTerms::Group::RealArrays = {
+        {&Group::ResCoeffRe, &Group::ResCoeffIm, &Group::NonResCoeffRe, &Group::NonResCoeffIm, &Group::P1, &Group::P3,
+         &Group::PRes}};
+const std::array<std::vector<float> FrozenResonantTerms::Group::*, FrozenResonantTerms::Group::NFields>
+    FrozenResonantTerms::Group::FloatArrays = {
+        {nullptr, nullptr, nullptr, nullptr, &Group::P1f, &Group::P3f, &Group::PResf}};
+
+void FrozenResonantTerms::Group::clear() {
+    for(auto* A : {&ResCoeffRe, &ResCoeffIm, &NonResCoeffRe, &NonResCoeffIm, &P1, &P3, &PRes})
+        A->clear();
+    for(auto* A : {&P1f, &P3f, &PResf})
+        A->clear();
+}
+
+void FrozenResonantTerms::Group::reserve(std::size_t Size, bool Single) {
+    for(auto* A : {&ResCoeffRe, &ResCoeffIm, &NonResCoeffRe, &NonResCoeffIm})
+        A->reserve(Size);
+    if(Single) {
+        for(auto* A : {&P1f, &P3f, &PResf})
+            A->reserve(Size);
+    } else {
+        for(auto* A : {&P1, &P3, &PRes})
+            A->reserve(Size);
+    }
+}
+
+void FrozenResonantTerms::Group::push_back(ComplexType ResCoeff,
+                                           ComplexType NonResCoeff,
+                                           RealType P1,
+                                           RealType P3,
+                                           RealType PRes,
+                                           bool Single,
+                                           RealType& PoleError) {
+    ResCoeffRe.push_back(ResCoeff.real());
+    ResCoeffIm.push_back(ResCoeff.imag());
+    NonResCoeffRe.push_back(NonResCoeff.real());
+    NonResCoeffIm.push_back(NonResCoeff.imag());
+    if(Single) {
+        push_back_rounded(P1f, P1, PoleError);
+        push_back_rounded(P3f, P3, PoleError);
+        push_back_rounded(PResf, PRes, PoleError);
+    } else {
+        this->P1.push_back(P1);
+        this->P3.push_back(P3);
+        this->PRes.push_back(PRes);
+    }
+}
+
+void FrozenResonantTerms::Group::accumulate(FreqArrays const& z,
+                                            std::size_t Begin,
+                                            std::size_t End,
+                                            std::size_t Res,
+                                            RealType DeltaTolerance,
+                                            RealType* ResRe,
+                                            RealType* ResIm) const {
+    std::size_t NFreqs = End - Begin;
+    RealType const* z1Re = z.Re[FreqArrays::Z1].data() + Begin;
+    RealType const* z1Im = z.Im[FreqArrays::Z1].data() + Begin;
+    RealType const* z3Re = z.Re[FreqArrays::Z3].data() + Begin;
+    RealType const* z3Im = z.Im[FreqArrays::Z3].data() + Begin;
+    RealType const* zrRe = z.Re[Res].data() + Begin;
+    RealType const* zrIm = z.Im[Res].data() + Begin;
+    if(P1f.empty())
+        accumulate_resonant(size(),
+                            ResCoeffRe.data(),
+                            ResCoeffIm.data(),
+                            NonResCoeffRe.data(),
+                            NonResCoeffIm.data(),
+                            P1.data(),
+                            P3.data(),
+                            PRes.data(),
+                            DeltaTolerance,
+                            NFreqs,
+                            z1Re,
+                            z1Im,
+                            z3Re,
+                            z3Im,
+                            zrRe,
+                            zrIm,
+                            ResRe,
+                            ResIm);
+    else
+        accumulate_resonant(size(),
+                            ResCoeffRe.data(),
+                            ResCoeffIm.data(),
+                            NonResCoeffRe.data(),
+                            NonResCoeffIm.data(),
+                            P1f.data(),
+                            P3f.data(),
+                            PResf.data(),
+                            DeltaTolerance,
+                            NFreqs,
+                            z1Re,
+                            z1Im,
+                            z3Re,
+                            z3Im,
+                            zrRe,
+                            zrIm,
+                            ResRe,
+                            ResIm);
+}
+
+void FrozenResonantTerms::clear() {
+    TermsZ12.clear();
+    TermsZ23.clear();
+    PoleError = 0;
+}
+
+void FrozenResonantTerms::save(BinaryOutputArchive& ar) const {
+    Detail::save_frozen_terms(
+        ar, SinglePrecisionPoles, PoleError, GroupFlags, Group::NFields, [&](bool isz1z2, std::size_t Field) {
+            save_group_array(ar, isz1z2 ? TermsZ12 : TermsZ23, Field, SinglePrecisionPoles);
+        });
+}
+
+void FrozenResonantTerms::load(BinaryInputArchive& ar) {
+    SinglePrecisionPoles = ar.read<std::uint8_t>() != 0;
+    PoleError = ar.read<RealType>();
+    for(bool isz1z2 : GroupFlags)
+        load_group(ar, isz1z2 ? TermsZ12 : TermsZ23, SinglePrecisionPoles);
+}
+
+void FrozenResonantTerms::accumulate(FreqArrays const& z,
+                                     std::size_t Begin,
+                                     std::size_t End,
+                                     RealType DeltaTolerance,
+                                     RealType* ResRe,
+                                     RealType* ResIm) const {
+    TermsZ12.accumulate(z, Begin, End, FreqArrays::Z12, DeltaTolerance, ResRe, ResIm);
+    TermsZ23.accumulate(z, Begin, End, FreqArrays::Z23, DeltaTolerance, ResRe, ResIm);
+}
+
+//
+// EvaluateFrozenTerms() and EvaluateFrozenTermsSerial()
+//
+
+void EvaluateFrozenTerms(FrozenNonResonantTerms const& NonResonant,
+                         FrozenResonantTerms const& Resonant,
+                         RealType DeltaTolerance,
+                         FreqArrays const& z,
+                         std::vector<ComplexType>& data) {
+    assert(data.size() == z.size());
+
+    long NBlocks = static_cast<long>((z.size() + FreqBlockSize - 1) / FreqBlockSize);
+#ifdef POMEROL_USE_OPENMP
+#pragma omp parallel for
+#endif
+    for(long b = 0; b < NBlocks; ++b)
+        evaluate_block(NonResonant, Resonant, DeltaTolerance, z, data, static_cast<std::size_t>(b));
+}
+
+void EvaluateFrozenTermsSerial(FrozenNonResonantTerms const& NonResonant,
+                               FrozenResonantTerms const& Resonant,
+                               RealType DeltaTolerance,
+                               FreqArrays const& z,
+                               std::vector<ComplexType>& data) {
+    assert(data.size() == z.size());
+
+    std::size_t NBlocks = (z.size() + FreqBlockSize - 1) / FreqBlockSize;
+    for(std::size_t b = 0; b < NBlocks; ++b)
+        evaluate_block(NonResonant, Resonant, DeltaTolerance, z, data, b);
+}
+
+} // namespace Pomerol
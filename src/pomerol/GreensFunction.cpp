@@ -25,7 +25,14 @@ GreensFunction::GreensFunction(StatesClassification const& S,
                                AnnihilationOperator const& C,
                                CreationOperator const& CX,
                                DensityMatrix const& DM)
-    : Thermal(DM.beta), ComputableObject(), S(S), H(H), C(C), CX(CX), DM(DM) {}
+    : Thermal(DM.beta),
+      ComputableObject(),
+      S(S),
+      H(H),
+      C(C),
+      CX(CX),
+      DM(DM),
+      Products(std::make_shared<ProductsMap>()) {}
 
 GreensFunction::GreensFunction(GreensFunction const& GF)
     : Thermal(GF.beta),
@@ -36,7 +43,20 @@ GreensFunction::GreensFunction(GreensFunction const& GF)
       CX(GF.CX),
       DM(GF.DM),
       Vanishing(GF.Vanishing),
-      parts(GF.parts) {}
+      parts(GF.parts),
+      Products(GF.Products),
+      KeepMatrixElementProducts(GF.KeepMatrixElementProducts) {}
+
+GreensFunction::GreensFunction(GreensFunction const& GF, DensityMatrix const& DM)
+    : Thermal(DM.beta),
+      ComputableObject(),
+      S(GF.S),
+      H(GF.H),
+      C(GF.C),
+      CX(GF.CX),
+      DM(DM),
+      Products(GF.Products),
+      KeepMatrixElementProducts(GF.KeepMatrixElementProducts) {}
 
 void GreensFunction::prepare() {
     if(getStatus() >= Prepared)
@@ -60,12 +80,14 @@ void GreensFunction::prepare() {
         if(Cleft == CXright && Cright == CXleft) {
             // check if retained blocks are included. If not, do not push.
             if(DM.isRetained(Cleft) || DM.isRetained(Cright)) {
+                auto PartProducts = Products->find(Cleft);
                 parts.emplace_back(C.getPartFromLeftIndex(Cleft),
                                    CX.getPartFromRightIndex(CXright),
                                    H.getPart(Cright),
                                    H.getPart(Cleft),
                                    DM.getPart(Cright),
-                                   DM.getPart(Cleft));
+                                   DM.getPart(Cleft),
+                                   PartProducts == Products->end() ? nullptr : PartProducts->second);
             }
         }
 
@@ -90,13 +112,30 @@ void GreensFunction::compute() {
         prepare();
 
     if(getStatus() < Computed) {
-        for(auto& p : parts)
+        for(auto& p : parts) {
+            p.KeepProducts = KeepMatrixElementProducts;
             p.compute();
+            if(KeepMatrixElementProducts)
+                (*Products)[p.getOuterBlock()] = p.getMatrixElementProducts();
+        }
     }
 
     setStatus(Computed);
 }
 
+std::vector<ComplexType> GreensFunction::evaluate(std::vector<ComplexType> const& z) const {
+    std::vector<ComplexType> out(z.size(), 0);
+    if(!Vanishing) {
+        for(auto const& p : parts)
+            p.evaluate(z, out);
+    }
+    return out;
+}
+
+std::vector<ComplexType> GreensFunction::evaluate(std::vector<long> const& MatsubaraNumbers) const {
+    return evaluate(fermionicMatsubaraGrid(MatsubaraNumbers));
+}
+
 ParticleIndex GreensFunction::getIndex(std::size_t Position) const {
     switch(Position) {
     case 0: return C.getIndex();
@@ -17,6 +17,7 @@
 
 #include <cassert>
 #include <cmath>
+#include <utility>
 
 namespace Pomerol {
 
@@ -41,7 +42,8 @@ GreensFunctionPart::GreensFunctionPart(MonomialOperatorPart const& C,
                                        HamiltonianPart const& HpartInner,
                                        HamiltonianPart const& HpartOuter,
                                        DensityMatrixPart const& DMpartInner,
-                                       DensityMatrixPart const& DMpartOuter)
+                                       DensityMatrixPart const& DMpartOuter,
+                                       std::shared_ptr<MatrixElementProducts const> Products)
     : Thermal(DMpartInner.beta),
       HpartInner(HpartInner),
       HpartOuter(HpartOuter),
@@ -49,17 +51,35 @@ GreensFunctionPart::GreensFunctionPart(MonomialOperatorPart const& C,
       DMpartOuter(DMpartOuter),
       C(C),
       CX(CX),
-      Terms(Term::Compare(), Term::IsNegligible()) {}
+      Terms(Term::Compare(), Term::IsNegligible()),
+      Products(std::move(Products)) {}
 
 void GreensFunctionPart::compute() {
-    if(C.isComplex() || CX.isComplex())
-        computeImpl<true>();
-    else
-        computeImpl<false>();
-}
+    if(!Products)
+        Products = (C.isComplex() || CX.isComplex()) ? computeProducts<true>() : computeProducts<false>();
 
-template <bool Complex> void GreensFunctionPart::computeImpl() {
+    // Combine the products with the statistical weights
     Terms.clear();
+    for(auto const& P : *Products) {
+        ComplexType Residue = P.Value * (DMpartOuter.getWeight(P.Outer) + DMpartInner.getWeight(P.Inner));
+        if(std::abs(Residue) > MatrixElementTolerance) // Is the residue relevant?
+        {
+            // Create a new term and append it to the list.
+            RealType Pole = HpartInner.getEigenValue(P.Inner) - HpartOuter.getEigenValue(P.Outer);
+            Terms.add_term(Term(Residue, Pole));
+        }
+    }
+
+    Terms.flush();
+    assert(Terms.check_terms());
+
+    if(!KeepProducts)
+        Products.reset();
+}
+
+template <bool Complex>
+std::shared_ptr<GreensFunctionPart::MatrixElementProducts const> GreensFunctionPart::computeProducts() const {
+    auto List = std::make_shared<MatrixElementProducts>();
 
     // Blocks (submatrices) of C and CX
     RowMajorMatrixType<Complex> const& Cmatrix = C.template getRowMajorValue<Complex>();
@@ -80,14 +100,11 @@ template <bool Complex> void GreensFunctionPart::computeImpl() {
 
             // A meaningful matrix element
             if(C_index2 == CX_index2) {
-                ComplexType Residue = Cinner.value() * CXinner.value() *
-                                      (DMpartOuter.getWeight(index1) + DMpartInner.getWeight(C_index2));
-                if(std::abs(Residue) > MatrixElementTolerance) // Is the residue relevant?
-                {
-                    // Create a new term and append it to the list.
-                    RealType Pole = HpartInner.getEigenValue(C_index2) - HpartOuter.getEigenValue(index1);
-                    Terms.add_term(Term(Residue, Pole));
-                };
+                ComplexType Value = Cinner.value() * CXinner.value();
+                // The sum of two statistical weights never exceeds 1, so smaller products
+                // cannot result in a relevant residue at any temperature.
+                if(std::abs(Value) > MatrixElementTolerance)
+                    List->push_back({Value, C_index2, index1});
                 ++Cinner;  // The next non-zero element
                 ++CXinner; // The next non-zero element
             } else {
@@ -102,7 +119,21 @@ template <bool Complex> void GreensFunctionPart::computeImpl() {
         }
     }
 
-    assert(Terms.check_terms());
+    return List;
+}
+
+void GreensFunctionPart::evaluate(std::vector<ComplexType> const& z, std::vector<ComplexType>& out) const {
+    assert(out.size() == z.size());
+    std::size_t size = z.size();
+    for(auto const& t : Terms.as_vector()) {
+        RealType const RRe = t.Residue.real(), RIm = t.Residue.imag();
+        // R / (z - P) = R * conj(z - P) / |z - P|^2
+        for(std::size_t w = 0; w < size; ++w) {
+            RealType const dRe = z[w].real() - t.Pole, dIm = z[w].imag();
+            RealType const invNorm = 1.0 / (dRe * dRe + dIm * dIm);
+            out[w] += ComplexType((RRe * dRe + RIm * dIm) * invNorm, (RIm * dRe - RRe * dIm) * invNorm);
+        }
+    }
 }
 
 } // namespace Pomerol
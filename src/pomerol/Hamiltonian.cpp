@@ -17,27 +17,40 @@
 
 #include "mpi_dispatcher/mpi_skel.hpp"
 
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <numeric>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace Pomerol {
 
-template <bool C> void Hamiltonian::prepareImpl(LOperatorTypeRC<C> const& HOp, MPI_Comm const& comm) {
+template <bool C> void Hamiltonian::createParts(LOperatorTypeRC<C> const& HOp) {
     BlockNumber NumberOfBlocks = S.getNumberOfBlocks();
-    int comm_rank = pMPI::rank(comm);
-    if(!comm_rank)
-        INFO_NONEWLINE("Preparing Hamiltonian parts...");
-
     parts.reserve(NumberOfBlocks);
     for(BlockNumber CurrentBlock = 0; CurrentBlock < NumberOfBlocks; ++CurrentBlock) {
         parts.emplace_back(HOp, S, CurrentBlock);
+        parts.back().Lanczos = Lanczos;
     }
+}
+
+template <bool C> void Hamiltonian::prepareImpl(LOperatorTypeRC<C> const& HOp, MPI_Comm const& comm) {
+    int comm_rank = pMPI::rank(comm);
+    if(!comm_rank)
+        INFO_NONEWLINE("Preparing Hamiltonian parts...");
+
+    createParts<C>(HOp);
 
     pMPI::mpi_skel<pMPI::PrepareWrap<HamiltonianPart>> skel;
     skel.parts.reserve(parts.size());
     for(auto& part : parts) {
-        skel.parts.emplace_back(pMPI::PrepareWrap<HamiltonianPart>(part));
+        // In the distributed storage mode, processes keep the parts they prepare, so the work has to be balanced
+        int complexity = DistributedStorage ? static_cast<int>(part.getSize()) : 1;
+        skel.parts.emplace_back(pMPI::PrepareWrap<HamiltonianPart>(part, complexity));
     }
     std::map<pMPI::JobId, pMPI::WorkerId> job_map = skel.run(comm, false);
     MPI_Barrier(comm);
@@ -46,17 +59,47 @@ template <bool C> void Hamiltonian::prepareImpl(LOperatorTypeRC<C> const& HOp, M
 
     for(int p = 0; p < static_cast<int>(parts.size()); ++p) {
         auto& part = parts[p];
+        // All processes agree on whether a part is stored in the sparse form
+        bool Sparse = part.useIterativeSolver();
+        part.Owner = job_map[p];
         if(comm_rank == job_map[p]) {
             if(part.getStatus() != HamiltonianPart::Prepared) {
                 ERROR("Worker" << comm_rank << " didn't calculate part" << p);
                 throw std::logic_error("Worker didn't calculate this part.");
             }
-            auto& H = part.getMatrix<C>();
-            MPI_Bcast(H.data(), H.size(), H_dt, comm_rank, comm);
+            if(DistributedStorage)
+                continue;
+            if(Sparse) {
+                auto& H = *std::static_pointer_cast<RowMajorMatrixType<C>>(part.HSparseMatrix);
+                H.makeCompressed();
+                long nnz = H.nonZeros();
+                MPI_Bcast(&nnz, 1, MPI_LONG, comm_rank, comm);
+                MPI_Bcast(H.outerIndexPtr(), H.outerSize() + 1, MPI_INT, comm_rank, comm);
+                MPI_Bcast(H.innerIndexPtr(), nnz, MPI_INT, comm_rank, comm);
+                MPI_Bcast(H.valuePtr(), nnz, H_dt, comm_rank, comm);
+            } else {
+                auto& H = part.getMatrix<C>();
+                MPI_Bcast(H.data(), H.size(), H_dt, comm_rank, comm);
+            }
         } else {
-            part.initHMatrix<C>();
-            auto& H = part.getMatrix<C>();
-            MPI_Bcast(H.data(), H.rows() * H.cols(), H_dt, job_map[p], comm);
+            if(DistributedStorage) {
+                part.setStatus(HamiltonianPart::Prepared);
+                continue;
+            }
+            if(Sparse) {
+                part.initHSparseMatrix<C>();
+                auto& H = *std::static_pointer_cast<RowMajorMatrixType<C>>(part.HSparseMatrix);
+                long nnz = 0;
+                MPI_Bcast(&nnz, 1, MPI_LONG, job_map[p], comm);
+                H.resizeNonZeros(nnz);
+                MPI_Bcast(H.outerIndexPtr(), H.outerSize() + 1, MPI_INT, job_map[p], comm);
+                MPI_Bcast(H.innerIndexPtr(), nnz, MPI_INT, job_map[p], comm);
+                MPI_Bcast(H.valuePtr(), nnz, H_dt, job_map[p], comm);
+            } else {
+                part.initHMatrix<C>();
+                auto& H = part.getMatrix<C>();
+                MPI_Bcast(H.data(), H.rows() * H.cols(), H_dt, job_map[p], comm);
+            }
             part.setStatus(HamiltonianPart::Prepared);
         }
     }
@@ -65,7 +108,67 @@ template <bool C> void Hamiltonian::prepareImpl(LOperatorTypeRC<C> const& HOp, M
 template void Hamiltonian::prepareImpl<true>(LOperatorTypeRC<true> const&, MPI_Comm const&);
 template void Hamiltonian::prepareImpl<false>(LOperatorTypeRC<false> const&, MPI_Comm const&);
 
+template <bool C> void Hamiltonian::prepareAndComputeImpl(LOperatorTypeRC<C> const& HOp, MPI_Comm const& comm) {
+    createParts<C>(HOp);
+
+#ifdef POMEROL_USE_OPENMP
+    if(pMPI::size(comm) == 1) {
+        for(auto& part : parts)
+            part.prepare();
+        std::vector<BlockNumber> Blocks(parts.size());
+        std::iota(Blocks.begin(), Blocks.end(), 0);
+        computeBlocks(Blocks);
+        return;
+    }
+#endif
+
+    // Each part is filled and diagonalized by the same process
+    pMPI::mpi_skel<pMPI::PrepareAndComputeWrap<HamiltonianPart>> skel;
+    skel.parts.reserve(parts.size());
+    for(auto& part : parts) {
+        skel.parts.emplace_back(pMPI::PrepareAndComputeWrap<HamiltonianPart>(part, static_cast<int>(part.getSize())));
+    }
+    std::map<pMPI::JobId, pMPI::WorkerId> job_map = skel.run(comm, true);
+    for(int p = 0; p < static_cast<int>(parts.size()); ++p)
+        parts[p].Owner = job_map[p];
+
+    MPI_Barrier(comm);
+    if(DistributedStorage)
+        broadcastEigenvalues(comm);
+    else
+        broadcastEigensystems<C>(job_map, comm);
+}
+
+template void Hamiltonian::prepareAndComputeImpl<true>(LOperatorTypeRC<true> const&, MPI_Comm const&);
+template void Hamiltonian::prepareAndComputeImpl<false>(LOperatorTypeRC<false> const&, MPI_Comm const&);
+
 template <bool C> void Hamiltonian::computeImpl(MPI_Comm const& comm) {
+    int comm_rank = pMPI::rank(comm);
+    for(auto& part : parts)
+        part.Lanczos = Lanczos;
+
+#ifdef POMEROL_USE_OPENMP
+    // Blocks are diagonalized by threads of the only process, no data has to be distributed
+    if(pMPI::size(comm) == 1) {
+        std::vector<BlockNumber> Blocks(parts.size());
+        std::iota(Blocks.begin(), Blocks.end(), 0);
+        computeBlocks(Blocks);
+        return;
+    }
+#endif
+
+    if(DistributedStorage) {
+        // Each process diagonalizes the parts it has prepared and keeps their eigenvectors
+        std::vector<BlockNumber> Blocks;
+        for(BlockNumber b = 0; b < static_cast<BlockNumber>(parts.size()); ++b) {
+            if(parts[b].Owner == comm_rank)
+                Blocks.push_back(b);
+        }
+        computeBlocks(Blocks);
+        broadcastEigenvalues(comm);
+        return;
+    }
+
     // Create a "skeleton" class with pointers to part that can call a compute method
     pMPI::mpi_skel<pMPI::ComputeWrap<HamiltonianPart>> skel;
     skel.parts.reserve(parts.size());
@@ -73,23 +176,51 @@ template <bool C> void Hamiltonian::computeImpl(MPI_Comm const& comm) {
         skel.parts.emplace_back(pMPI::ComputeWrap<HamiltonianPart>(part, static_cast<int>(part.getSize())));
     }
     std::map<pMPI::JobId, pMPI::WorkerId> job_map = skel.run(comm, true);
-    int comm_rank = pMPI::rank(comm);
 
     // Start distributing data
     MPI_Barrier(comm);
+    broadcastEigensystems<C>(job_map, comm);
+}
+
+void Hamiltonian::broadcastEigenvalues(MPI_Comm const& comm) {
+    int comm_rank = pMPI::rank(comm);
+    for(auto& part : parts) {
+        bool Local = part.Owner == comm_rank;
+        long NumEigenstates = Local ? part.Eigenvalues.size() : 0;
+        MPI_Bcast(&NumEigenstates, 1, MPI_LONG, part.Owner, comm);
+        if(!Local)
+            part.Eigenvalues.resize(NumEigenstates);
+        MPI_Bcast(part.Eigenvalues.data(), static_cast<int>(NumEigenstates), MPI_DOUBLE, part.Owner, comm);
+        if(!Local)
+            part.setStatus(HamiltonianPart::Computed);
+    }
+}
+
+template <bool C>
+void Hamiltonian::broadcastEigensystems(std::map<pMPI::JobId, pMPI::WorkerId>& job_map, MPI_Comm const& comm) {
+    int comm_rank = pMPI::rank(comm);
     MPI_Datatype H_dt = C ? MPI_CXX_DOUBLE_COMPLEX : MPI_DOUBLE;
     for(int p = 0; p < static_cast<int>(parts.size()); ++p) {
         auto& part = parts[p];
-        auto& H = part.getMatrix<C>();
         if(comm_rank == job_map[p]) {
             if(part.getStatus() != HamiltonianPart::Computed) {
                 ERROR("Worker" << comm_rank << " didn't calculate part" << p);
                 throw std::logic_error("Worker didn't calculate this part.");
             }
+            auto& H = part.getMatrix<C>();
+            // The iterative eigensolver may have computed only some of the eigenstates
+            long NumEigenstates = H.cols();
+            MPI_Bcast(&NumEigenstates, 1, MPI_LONG, comm_rank, comm);
             MPI_Bcast(H.data(), H.size(), H_dt, comm_rank, comm);
             MPI_Bcast(part.Eigenvalues.data(), static_cast<int>(part.Eigenvalues.size()), MPI_DOUBLE, comm_rank, comm);
         } else {
-            part.Eigenvalues.resize(H.rows());
+            long NumEigenstates = 0;
+            MPI_Bcast(&NumEigenstates, 1, MPI_LONG, job_map[p], comm);
+            // Replace the prepared (dense or sparse) matrix with the matrix of eigenvectors
+            part.HMatrix = std::make_shared<MatrixType<C>>(part.getSize(), NumEigenstates);
+            part.HSparseMatrix.reset();
+            auto& H = part.getMatrix<C>();
+            part.Eigenvalues.resize(NumEigenstates);
             MPI_Bcast(H.data(), H.size(), H_dt, job_map[p], comm);
             MPI_Bcast(part.Eigenvalues.data(), static_cast<int>(part.Eigenvalues.size()), MPI_DOUBLE, job_map[p], comm);
             part.setStatus(HamiltonianPart::Computed);
@@ -97,6 +228,53 @@ template <bool C> void Hamiltonian::computeImpl(MPI_Comm const& comm) {
     }
 }
 
+void Hamiltonian::computeBlocks(std::vector<BlockNumber> const& Blocks) {
+    // Cost of the dense diagonalization of a block
+    std::vector<double> Costs;
+    Costs.reserve(Blocks.size());
+    for(BlockNumber b : Blocks)
+        Costs.push_back(std::pow(static_cast<double>(parts[b].getSize()), 3));
+
+    // Only LAPACK's eigensolvers can use multiple threads to diagonalize the largest blocks
+#ifdef POMEROL_USE_LAPACK
+    bool SerialLarge = true;
+#else
+    bool SerialLarge = false;
+#endif
+    RunJobsByCost(Costs, [this, &Blocks](std::size_t n) { parts[Blocks[n]].compute(); }, SerialLarge);
+}
+
+void Hamiltonian::publishEigenvectors() {
+    int comm_rank = pMPI::rank(Window->Comm);
+    Window->detachAll();
+
+    std::vector<MPI_Aint> Addresses(parts.size(), 0);
+    for(std::size_t b = 0; b < parts.size(); ++b) {
+        auto& part = parts[b];
+        part.Window = Window.get();
+        if(part.Owner != comm_rank)
+            continue;
+
+        void* Base;
+        std::size_t Size;
+        if(Complex) {
+            auto& H = part.getMatrix<true>();
+            Base = H.data();
+            Size = H.size() * sizeof(ComplexType);
+        } else {
+            auto& H = part.getMatrix<false>();
+            Base = H.data();
+            Size = H.size() * sizeof(RealType);
+        }
+        if(Size)
+            Addresses[b] = Window->attach(Base, Size);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, Addresses.data(), static_cast<int>(parts.size()), MPI_AINT, MPI_SUM, Window->Comm);
+
+    for(std::size_t b = 0; b < parts.size(); ++b)
+        parts[b].Address = Addresses[b];
+}
+
 void Hamiltonian::compute(MPI_Comm const& comm) {
     if(getStatus() >= Computed)
         return;
@@ -106,15 +284,108 @@ void Hamiltonian::compute(MPI_Comm const& comm) {
     else
         computeImpl<false>(comm);
 
+    finalizeCompute(comm);
+}
+
+void Hamiltonian::finalizeCompute(MPI_Comm const& comm) {
     computeGroundEnergy();
 
+    if(Lanczos.MinBlockSize != 0) {
+        for(auto& part : parts) {
+            if(part.getSize() >= Lanczos.MinBlockSize)
+                part.reduce(GroundEnergy + Lanczos.EnergyWindow);
+        }
+    }
+
+    if(DistributedStorage && pMPI::size(comm) > 1) {
+        Window.reset(new EigenvectorsWindow(comm));
+        publishEigenvectors();
+    }
+
     setStatus(Computed);
 }
 
 void Hamiltonian::reduce(RealType Cutoff) {
     INFO("Performing EV cutoff at " << Cutoff << " level");
+    // Truncated matrices are reallocated and have to be attached to the window anew
+    if(Window)
+        Window->detachAll();
     for(auto& part : parts)
         part.reduce(GroundEnergy + Cutoff);
+    if(Window)
+        publishEigenvectors();
+}
+
+void Hamiltonian::setBlockShifts(std::vector<RealType> const& Shifts) {
+    if(getStatus() < Computed)
+        throw StatusMismatch("Hamiltonian is not computed yet.");
+    if(Shifts.size() != parts.size())
+        throw std::runtime_error("Hamiltonian: Wrong number of block shifts");
+
+    if(BlockShifts.empty())
+        BlockShifts.assign(parts.size(), 0);
+    for(std::size_t b = 0; b < parts.size(); ++b) {
+        parts[b].Eigenvalues.array() += Shifts[b] - BlockShifts[b];
+        BlockShifts[b] = Shifts[b];
+    }
+    computeGroundEnergy();
+}
+
+void Hamiltonian::save(BinaryOutputArchive& ar) const {
+    if(getStatus() < Computed)
+        throw StatusMismatch("Hamiltonian is not computed yet.");
+
+    ar.beginSection("HAMILTON");
+    ar.write(std::uint8_t(Complex));
+    ar.write(std::uint64_t(parts.size()));
+    if(Complex)
+        saveImpl<true>(ar);
+    else
+        saveImpl<false>(ar);
+}
+
+template <bool C> void Hamiltonian::saveImpl(BinaryOutputArchive& ar) const {
+    for(auto const& part : parts) {
+        ar.writeArray(part.Eigenvalues.data(), part.Eigenvalues.size());
+        ar.writeDenseMatrix<C>(*part.fetchMatrix<C>());
+    }
+}
+
+void Hamiltonian::load(BinaryInputArchive& ar) {
+    if(getStatus() >= Prepared)
+        throw StatusMismatch("Hamiltonian is already prepared.");
+
+    ar.beginSection("HAMILTON");
+    Complex = ar.read<std::uint8_t>() != 0;
+    if(ar.read<std::uint64_t>() != std::uint64_t(S.getNumberOfBlocks()))
+        throw std::runtime_error("Hamiltonian: Number of blocks in the checkpoint file does not match");
+    if(Complex)
+        loadImpl<true>(ar);
+    else
+        loadImpl<false>(ar);
+
+    BlockShifts.clear();
+    computeGroundEnergy();
+    setStatus(Computed);
+}
+
+template <bool C> void Hamiltonian::loadImpl(BinaryInputArchive& ar) {
+    parts.clear();
+    parts.reserve(S.getNumberOfBlocks());
+    for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+        parts.emplace_back(S, Block, C);
+        auto& part = parts.back();
+
+        part.Eigenvalues.resize(ar.readArraySize());
+        ar.readArrayData(part.Eigenvalues.data(), part.Eigenvalues.size());
+        auto Eigenvectors = std::make_shared<MatrixType<C>>(ar.readDenseMatrix<C>());
+        if(InnerQuantumState(Eigenvectors->rows()) != S.getBlockSize(Block) ||
+           Eigenvectors->cols() != part.Eigenvalues.size())
+            throw std::runtime_error("Hamiltonian: Wrong size of block " + std::to_string(Block) +
+                                     " in the checkpoint file");
+        part.HMatrix = Eigenvectors;
+        part.setStatus(HamiltonianPart::Computed);
+    }
 }
 
 InnerQuantumState Hamiltonian::getBlockSize(BlockNumber Block) const {
@@ -137,7 +408,11 @@ RealVectorType const& Hamiltonian::getEigenValues(BlockNumber Block) const {
 }
 
 RealVectorType Hamiltonian::getEigenValues() const {
-    RealVectorType out(S.getNumberOfStates());
+    long size = 0;
+    for(auto const& part : parts)
+        size += part.getEigenValues().size();
+
+    RealVectorType out(size);
     long copied_size = 0;
     for(auto const& part : parts) {
         auto const& ev = part.getEigenValues();
@@ -18,18 +18,351 @@
 // clang-format off
 #include <libcommute/loperator/state_vector_eigen3.hpp>
 #include <libcommute/loperator/mapped_basis_view.hpp>
+#include <libcommute/loperator/sparse_state_vector.hpp>
 // clang-format on
 
 #include <Eigen/Eigenvalues>
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <complex>
+#include <cstdint>
 #include <limits>
+#include <random>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef POMEROL_USE_LAPACK
+extern "C" {
+void dsyevd_(char const* jobz,
+             char const* uplo,
+             int const* n,
+             double* a,
+             int const* lda,
+             double* w,
+             double* work,
+             int const* lwork,
+             int* iwork,
+             int const* liwork,
+             int* info);
+void zheevd_(char const* jobz,
+             char const* uplo,
+             int const* n,
+             std::complex<double>* a,
+             int const* lda,
+             double* w,
+             std::complex<double>* work,
+             int const* lwork,
+             double* rwork,
+             int const* lrwork,
+             int* iwork,
+             int const* liwork,
+             int* info);
+}
+#endif
 
 namespace Pomerol {
 
+namespace {
+
+#ifdef POMEROL_USE_LAPACK
+// Convert a dimension or a workspace size to the integer type of the LAPACK interface.
+// The sizes grow as the square of the block dimension and are computed in 64 bits to detect overflows.
+int lapack_int(std::int64_t Value, char const* Routine, char const* Name) {
+    if(Value > std::numeric_limits<int>::max())
+        throw std::runtime_error(std::string("LAPACK routine ") + Routine + ": " + Name + " = " +
+                                 std::to_string(Value) + " exceeds the range of int, the block is too large");
+    return static_cast<int>(Value);
+}
+
+// Diagonalize a dense Hermitian matrix in place using LAPACK's divide-and-conquer drivers.
+// LAPACK interprets the row-major storage of H as the column-major storage of H^T = H^*,
+// whose eigenvectors are complex conjugates of those of H. The adjoint of the returned
+// (column-major) eigenvector matrix recovers the eigenvectors of H in the row-major storage.
+void lapack_eigensolver(MatrixType<false>& H, RealVectorType& Eigenvalues) {
+    char const jobz = 'V', uplo = 'L';
+    std::int64_t const N = H.rows();
+    int const n = lapack_int(N, "dsyevd", "N");
+    Eigenvalues.resize(n);
+
+    // Minimal workspace sizes documented for JOBZ = 'V'
+    std::int64_t const LWorkMin = 1 + 6 * N + 2 * N * N, LIWorkMin = 3 + 5 * N;
+    lapack_int(LWorkMin, "dsyevd", "LWORK");
+    lapack_int(LIWorkMin, "dsyevd", "LIWORK");
+
+    int info = 0;
+    int lwork = -1, liwork = -1;
+    double work_size = 0;
+    int iwork_size = 0;
+    dsyevd_(&jobz, &uplo, &n, H.data(), &n, Eigenvalues.data(), &work_size, &lwork, &iwork_size, &liwork, &info);
+
+    lwork = lapack_int(std::max(LWorkMin, static_cast<std::int64_t>(work_size)), "dsyevd", "LWORK");
+    liwork = lapack_int(std::max(LIWorkMin, static_cast<std::int64_t>(iwork_size)), "dsyevd", "LIWORK");
+    std::vector<double> work(lwork);
+    std::vector<int> iwork(liwork);
+    dsyevd_(&jobz, &uplo, &n, H.data(), &n, Eigenvalues.data(), work.data(), &lwork, iwork.data(), &liwork, &info);
+    if(info != 0)
+        throw std::runtime_error("LAPACK routine dsyevd has failed with INFO = " + std::to_string(info));
+
+    H.adjointInPlace();
+}
+
+void lapack_eigensolver(MatrixType<true>& H, RealVectorType& Eigenvalues) {
+    char const jobz = 'V', uplo = 'L';
+    std::int64_t const N = H.rows();
+    int const n = lapack_int(N, "zheevd", "N");
+    Eigenvalues.resize(n);
+
+    // Minimal workspace sizes documented for JOBZ = 'V'
+    std::int64_t const LWorkMin = 2 * N + N * N, LRWorkMin = 1 + 5 * N + 2 * N * N, LIWorkMin = 3 + 5 * N;
+    lapack_int(LWorkMin, "zheevd", "LWORK");
+    lapack_int(LRWorkMin, "zheevd", "LRWORK");
+    lapack_int(LIWorkMin, "zheevd", "LIWORK");
+
+    int info = 0;
+    int lwork = -1, lrwork = -1, liwork = -1;
+    ComplexType work_size = 0;
+    double rwork_size = 0;
+    int iwork_size = 0;
+    zheevd_(&jobz,
+            &uplo,
+            &n,
+            H.data(),
+            &n,
+            Eigenvalues.data(),
+            &work_size,
+            &lwork,
+            &rwork_size,
+            &lrwork,
+            &iwork_size,
+            &liwork,
+            &info);
+
+    lwork = lapack_int(std::max(LWorkMin, static_cast<std::int64_t>(work_size.real())), "zheevd", "LWORK");
+    lrwork = lapack_int(std::max(LRWorkMin, static_cast<std::int64_t>(rwork_size)), "zheevd", "LRWORK");
+    liwork = lapack_int(std::max(LIWorkMin, static_cast<std::int64_t>(iwork_size)), "zheevd", "LIWORK");
+    std::vector<ComplexType> work(lwork);
+    std::vector<double> rwork(lrwork);
+    std::vector<int> iwork(liwork);
+    zheevd_(&jobz,
+            &uplo,
+            &n,
+            H.data(),
+            &n,
+            Eigenvalues.data(),
+            work.data(),
+            &lwork,
+            rwork.data(),
+            &lrwork,
+            iwork.data(),
+            &liwork,
+            &info);
+    if(info != 0)
+        throw std::runtime_error("LAPACK routine zheevd has failed with INFO = " + std::to_string(info));
+
+    H.adjointInPlace();
+}
+#endif
+
+template <typename ScalarType> ScalarType random_scalar(std::mt19937& rng);
+template <> RealType random_scalar<RealType>(std::mt19937& rng) {
+    return std::uniform_real_distribution<RealType>(-1.0, 1.0)(rng);
+}
+template <> ComplexType random_scalar<ComplexType>(std::mt19937& rng) {
+    std::uniform_real_distribution<RealType> dist(-1.0, 1.0);
+    RealType re = dist(rng);
+    return {re, dist(rng)};
+}
+
+// Orthonormalize columns of W against the first NV columns of V and among themselves,
+// W = V V^\dagger W + Q R. On exit, W holds Q, and R is returned. Linearly dependent columns
+// are replaced with random vectors (the corresponding rows of R are zero).
+template <typename Mat>
+Mat orthonormalize_block(Mat const& V, Eigen::Index NV, Mat& W, RealType Scale, std::mt19937& rng) {
+    Eigen::Index b = W.cols();
+    Mat R = Mat::Zero(b, b);
+    RealType const BreakdownTolerance = 1e-12 * Scale;
+    for(Eigen::Index c = 0; c < b; ++c) {
+        // Two passes of the classical Gram-Schmidt process
+        for(int pass = 0; pass < 2; ++pass) {
+            Mat r = W.leftCols(c).adjoint() * W.col(c);
+            W.col(c) -= W.leftCols(c) * r;
+            R.col(c).head(c) += r;
+        }
+        RealType norm = W.col(c).norm();
+        if(norm > BreakdownTolerance) {
+            R(c, c) = norm;
+            W.col(c) /= norm;
+            continue;
+        }
+        // An invariant subspace has been found, continue with a random direction
+        for(Eigen::Index i = 0; i < W.rows(); ++i)
+            W(i, c) = random_scalar<typename Mat::Scalar>(rng);
+        for(int pass = 0; pass < 2; ++pass) {
+            W.col(c) -= V.leftCols(NV) * (V.leftCols(NV).adjoint() * W.col(c));
+            W.col(c) -= W.leftCols(c) * (W.leftCols(c).adjoint() * W.col(c));
+        }
+        W.col(c).normalize();
+    }
+    return R;
+}
+
+// Thick-restart block Lanczos method with full reorthogonalization.
+//
+// Computes all eigenpairs of the Hermitian matrix H with eigenvalues not exceeding E_min + Params.EnergyWindow,
+// where E_min is the lowest eigenvalue of H. Returns false if the Krylov subspace required to accommodate
+// those eigenpairs is too large for the method to be advantageous over the dense eigensolver.
+template <bool C, typename HMatrixType>
+bool lanczos(HMatrixType const& H,
+             LanczosParameters const& Params,
+             RealVectorType& Eigenvalues,
+             MatrixType<C>& Eigenvectors) {
+    using Mat = Eigen::Matrix<MelemType<C>, Eigen::Dynamic, Eigen::Dynamic>;
+
+    Eigen::Index const N = H.rows();
+    Eigen::Index const b = std::max<Eigen::Index>(1, std::min<Eigen::Index>(Params.BlockSize, N));
+    // Dimension of the Krylov subspace, a multiple of b
+    Eigen::Index m = std::max<Eigen::Index>(Params.SubspaceSize, 4 * b);
+    m = ((m + b - 1) / b) * b;
+    if(2 * m > N)
+        return false;
+
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(N));
+    // Estimate of the matrix norm used to detect breakdowns
+    RealType Scale = 1.0;
+
+    // Orthonormal basis of the subspace followed by the residual block
+    Mat V(N, m + b);
+    // Projection of H onto the subspace
+    Mat T = Mat::Zero(m, m);
+    // H V = V T + Q R E^\dagger, where Q is the residual block
+    Mat R;
+
+    Mat W(N, b);
+    for(Eigen::Index c = 0; c < b; ++c)
+        for(Eigen::Index i = 0; i < N; ++i)
+            W(i, c) = random_scalar<MelemType<C>>(rng);
+    orthonormalize_block(V, 0, W, Scale, rng);
+    V.leftCols(b) = W;
+
+    // Number of Ritz vectors retained at the last restart
+    Eigen::Index k = 0;
+    for(unsigned int restart = 0; restart <= Params.MaxRestarts; ++restart) {
+        for(Eigen::Index j = k; j < m; j += b) {
+            W.noalias() = H * V.middleCols(j, b);
+            Scale = std::max(Scale, W.colwise().norm().maxCoeff());
+
+            // Full reorthogonalization; the projection coefficients form new columns of T
+            Mat Tj = V.leftCols(j + b).adjoint() * W;
+            W.noalias() -= V.leftCols(j + b) * Tj;
+            Mat Tj2 = V.leftCols(j + b).adjoint() * W;
+            W.noalias() -= V.leftCols(j + b) * Tj2;
+            Tj += Tj2;
+
+            T.block(0, j, j + b, b) = Tj;
+            T.block(j, 0, b, j) = Tj.topRows(j).adjoint();
+            Mat Tjj = T.block(j, j, b, b);
+            T.block(j, j, b, b) = (Tjj + Tjj.adjoint()) / 2;
+
+            R = orthonormalize_block(V, j + b, W, Scale, rng);
+            V.middleCols(j + b, b) = W;
+        }
+
+        Eigen::SelfAdjointEigenSolver<Mat> Solver(T);
+        RealVectorType const& Theta = Solver.eigenvalues();
+        Mat const& Y = Solver.eigenvectors();
+
+        RealType Cutoff = Theta(0) + Params.EnergyWindow;
+        Eigen::Index K = 0;
+        while(K < m && Theta(K) <= Cutoff)
+            ++K;
+
+        // Residual of the i-th Ritz pair is Q R Y.bottomRows(b).col(i)
+        Mat Residuals = R * Y.bottomRows(b);
+        auto converged = [&](Eigen::Index i) {
+            return Residuals.col(i).norm() <= Params.Tolerance * std::max(1.0, std::abs(Theta(i)));
+        };
+
+        // The lowest Ritz value outside the window must converge as well,
+        // otherwise some eigenvalues within the window may be missing.
+        if(K < m) {
+            bool all_converged = true;
+            for(Eigen::Index i = 0; i <= K && all_converged; ++i)
+                all_converged = converged(i);
+            if(all_converged) {
+                Eigenvalues = Theta.head(K);
+                Eigenvectors = V.leftCols(m) * Y.leftCols(K);
+                return true;
+            }
+        }
+
+        // Enlarge the subspace if there is not enough room for the wanted Ritz vectors
+        Eigen::Index mNew = m;
+        while(K + 1 + 2 * b > mNew)
+            mNew *= 2;
+        if(2 * mNew > N)
+            return false;
+
+        // Thick restart: retain the lowest Ritz vectors and the residual block
+        Eigen::Index keep = std::min(std::max(K + 1 + b, m / 2), m);
+        keep = mNew - ((mNew - keep + b - 1) / b) * b;
+
+        Mat U = V.leftCols(m) * Y.leftCols(keep);
+        Mat Q = V.middleCols(m, b);
+        if(mNew != m) {
+            V.resize(N, mNew + b);
+            T.resize(mNew, mNew);
+            m = mNew;
+        }
+        V.leftCols(keep) = U;
+        V.middleCols(keep, b) = Q;
+        T.setZero();
+        T.diagonal().head(keep) = Theta.head(keep);
+        k = keep;
+    }
+
+    throw std::runtime_error("Lanczos eigensolver has failed to converge");
+}
+
+} // namespace
+
+//
+// class EigenvectorsWindow
+//
+
+EigenvectorsWindow::EigenvectorsWindow(MPI_Comm const& comm) {
+    MPI_Comm_dup(comm, &Comm);
+    MPI_Win_create_dynamic(MPI_INFO_NULL, Comm, &Win);
+}
+
+EigenvectorsWindow::~EigenvectorsWindow() {
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if(finalized)
+        return;
+    detachAll();
+    MPI_Win_free(&Win);
+    MPI_Comm_free(&Comm);
+}
+
+MPI_Aint EigenvectorsWindow::attach(void* Base, std::size_t Size) {
+    MPI_Win_attach(Win, Base, static_cast<MPI_Aint>(Size));
+    Attached.push_back(Base);
+    MPI_Aint Address;
+    MPI_Get_address(Base, &Address);
+    return Address;
+}
+
+void EigenvectorsWindow::detachAll() {
+    for(void* Base : Attached)
+        MPI_Win_detach(Win, Base);
+    Attached.clear();
+}
+
 //
 // class HamiltonianPart
 //
@@ -39,14 +372,30 @@ template <bool C> void HamiltonianPart::initHMatrix() {
     HMatrix = std::make_shared<MatrixType<C>>(BlockSize, BlockSize);
 }
 
+template <bool C> void HamiltonianPart::initHSparseMatrix() {
+    InnerQuantumState BlockSize = S.getBlockSize(Block);
+    HSparseMatrix = std::make_shared<RowMajorMatrixType<C>>(BlockSize, BlockSize);
+}
+
+bool HamiltonianPart::useIterativeSolver() const {
+    return Lanczos.MinBlockSize != 0 && getSize() >= Lanczos.MinBlockSize;
+}
+
 void HamiltonianPart::prepare() {
     if(getStatus() >= Prepared)
         return;
 
-    if(isComplex())
-        prepareImpl<true>();
-    else
-        prepareImpl<false>();
+    if(useIterativeSolver()) {
+        if(isComplex())
+            prepareSparseImpl<true>();
+        else
+            prepareSparseImpl<false>();
+    } else {
+        if(isComplex())
+            prepareImpl<true>();
+        else
+            prepareImpl<false>();
+    }
 
     setStatus(Prepared);
 }
@@ -73,6 +422,41 @@ template <bool C> void HamiltonianPart::prepareImpl() {
     assert((HMatrix_.adjoint() - HMatrix_).array().abs().maxCoeff() < 100 * std::numeric_limits<RealType>::epsilon());
 }
 
+template <bool C> void HamiltonianPart::prepareSparseImpl() {
+    initHSparseMatrix<C>();
+
+    auto const& HOp_ = *static_cast<LOperatorTypeRC<C> const*>(HOp);
+    auto& HMatrix_ = *std::static_pointer_cast<RowMajorMatrixType<C>>(HSparseMatrix);
+
+    auto const& FockStates = S.getFockStates(Block);
+    auto BlockSize = S.getBlockSize(Block);
+
+    // The matrix is Hermitian, so its row 'st' is the complex conjugate of
+    // the result of acting with the Hamiltonian on Fock state 'st'.
+    std::vector<std::pair<InnerQuantumState, MelemType<C>>> Row;
+    libcommute::sparse_state_vector<MelemType<C>> bra(S.getNumberOfStates());
+    for(InnerQuantumState st = 0; st < BlockSize; ++st) {
+        libcommute::sparse_state_vector<MelemType<C>> ket(S.getNumberOfStates());
+        ket[FockStates[st]] = 1.0;
+        HOp_(ket, bra);
+
+        Row.clear();
+        libcommute::foreach(bra, [&](libcommute::sv_index_type State, MelemType<C> const& Value) {
+            if(Value != MelemType<C>(0))
+                Row.emplace_back(S.getInnerState(State), Eigen::numext::conj(Value));
+        });
+        std::sort(Row.begin(), Row.end(), [](std::pair<InnerQuantumState, MelemType<C>> const& el1,
+                                             std::pair<InnerQuantumState, MelemType<C>> const& el2) {
+            return el1.first < el2.first;
+        });
+
+        HMatrix_.startVec(st);
+        for(auto const& el : Row)
+            HMatrix_.insertBack(st, el.first) = el.second;
+    }
+    HMatrix_.finalize();
+}
+
 void HamiltonianPart::compute() {
     if(getStatus() >= Computed)
         return;
@@ -86,6 +470,23 @@ void HamiltonianPart::compute() {
 }
 
 template <bool C> void HamiltonianPart::computeImpl() {
+    if(useIterativeSolver()) {
+        MatrixType<C> Eigenvectors;
+        bool Converged = isSparse() ? lanczos<C>(getSparseMatrix<C>(), Lanczos, Eigenvalues, Eigenvectors) :
+                                      lanczos<C>(getMatrix<C>(), Lanczos, Eigenvalues, Eigenvectors);
+        if(Converged) {
+            HMatrix = std::make_shared<MatrixType<C>>(std::move(Eigenvectors));
+            HSparseMatrix.reset();
+            return;
+        }
+    }
+
+    // Materialize the dense matrix for the dense eigensolver
+    if(isSparse()) {
+        HMatrix = std::make_shared<MatrixType<C>>(getSparseMatrix<C>());
+        HSparseMatrix.reset();
+    }
+
     auto& HMatrix_ = getMatrix<C>();
     if(HMatrix_.rows() == 1) {
         assert(std::abs(HMatrix_(0, 0) - std::real(HMatrix_(0, 0))) < std::numeric_limits<RealType>::epsilon());
@@ -93,15 +494,21 @@ template <bool C> void HamiltonianPart::computeImpl() {
         Eigenvalues << std::real(HMatrix_(0, 0));
         HMatrix_(0, 0) = 1;
     } else {
+#ifdef POMEROL_USE_LAPACK
+        lapack_eigensolver(HMatrix_, Eigenvalues);
+#else
         Eigen::SelfAdjointEigenSolver<MatrixType<C>> Solver(HMatrix_, Eigen::ComputeEigenvectors);
         HMatrix_ = Solver.eigenvectors();
         Eigenvalues = Solver.eigenvalues(); // eigenvectors are ready
+#endif
     }
 }
 
 template <bool C> MatrixType<C> const& HamiltonianPart::getMatrix() const {
     if(C != isComplex())
         throw std::runtime_error("Stored matrix type mismatch (real/complex)");
+    if(!HMatrix)
+        throw std::runtime_error("Dense matrix is not available");
     return *std::static_pointer_cast<const MatrixType<C>>(HMatrix);
 }
 template MatrixType<true> const& HamiltonianPart::getMatrix<true>() const;
@@ -110,11 +517,52 @@ template MatrixType<false> const& HamiltonianPart::getMatrix<false>() const;
 template <bool C> MatrixType<C>& HamiltonianPart::getMatrix() {
     if(C != isComplex())
         throw std::runtime_error("Stored matrix type mismatch (real/complex)");
+    if(!HMatrix)
+        throw std::runtime_error("Dense matrix is not available");
     return *std::static_pointer_cast<MatrixType<C>>(HMatrix);
 }
 template MatrixType<true>& HamiltonianPart::getMatrix<true>();
 template MatrixType<false>& HamiltonianPart::getMatrix<false>();
 
+template <bool C> RowMajorMatrixType<C> const& HamiltonianPart::getSparseMatrix() const {
+    if(C != isComplex())
+        throw std::runtime_error("Stored matrix type mismatch (real/complex)");
+    if(!isSparse())
+        throw std::runtime_error("Sparse matrix is not available");
+    return *std::static_pointer_cast<const RowMajorMatrixType<C>>(HSparseMatrix);
+}
+template RowMajorMatrixType<true> const& HamiltonianPart::getSparseMatrix<true>() const;
+template RowMajorMatrixType<false> const& HamiltonianPart::getSparseMatrix<false>() const;
+
+template <bool C> std::shared_ptr<MatrixType<C> const> HamiltonianPart::fetchMatrix() const {
+    checkComputed();
+    if(isLocal())
+        return std::shared_ptr<MatrixType<C> const>(HMatrix, &getMatrix<C>());
+
+    if(C != isComplex())
+        throw std::runtime_error("Stored matrix type mismatch (real/complex)");
+    if(!Window)
+        throw std::runtime_error("Matrix of eigenvectors is not available");
+
+    auto M = std::make_shared<MatrixType<C>>(getSize(), Eigenvalues.size());
+    MPI_Datatype dt = C ? MPI_CXX_DOUBLE_COMPLEX : MPI_DOUBLE;
+
+    // Count arguments of MPI_Get() are of type int, large matrices are transferred in chunks
+    long const MaxChunkSize = 1L << 30;
+    long const Size = M->size();
+    MPI_Win_lock(MPI_LOCK_SHARED, Owner, 0, Window->Win);
+    for(long Offset = 0; Offset < Size; Offset += MaxChunkSize) {
+        int ChunkSize = static_cast<int>(std::min(MaxChunkSize, Size - Offset));
+        MPI_Aint Displacement = Address + static_cast<MPI_Aint>(Offset * sizeof(MelemType<C>));
+        MPI_Get(M->data() + Offset, ChunkSize, dt, Owner, Displacement, ChunkSize, dt, Window->Win);
+    }
+    MPI_Win_unlock(Owner, Window->Win);
+
+    return M;
+}
+template std::shared_ptr<MatrixType<true> const> HamiltonianPart::fetchMatrix<true>() const;
+template std::shared_ptr<MatrixType<false> const> HamiltonianPart::fetchMatrix<false>() const;
+
 void HamiltonianPart::checkComputed() const {
     if(getStatus() < Computed)
         throw StatusMismatch("HamiltonianPart is not computed yet.");
@@ -134,6 +582,11 @@ InnerQuantumState HamiltonianPart::getSize() const {
     return S.getBlockSize(Block);
 }
 
+InnerQuantumState HamiltonianPart::getNumberOfEigenstates() const {
+    checkComputed();
+    return Eigenvalues.size();
+}
+
 template <bool C> VectorType<C> HamiltonianPart::getEigenState(InnerQuantumState state) const {
     checkComputed();
     return getMatrix<C>()->col(state);
@@ -155,12 +608,15 @@ bool HamiltonianPart::reduce(RealType Cutoff) {
     if(counter) {
         INFO(Eigenvalues.head(counter) << std::endl << "_________");
         Eigenvalues = Eigenvalues.head(counter);
+        // The matrix of eigenvectors may be stored by another process
+        if(!isLocal())
+            return true;
         if(isComplex()) {
             auto& HMatrix_ = getMatrix<true>();
-            HMatrix_ = HMatrix_.topLeftCorner(counter, counter);
+            HMatrix_ = HMatrix_.leftCols(counter).eval();
         } else {
             auto& HMatrix_ = getMatrix<false>();
-            HMatrix_ = HMatrix_.topLeftCorner(counter, counter);
+            HMatrix_ = HMatrix_.leftCols(counter).eval();
         }
         return true;
     } else
@@ -15,6 +15,10 @@
 
 #include "pomerol/Misc.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <numeric>
+
 namespace Pomerol {
 
 //////////////////
@@ -61,4 +65,48 @@ std::array<Permutation4, 24> const permutations4 = {
      {{2, 1, 3, 0}, 1},  {{2, 3, 0, 1}, 1},  {{2, 3, 1, 0}, -1}, {{3, 0, 1, 2}, -1}, {{3, 0, 2, 1}, 1},
      {{3, 1, 0, 2}, 1},  {{3, 1, 2, 0}, -1}, {{3, 2, 0, 1}, -1}, {{3, 2, 1, 0}, 1}}};
 
+///////////////////
+// RunJobsByCost //
+///////////////////
+void RunJobsByCost(std::vector<double> const& Costs, std::function<void(std::size_t)> const& Job, bool SerialLarge) {
+    std::vector<std::size_t> Order(Costs.size());
+    std::iota(Order.begin(), Order.end(), 0);
+    // Most expensive jobs first
+    std::stable_sort(
+        Order.begin(), Order.end(), [&Costs](std::size_t j1, std::size_t j2) { return Costs[j1] > Costs[j2]; });
+
+#ifdef POMEROL_USE_OPENMP
+    std::size_t NLarge = 0;
+    if(SerialLarge) {
+        double TotalCost = std::accumulate(Costs.begin(), Costs.end(), 0.0);
+        int NThreads = omp_get_max_threads();
+        for(; NLarge < Order.size() && Costs[Order[NLarge]] * NThreads > TotalCost; ++NLarge)
+            Job(Order[NLarge]);
+    }
+
+    // The rest of the jobs are run concurrently, one job per thread
+    Eigen::initParallel();
+    int MaxActiveLevels = omp_get_max_active_levels();
+    omp_set_max_active_levels(1);
+    std::exception_ptr Exception = nullptr;
+#pragma omp parallel for schedule(dynamic, 1)
+    for(long n = static_cast<long>(NLarge); n < static_cast<long>(Order.size()); ++n) {
+        try {
+            Job(Order[n]);
+        } catch(...) {
+#pragma omp critical
+            if(!Exception)
+                Exception = std::current_exception();
+        }
+    }
+    omp_set_max_active_levels(MaxActiveLevels);
+    if(Exception)
+        std::rethrow_exception(Exception);
+#else
+    (void)SerialLarge;
+    for(std::size_t j : Order)
+        Job(j);
+#endif
+}
+
 } // namespace Pomerol
@@ -15,7 +15,16 @@
 
 #include "pomerol/MonomialOperator.hpp"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 namespace Pomerol {
 
@@ -35,16 +44,146 @@ void MonomialOperator::compute(MPI_Comm const& comm) {
     if(getStatus() >= Computed)
         return;
 
-    std::size_t Size = parts.size();
-    for(std::size_t BlockIn = 0; BlockIn < Size; BlockIn++) {
-        INFO_NONEWLINE((int)((1.0 * BlockIn / Size) * 100) << "  " << std::flush);
-        parts[BlockIn].compute();
-    };
-    std::cout << std::endl;
+    std::vector<MonomialOperatorPart*> Parts;
+    Parts.reserve(parts.size());
+    for(auto& part : parts)
+        Parts.push_back(&part);
+    computeParts(Parts, comm);
 
     setStatus(Computed);
 }
 
+void MonomialOperator::releaseConversions() {
+    for(auto& part : parts)
+        part.releaseConversions();
+}
+
+void MonomialOperator::computeParts(std::vector<MonomialOperatorPart*> const& Parts, MPI_Comm const& comm) {
+    // Cost of the rotation of a part to the eigenbasis
+    std::vector<double> Costs;
+    Costs.reserve(Parts.size());
+    for(auto const* part : Parts) {
+        Costs.push_back(static_cast<double>(part->HFrom.getSize()) * part->HFrom.getNumberOfEigenstates() *
+                        part->HTo.getNumberOfEigenstates());
+    }
+
+#ifdef POMEROL_USE_OPENMP
+    // Parts are computed by threads of the only process, no data has to be distributed.
+    // The largest parts are computed one after another, each using all threads in the matrix-matrix products.
+    if(pMPI::size(comm) == 1) {
+        RunJobsByCost(Costs, [&Parts](std::size_t p) { Parts[p]->compute(); }, true);
+        return;
+    }
+#endif
+
+    std::vector<std::size_t> Order(Parts.size());
+    std::iota(Order.begin(), Order.end(), 0);
+    // Most expensive parts first
+    std::stable_sort(
+        Order.begin(), Order.end(), [&Costs](std::size_t p1, std::size_t p2) { return Costs[p1] > Costs[p2]; });
+
+    // The dispatcher only needs to know the order of jobs, which is encoded in their complexities
+    std::vector<int> Complexity(Parts.size());
+    for(std::size_t n = 0; n < Order.size(); ++n)
+        Complexity[Order[n]] = static_cast<int>(Order.size() - n);
+
+    pMPI::mpi_skel<pMPI::ComputeWrap<MonomialOperatorPart>> skel;
+    skel.parts.reserve(Parts.size());
+    for(std::size_t p = 0; p < Parts.size(); ++p)
+        skel.parts.emplace_back(pMPI::ComputeWrap<MonomialOperatorPart>(*Parts[p], Complexity[p]));
+    std::map<pMPI::JobId, pMPI::WorkerId> job_map = skel.run(comm, false);
+    MPI_Barrier(comm);
+
+    for(int p = 0; p < static_cast<int>(Parts.size()); ++p) {
+        if(Parts[p]->isComplex())
+            broadcastPart<true>(*Parts[p], job_map[p], comm);
+        else
+            broadcastPart<false>(*Parts[p], job_map[p], comm);
+    }
+}
+
+template <bool C> void MonomialOperator::broadcastPart(MonomialOperatorPart& part, int root, MPI_Comm const& comm) {
+    MPI_Datatype M_dt = C ? MPI_CXX_DOUBLE_COMPLEX : MPI_DOUBLE;
+    if(pMPI::rank(comm) == root) {
+        if(part.getStatus() != MonomialOperatorPart::Computed) {
+            ERROR("Worker" << root << " didn't calculate a part of a monomial operator");
+            throw std::logic_error("Worker didn't calculate this part.");
+        }
+        auto& M = part.getRowMajorValue<C>();
+        M.makeCompressed();
+        long nnz = M.nonZeros();
+        MPI_Bcast(&nnz, 1, MPI_LONG, root, comm);
+        MPI_Bcast(M.outerIndexPtr(), M.outerSize() + 1, MPI_INT, root, comm);
+        MPI_Bcast(M.innerIndexPtr(), nnz, MPI_INT, root, comm);
+        MPI_Bcast(M.valuePtr(), nnz, M_dt, root, comm);
+    } else {
+        auto M = std::make_shared<RowMajorMatrixType<C>>(part.HTo.getNumberOfEigenstates(),
+                                                         part.HFrom.getNumberOfEigenstates());
+        long nnz = 0;
+        MPI_Bcast(&nnz, 1, MPI_LONG, root, comm);
+        M->resizeNonZeros(nnz);
+        MPI_Bcast(M->outerIndexPtr(), M->outerSize() + 1, MPI_INT, root, comm);
+        MPI_Bcast(M->innerIndexPtr(), nnz, MPI_INT, root, comm);
+        MPI_Bcast(M->valuePtr(), nnz, M_dt, root, comm);
+        part.elementsRowMajor = M;
+        part.elementsColMajor.reset();
+        part.setStatus(MonomialOperatorPart::Computed);
+    }
+}
+
+void MonomialOperator::save(BinaryOutputArchive& ar) const {
+    if(getStatus() < Computed)
+        throw StatusMismatch("MonomialOperator is not computed yet.");
+
+    ar.beginSection("MONOMIAL");
+    ar.write(std::uint8_t(Complex));
+    ar.write(std::uint64_t(parts.size()));
+    for(auto const& part : parts) {
+        ar.write(std::int64_t(part.getRightIndex()));
+        ar.write(std::int64_t(part.getLeftIndex()));
+        if(Complex)
+            ar.writeSparseMatrix<true>(part.getRowMajorValue<true>());
+        else
+            ar.writeSparseMatrix<false>(part.getRowMajorValue<false>());
+    }
+}
+
+void MonomialOperator::load(BinaryInputArchive& ar) {
+    checkPrepared();
+    if(getStatus() >= Computed)
+        throw StatusMismatch("MonomialOperator is already computed.");
+
+    ar.beginSection("MONOMIAL");
+    if((ar.read<std::uint8_t>() != 0) != Complex)
+        throw std::runtime_error("MonomialOperator: Type of matrix elements in the checkpoint file does not match");
+    if(ar.read<std::uint64_t>() != std::uint64_t(parts.size()))
+        throw std::runtime_error("MonomialOperator: Number of parts in the checkpoint file does not match");
+    for(auto& part : parts) {
+        auto From = ar.read<std::int64_t>();
+        auto To = ar.read<std::int64_t>();
+        if(From != part.getRightIndex() || To != part.getLeftIndex())
+            throw std::runtime_error("MonomialOperator: Part connecting blocks " + std::to_string(From) + " and " +
+                                     std::to_string(To) + " in the checkpoint file does not match");
+        if(Complex)
+            loadPart<true>(part, ar);
+        else
+            loadPart<false>(part, ar);
+    }
+
+    setStatus(Computed);
+}
+
+template <bool C> void MonomialOperator::loadPart(MonomialOperatorPart& part, BinaryInputArchive& ar) {
+    auto M = std::make_shared<RowMajorMatrixType<C>>(ar.readSparseMatrix<C>());
+    if(InnerQuantumState(M->rows()) != part.HTo.getNumberOfEigenstates() ||
+       InnerQuantumState(M->cols()) != part.HFrom.getNumberOfEigenstates())
+        throw std::runtime_error("MonomialOperator: Wrong size of a part in the checkpoint file");
+    part.elementsRowMajor = M;
+    part.elementsColMajor.reset();
+    part.AdjointOf = nullptr;
+    part.setStatus(MonomialOperatorPart::Computed);
+}
+
 MonomialOperatorPart& MonomialOperator::getPartFromRightIndex(BlockNumber out) {
     checkPrepared();
     return parts[mapPartsFromRight.find(out)->second];
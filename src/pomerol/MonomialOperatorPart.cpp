@@ -17,41 +17,61 @@
 #include "pomerol/MonomialOperatorPart.hpp"
 
 // clang-format off
-#include <libcommute/loperator/state_vector_eigen3.hpp>
-#include <libcommute/loperator/mapped_basis_view.hpp>
+#include <libcommute/loperator/sparse_state_vector.hpp>
 // clang-format on
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace Pomerol {
 
-void MonomialOperatorPart::compute() {
+namespace {
+
+// Return the sparse matrix stored in 'Elements', or convert() it and store the result if 'Elements' is empty.
+// Parts may be accessed by multiple threads at once, so the result is published atomically.
+// Concurrent callers may convert more than once, but all of them get the same object.
+template <typename SparseMatrixType, typename Converter>
+SparseMatrixType const& get_or_convert(std::shared_ptr<void>& Elements, Converter&& convert) {
+    std::shared_ptr<void> Stored = std::atomic_load(&Elements);
+    if(!Stored) {
+        std::shared_ptr<void> Converted = std::make_shared<SparseMatrixType>(convert());
+        if(std::atomic_compare_exchange_strong(&Elements, &Stored, Converted))
+            Stored = Converted;
+    }
+    return *std::static_pointer_cast<SparseMatrixType const>(Stored);
+}
+
+} // namespace
+
+void MonomialOperatorPart::compute(Eigen::Index RotationTileSize) {
     if(getStatus() >= Computed)
         return;
 
     if(MOpComplex && HFrom.isComplex())
-        computeImpl<true, true>();
+        computeImpl<true, true>(RotationTileSize);
     else if(MOpComplex && !HFrom.isComplex())
-        computeImpl<true, false>();
+        computeImpl<true, false>(RotationTileSize);
     else if(!MOpComplex && HFrom.isComplex())
-        computeImpl<false, true>();
+        computeImpl<false, true>(RotationTileSize);
     else
-        computeImpl<false, false>();
+        computeImpl<false, false>(RotationTileSize);
 
     setStatus(Computed);
 }
 
-template <bool MOpC, bool HC> void MonomialOperatorPart::computeImpl() {
+template <bool MOpC, bool HC> void MonomialOperatorPart::computeImpl(Eigen::Index RotationTileSize) {
     constexpr bool C = MOpC || HC;
 
     BlockNumber to = HTo.getBlockNumber();
     BlockNumber from = HFrom.getBlockNumber();
 
-    std::vector<QuantumState> const& toStates = S.getFockStates(to);
     std::vector<QuantumState> const& fromStates = S.getFockStates(from);
 
     /* Rotation is done in the following way:
@@ -59,36 +79,76 @@ template <bool MOpC, bool HC> void MonomialOperatorPart::computeImpl() {
     * where the actual sum starts from k state. Big letters denote global states, smaller - InnerQuantumStates.
     * We use the fact each column of O_{lk} has only one nonzero elements.
     * */
-    MatrixType<C> OURight(toStates.size(), fromStates.size());
-
-    auto fromMapper = libcommute::basis_mapper(fromStates);
-    auto toMapper = libcommute::basis_mapper(toStates);
-
-    auto const& U = HFrom.getMatrix<HC>();
-
     auto const& MOp_ = *static_cast<LOperatorTypeRC<MOpC> const*>(MOp);
 
-    for(InnerQuantumState st = 0; st < fromStates.size(); ++st) {
-        auto fromView = fromMapper.make_const_view(U.col(st));
-        auto toView = toMapper.make_view(OURight.col(st));
-        MOp_(fromView, toView);
+    // Find the only nonzero element O_{lk} in each column k. Rows l that are never hit
+    // do not contribute to the sum and are dropped from the inner dimension of the product.
+    std::vector<std::pair<InnerQuantumState, MelemType<MOpC>>> Column(fromStates.size());
+    std::vector<InnerQuantumState> RowIndex(S.getBlockSize(to), InnerQuantumState(-1));
+    std::vector<InnerQuantumState> HitRows;
+    libcommute::sparse_state_vector<MelemType<MOpC>> bra(S.getNumberOfStates());
+    for(InnerQuantumState k = 0; k < fromStates.size(); ++k) {
+        libcommute::sparse_state_vector<MelemType<MOpC>> ket(S.getNumberOfStates());
+        ket[fromStates[k]] = 1.0;
+        MOp_(ket, bra);
+        Column[k] = std::make_pair(InnerQuantumState(-1), MelemType<MOpC>(0));
+        libcommute::foreach(bra, [&](libcommute::sv_index_type State, MelemType<MOpC> const& Value) {
+            if(Value == MelemType<MOpC>(0))
+                return;
+            InnerQuantumState l = S.getInnerState(State);
+            Column[k] = std::make_pair(l, Value);
+            if(RowIndex[l] == InnerQuantumState(-1)) {
+                RowIndex[l] = HitRows.size();
+                HitRows.push_back(l);
+            }
+        });
     }
 
-    auto const& ULeft = HTo.getMatrix<HC>().adjoint();
+    // Eigenvectors of blocks stored by other processes are fetched on demand
+    auto UPtr = HFrom.fetchMatrix<HC>();
+    auto const& U = *UPtr;
+    auto ULeftPtr = HTo.fetchMatrix<HC>();
+    auto const& ULeft = *ULeftPtr;
+
+    // U may have fewer columns than rows if only some of the eigenstates have been computed
+    auto Elements = std::make_shared<RowMajorMatrixType<C>>(ULeft.cols(), U.cols());
+
+    if(!HitRows.empty()) {
+        // OURight_{lm} = \sum_k O_{lk} U_{km} restricted to the hit rows l,
+        // and the matching rows of ULeft.
+        MatrixType<C> OURight = MatrixType<C>::Zero(HitRows.size(), U.cols());
+        for(InnerQuantumState k = 0; k < fromStates.size(); ++k) {
+            if(Column[k].first == InnerQuantumState(-1))
+                continue;
+            OURight.row(RowIndex[Column[k].first]) += Column[k].second * U.row(k);
+        }
+        MatrixType<C> ULeftHit(HitRows.size(), ULeft.cols());
+        for(InnerQuantumState l = 0; l < HitRows.size(); ++l)
+            ULeftHit.row(l) = ULeft.row(HitRows[l]);
+
+        // The product is computed in tiles of rows, each of which is thresholded into the
+        // row-major sparse storage right away. This way the full dense product is never formed.
+        // The elements are filtered by the same criterion as in DenseBase::sparseView(MatrixElementTolerance).
+        RealType const Threshold = MatrixElementTolerance * Eigen::NumTraits<MelemType<C>>::dummy_precision();
+        Eigen::Index TileRows = std::max(Eigen::Index(1), RotationTileSize / std::max(Eigen::Index(1), U.cols()));
+        MatrixType<C> Tile;
+        for(Eigen::Index Row0 = 0; Row0 < ULeft.cols(); Row0 += TileRows) {
+            Eigen::Index NRows = std::min(TileRows, ULeft.cols() - Row0);
+            Tile.noalias() = ULeftHit.middleCols(Row0, NRows).adjoint() * OURight;
+            for(Eigen::Index n = 0; n < NRows; ++n) {
+                Elements->startVec(Row0 + n);
+                for(Eigen::Index m = 0; m < Tile.cols(); ++m) {
+                    if(std::abs(Tile(n, m)) > Threshold)
+                        Elements->insertBack(Row0 + n, m) = Tile(n, m);
+                }
+            }
+        }
+    }
+    Elements->finalize();
 
-// Workaround for Eigen issue 1224
-// https://gitlab.com/libeigen/eigen/-/issues/1224
-//
-// Affected versions are some betas of 3.3 but not the 3.3 release
-#if EIGEN_VERSION_AT_LEAST(3, 2, 90) && EIGEN_MAJOR_VERSION < 3
-    elementsRowMajor =
-        std::make_shared<RowMajorMatrixType<C>>(MatrixType<C>(ULeft * OURight).sparseView(MatrixElementTolerance));
-#else
-    elementsRowMajor = std::make_shared<RowMajorMatrixType<C>>((ULeft * OURight).sparseView(MatrixElementTolerance));
-#endif
-
-    elementsColMajor = std::make_shared<ColMajorMatrixType<C>>(
-        *std::static_pointer_cast<RowMajorMatrixType<C> const>(elementsRowMajor));
+    elementsRowMajor = Elements;
+    // The column-major copy is built on first request
+    elementsColMajor.reset();
 }
 
 void MonomialOperatorPart::setFromAdjoint(MonomialOperatorPart const& part) {
@@ -99,29 +159,41 @@ void MonomialOperatorPart::setFromAdjoint(MonomialOperatorPart const& part) {
     if(getStatus() >= Computed)
         return;
 
-    if(isComplex()) {
-        elementsRowMajor = std::make_shared<RowMajorMatrixType<true>>(part.getColMajorValue<true>().adjoint());
-        elementsColMajor = std::make_shared<ColMajorMatrixType<true>>(part.getRowMajorValue<true>().adjoint());
-    } else {
-        elementsRowMajor = std::make_shared<RowMajorMatrixType<false>>(part.getColMajorValue<false>().adjoint());
-        elementsColMajor = std::make_shared<ColMajorMatrixType<false>>(part.getRowMajorValue<false>().adjoint());
-    }
+    // No matrices are stored, they are obtained from the matrix of 'part' on request
+    AdjointOf = &part;
+    elementsRowMajor.reset();
+    elementsColMajor.reset();
 
     setStatus(Computed);
 }
 
-template <bool C> ColMajorMatrixType<C>& MonomialOperatorPart::getColMajorValue() {
-    if(C != isComplex())
-        throw std::runtime_error("Stored matrix type mismatch (real/complex)");
-    return *std::static_pointer_cast<ColMajorMatrixType<C>>(elementsColMajor);
+void MonomialOperatorPart::releaseConversions() {
+    elementsColMajor.reset();
+    if(AdjointOf)
+        elementsRowMajor.reset();
+}
+
+std::size_t MonomialOperatorPart::getNumberOfNonZeros() const {
+    if(getStatus() < Computed)
+        throw StatusMismatch("MonomialOperatorPart is not computed yet.");
+    if(AdjointOf)
+        return AdjointOf->getNumberOfNonZeros();
+    if(isComplex())
+        return std::static_pointer_cast<RowMajorMatrixType<true> const>(elementsRowMajor)->nonZeros();
+    else
+        return std::static_pointer_cast<RowMajorMatrixType<false> const>(elementsRowMajor)->nonZeros();
 }
-template ColMajorMatrixType<true>& MonomialOperatorPart::getColMajorValue<true>();
-template ColMajorMatrixType<false>& MonomialOperatorPart::getColMajorValue<false>();
 
 template <bool C> ColMajorMatrixType<C> const& MonomialOperatorPart::getColMajorValue() const {
     if(C != isComplex())
         throw std::runtime_error("Stored matrix type mismatch (real/complex)");
-    return *std::static_pointer_cast<ColMajorMatrixType<C> const>(elementsColMajor);
+    return get_or_convert<ColMajorMatrixType<C>>(elementsColMajor, [this]() -> ColMajorMatrixType<C> {
+        // Taking the adjoint of a row-major matrix requires no reordering of its elements
+        if(AdjointOf)
+            return AdjointOf->getRowMajorValue<C>().adjoint();
+        else
+            return getRowMajorValue<C>();
+    });
 }
 template ColMajorMatrixType<true> const& MonomialOperatorPart::getColMajorValue<true>() const;
 template ColMajorMatrixType<false> const& MonomialOperatorPart::getColMajorValue<false>() const;
@@ -129,6 +201,10 @@ template ColMajorMatrixType<false> const& MonomialOperatorPart::getColMajorValue
 template <bool C> RowMajorMatrixType<C>& MonomialOperatorPart::getRowMajorValue() {
     if(C != isComplex())
         throw std::runtime_error("Stored matrix type mismatch (real/complex)");
+    if(AdjointOf)
+        throw std::runtime_error("MonomialOperatorPart: Matrix of a Hermitian conjugate part cannot be modified");
+    // The column-major copy would not reflect changes made to the matrix
+    elementsColMajor.reset();
     return *std::static_pointer_cast<RowMajorMatrixType<C>>(elementsRowMajor);
 }
 template RowMajorMatrixType<true>& MonomialOperatorPart::getRowMajorValue<true>();
@@ -137,7 +213,11 @@ template RowMajorMatrixType<false>& MonomialOperatorPart::getRowMajorValue<false
 template <bool C> RowMajorMatrixType<C> const& MonomialOperatorPart::getRowMajorValue() const {
     if(C != isComplex())
         throw std::runtime_error("Stored matrix type mismatch (real/complex)");
-    return *std::static_pointer_cast<const RowMajorMatrixType<C>>(elementsRowMajor);
+    if(!AdjointOf)
+        return *std::static_pointer_cast<const RowMajorMatrixType<C>>(elementsRowMajor);
+    return get_or_convert<RowMajorMatrixType<C>>(elementsRowMajor, [this]() -> RowMajorMatrixType<C> {
+        return AdjointOf->getRowMajorValue<C>().adjoint();
+    });
 }
 template RowMajorMatrixType<true> const& MonomialOperatorPart::getRowMajorValue<true>() const;
 template RowMajorMatrixType<false> const& MonomialOperatorPart::getRowMajorValue<false>() const;
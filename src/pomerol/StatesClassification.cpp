@@ -16,6 +16,7 @@
 #include "pomerol/StatesClassification.hpp"
 
 #include <algorithm>
+#include <cstdint>
 #include <iterator>
 #include <numeric>
 #include <stdexcept>
@@ -43,6 +44,38 @@ void StatesClassification::initMultipleBlocks(libcommute::space_partition const&
         ;
 }
 
+void StatesClassification::save(BinaryOutputArchive& ar) const {
+    checkComputed();
+    ar.beginSection("STATES");
+    ar.write(std::uint64_t(StateBlockIndex.size()));
+    ar.write(std::uint64_t(StatesContainer.size()));
+    for(auto const& States : StatesContainer)
+        ar.writeArray(States.data(), States.size());
+}
+
+void StatesClassification::load(BinaryInputArchive& ar) {
+    if(getStatus() == Computed)
+        throw StatusMismatch("StatesClassification is already computed.");
+    ar.beginSection("STATES");
+    auto NStates = ar.read<std::uint64_t>();
+    auto NBlocks = ar.read<std::uint64_t>();
+
+    StatesContainer.resize(NBlocks);
+    StateBlockIndex.assign(NStates, INVALID_BLOCK_NUMBER);
+    for(BlockNumber Block = 0; Block < BlockNumber(NBlocks); ++Block) {
+        StatesContainer[Block] = ar.readVector<QuantumState>();
+        for(QuantumState State : StatesContainer[Block]) {
+            if(State >= NStates || StateBlockIndex[State] != INVALID_BLOCK_NUMBER)
+                throw std::runtime_error("StatesClassification: Invalid Fock state list in a checkpoint file");
+            StateBlockIndex[State] = Block;
+        }
+    }
+    if(std::count(StateBlockIndex.begin(), StateBlockIndex.end(), INVALID_BLOCK_NUMBER) != 0)
+        throw std::runtime_error("StatesClassification: Invalid Fock state list in a checkpoint file");
+
+    setStatus(Computed);
+}
+
 void StatesClassification::checkComputed() const {
     if(getStatus() < Computed) {
         throw StatusMismatch("StatesClassification is not computed yet.");
@@ -16,6 +16,9 @@
 
 #include "pomerol/Susceptibility.hpp"
 
+#include <cmath>
+#include <cstddef>
+
 namespace Pomerol {
 
 Susceptibility::Susceptibility(StatesClassification const& S,
@@ -23,7 +26,7 @@ Susceptibility::Susceptibility(StatesClassification const& S,
                                MonomialOperator const& A,
                                MonomialOperator const& B,
                                DensityMatrix const& DM)
-    : Thermal(DM.beta), ComputableObject(), S(S), H(H), A(A), B(B), DM(DM) {}
+    : Thermal(DM.beta), ComputableObject(), S(S), H(H), A(A), B(B), DM(DM), Products(std::make_shared<ProductsMap>()) {}
 
 Susceptibility::Susceptibility(Susceptibility const& Chi)
     : Thermal(Chi.beta),
@@ -35,9 +38,22 @@ Susceptibility::Susceptibility(Susceptibility const& Chi)
       DM(Chi.DM),
       Vanishing(Chi.Vanishing),
       parts(Chi.parts),
+      Products(Chi.Products),
       SubtractDisconnected(Chi.SubtractDisconnected),
       ave_A(Chi.ave_A),
-      ave_B(Chi.ave_B) {}
+      ave_B(Chi.ave_B),
+      KeepMatrixElementProducts(Chi.KeepMatrixElementProducts) {}
+
+Susceptibility::Susceptibility(Susceptibility const& Chi, DensityMatrix const& DM)
+    : Thermal(DM.beta),
+      ComputableObject(),
+      S(Chi.S),
+      H(Chi.H),
+      A(Chi.A),
+      B(Chi.B),
+      DM(DM),
+      Products(Chi.Products),
+      KeepMatrixElementProducts(Chi.KeepMatrixElementProducts) {}
 
 void Susceptibility::prepare() {
     if(getStatus() >= Prepared)
@@ -60,13 +76,16 @@ void Susceptibility::prepare() {
         // Select a relevant 'world stripe' (sequence of blocks).
         if(Aleft == Bright && Aright == Bleft) {
             // check if retained blocks are included. If not, do not push.
-            if(DM.isRetained(Aleft) || DM.isRetained(Aright))
+            if(DM.isRetained(Aleft) || DM.isRetained(Aright)) {
+                auto PartProducts = Products->find(Aleft);
                 parts.emplace_back((MonomialOperatorPart&)A.getPartFromLeftIndex(Aleft),
                                    (MonomialOperatorPart&)B.getPartFromRightIndex(Bright),
                                    H.getPart(Aright),
                                    H.getPart(Aleft),
                                    DM.getPart(Aright),
-                                   DM.getPart(Aleft));
+                                   DM.getPart(Aleft),
+                                   PartProducts == Products->end() ? nullptr : PartProducts->second);
+            }
         }
 
         unsigned long AleftInt = Aleft;
@@ -91,8 +110,12 @@ void Susceptibility::compute() {
         prepare();
 
     if(getStatus() < Computed) {
-        for(auto& p : parts)
+        for(auto& p : parts) {
+            p.KeepProducts = KeepMatrixElementProducts;
             p.compute();
+            if(KeepMatrixElementProducts)
+                (*Products)[p.getOuterBlock()] = p.getMatrixElementProducts();
+        }
     }
     setStatus(Computed);
 }
@@ -109,6 +132,25 @@ void Susceptibility::subtractDisconnected(ComplexType ave_A, ComplexType ave_B)
     this->ave_B = ave_B;
 }
 
+std::vector<ComplexType> Susceptibility::evaluate(std::vector<ComplexType> const& z) const {
+    std::vector<ComplexType> out(z.size(), 0);
+    if(!Vanishing) {
+        for(auto const& p : parts)
+            p.evaluate(z, out);
+    }
+    if(SubtractDisconnected) {
+        for(std::size_t w = 0; w < z.size(); ++w) {
+            if(std::abs(z[w]) < 1e-15)
+                out[w] -= ave_A * ave_B * beta; // only for n=0
+        }
+    }
+    return out;
+}
+
+std::vector<ComplexType> Susceptibility::evaluate(std::vector<long> const& MatsubaraNumbers) const {
+    return evaluate(bosonicMatsubaraGrid(MatsubaraNumbers));
+}
+
 void Susceptibility::subtractDisconnected(EnsembleAverage& EA_A, EnsembleAverage& EA_B) {
     EA_A.compute();
     EA_B.compute();
@@ -18,6 +18,7 @@
 
 #include <cassert>
 #include <cmath>
+#include <utility>
 
 namespace Pomerol {
 
@@ -45,7 +46,8 @@ SusceptibilityPart::SusceptibilityPart(MonomialOperatorPart const& A,
                                        HamiltonianPart const& HpartInner,
                                        HamiltonianPart const& HpartOuter,
                                        DensityMatrixPart const& DMpartInner,
-                                       DensityMatrixPart const& DMpartOuter)
+                                       DensityMatrixPart const& DMpartOuter,
+                                       std::shared_ptr<MatrixElementProducts const> Products)
     : Thermal(DMpartInner.beta),
       HpartInner(HpartInner),
       HpartOuter(HpartOuter),
@@ -53,24 +55,46 @@ SusceptibilityPart::SusceptibilityPart(MonomialOperatorPart const& A,
       DMpartOuter(DMpartOuter),
       A(A),
       B(B),
-      Terms(Term::Compare(), Term::IsNegligible()) {}
+      Terms(Term::Compare(), Term::IsNegligible()),
+      Products(std::move(Products)) {}
 
 void SusceptibilityPart::compute() {
-    if(A.isComplex()) {
-        if(B.isComplex())
-            computeImpl<true, true>();
+    if(!Products) {
+        if(A.isComplex())
+            Products = B.isComplex() ? computeProducts<true, true>() : computeProducts<true, false>();
         else
-            computeImpl<true, false>();
-    } else {
-        if(B.isComplex())
-            computeImpl<false, true>();
-        else
-            computeImpl<false, false>();
+            Products = B.isComplex() ? computeProducts<false, true>() : computeProducts<false, false>();
     }
-}
 
-template <bool AComplex, bool BComplex> void SusceptibilityPart::computeImpl() {
+    // Combine the products with the statistical weights
     Terms.clear();
+    ZeroPoleWeight = 0;
+    for(auto const& P : *Products) {
+        RealType Pole = HpartInner.getEigenValue(P.Inner) - HpartOuter.getEigenValue(P.Outer);
+        if(std::abs(Pole) < ReduceResonanceTolerance) {
+            // BOSON: pole at zero energy
+            ZeroPoleWeight += P.Value * DMpartOuter.getWeight(P.Outer);
+        } else {
+            // BOSON: minus sign before the second term
+            ComplexType Residue = P.Value * (DMpartOuter.getWeight(P.Outer) - DMpartInner.getWeight(P.Inner));
+            if(std::abs(Residue) > MatrixElementTolerance) // Is the residue relevant?
+            {
+                // Create a new term and append it to the list.
+                Terms.add_term(Term(Residue, Pole));
+            }
+        }
+    }
+
+    Terms.flush();
+    assert(Terms.check_terms());
+
+    if(!KeepProducts)
+        Products.reset();
+}
+
+template <bool AComplex, bool BComplex>
+std::shared_ptr<SusceptibilityPart::MatrixElementProducts const> SusceptibilityPart::computeProducts() const {
+    auto List = std::make_shared<MatrixElementProducts>();
 
     // Blocks (submatrices) of A and B
     RowMajorMatrixType<AComplex> const& Amatrix = A.getRowMajorValue<AComplex>();
@@ -91,20 +115,13 @@ template <bool AComplex, bool BComplex> void SusceptibilityPart::computeImpl() {
 
             // A meaningful matrix element
             if(A_index2 == B_index2) {
+                ComplexType Value = Ainner.value() * Binner.value();
                 RealType Pole = HpartInner.getEigenValue(A_index2) - HpartOuter.getEigenValue(index1);
-                if(std::abs(Pole) < ReduceResonanceTolerance) {
-                    // BOSON: pole at zero energy
-                    ZeroPoleWeight += Ainner.value() * Binner.value() * DMpartOuter.getWeight(index1);
-                } else {
-                    // BOSON: minus sign before the second term
-                    ComplexType Residue = Ainner.value() * Binner.value() *
-                                          (DMpartOuter.getWeight(index1) - DMpartInner.getWeight(A_index2));
-                    if(std::abs(Residue) > MatrixElementTolerance) // Is the residue relevant?
-                    {
-                        // Create a new term and append it to the list.
-                        Terms.add_term(Term(Residue, Pole));
-                    }
-                }
+                // Contributions to the zero-energy pole are not subject to the tolerance check.
+                // Otherwise, the difference of two statistical weights never exceeds 1 in magnitude,
+                // so smaller products cannot result in a relevant residue at any temperature.
+                if(std::abs(Pole) < ReduceResonanceTolerance || std::abs(Value) > MatrixElementTolerance)
+                    List->push_back({Value, A_index2, index1});
                 ++Ainner; // The next non-zero element
                 ++Binner; // The next non-zero element
             } else {
@@ -119,7 +136,28 @@ template <bool AComplex, bool BComplex> void SusceptibilityPart::computeImpl() {
         }
     }
 
-    assert(Terms.check_terms());
+    return List;
+}
+
+void SusceptibilityPart::evaluate(std::vector<ComplexType> const& z, std::vector<ComplexType>& out) const {
+    assert(out.size() == z.size());
+    std::size_t size = z.size();
+    for(auto const& t : Terms.as_vector()) {
+        RealType const RRe = t.Residue.real(), RIm = t.Residue.imag();
+        // -R / (z - P) = -R * conj(z - P) / |z - P|^2
+        for(std::size_t w = 0; w < size; ++w) {
+            RealType const dRe = z[w].real() - t.Pole, dIm = z[w].imag();
+            RealType const invNorm = 1.0 / (dRe * dRe + dIm * dIm);
+            out[w] -= ComplexType((RRe * dRe + RIm * dIm) * invNorm, (RIm * dRe - RRe * dIm) * invNorm);
+        }
+    }
+    // BOSON: add contribution of zero-energy pole
+    if(ZeroPoleWeight != ComplexType(0)) {
+        for(std::size_t w = 0; w < size; ++w) {
+            if(std::abs(z[w]) < 1e-15)
+                out[w] += ZeroPoleWeight * beta;
+        }
+    }
 }
 
 } // namespace Pomerol
@@ -17,10 +17,16 @@
 
 #include "mpi_dispatcher/mpi_skel.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <numeric>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace Pomerol {
 
@@ -128,29 +134,31 @@ struct ComputeAndClearWrap {
                         TwoParticleGFPart& p,
                         bool clear,
                         bool fill,
-                        int complexity = 1)
-        : complexity(complexity), freqs_(freqs), data_(data), p(p), clear_(clear), fill_(fill) {}
+                        std::size_t batch_size,
+                        double complexity = 1)
+        : complexity(complexity),
+          freqs_(freqs),
+          data_(data),
+          p(p),
+          clear_(clear),
+          fill_(fill),
+          batch_size_(batch_size) {}
 
     void run() {
-        p.compute();
-        if(fill_) {
-            std::size_t wsize = freqs_.size();
-#ifdef POMEROL_USE_OPENMP
-#pragma omp parallel for
-#endif
-            for(int w = 0; w < wsize; ++w) {
-                data_[w] += p(std::get<0>(freqs_[w]), std::get<1>(freqs_[w]), std::get<2>(freqs_[w]));
-            }
-#ifdef POMEROL_USE_OPENMP
-#pragma omp barrier
-#endif
+        // Only the values are needed, so the terms do not have to be stored all at once
+        if(clear_ && fill_ && batch_size_ > 0) {
+            p.computeStreaming(FreqArrays(freqs_, p.getPermutation()), data_, batch_size_);
+            return;
         }
+        p.compute();
+        if(fill_)
+            p.evaluate(freqs_, data_);
         if(clear_)
             p.clear();
     }
 
     // NOLINTNEXTLINE(cppcoreguidelines-non-private-member-variables-in-classes)
-    int const complexity;
+    double const complexity;
 
 private:
     FreqVec const& freqs_;
@@ -158,6 +166,7 @@ private:
     TwoParticleGFPart& p;
     bool clear_;
     bool fill_;
+    std::size_t batch_size_;
 };
 
 std::vector<ComplexType> TwoParticleGF::compute(bool clear, FreqVec const& freqs, MPI_Comm const& comm) {
@@ -169,42 +178,298 @@ std::vector<ComplexType> TwoParticleGF::compute(bool clear, FreqVec const& freqs
         return m_data;
 
     if(!Vanishing) {
+        bool distributed_output = DistributedOutput && !freqs.empty();
+        // In the distributed output mode, kept parts are evaluated chunk by chunk after all of them have
+        // been computed. Parts that are not kept are evaluated and cleared as soon as they are computed.
+        bool fill_container = !freqs.empty() && (!distributed_output || clear);
+
         // Create a "skeleton" class with pointers to part that can call a compute method
         pMPI::mpi_skel<ComputeAndClearWrap> skel;
-        bool fill_container = !freqs.empty();
         skel.parts.reserve(parts.size());
-        m_data.resize(freqs.size(), 0.0);
+        if(fill_container)
+            m_data.resize(freqs.size(), 0.0);
         for(auto& part : parts) {
-            skel.parts.emplace_back(freqs, m_data, part, clear, fill_container, 1);
+            skel.parts.emplace_back(freqs,
+                                    m_data,
+                                    part,
+                                    clear,
+                                    fill_container,
+                                    StreamingBatchSize,
+                                    part.estimateCost());
         }
         std::map<pMPI::JobId, pMPI::WorkerId> job_map = skel.run(comm, true); // actual running - very costly
 
         // Start distributing data
         MPI_Barrier(comm);
 
-        MPI_Allreduce(MPI_IN_PLACE,
-                      m_data.data(),
-                      static_cast<int>(m_data.size()),
-                      MPI_CXX_DOUBLE_COMPLEX,
-                      MPI_SUM,
-                      comm);
+        if(distributed_output) {
+            std::vector<ComplexType> LocalValues;
+            LocalValues.swap(m_data);
+            m_data = reduceDistributed(freqs, job_map, LocalValues, comm);
+        } else {
+            MPI_Allreduce(MPI_IN_PLACE,
+                          m_data.data(),
+                          static_cast<int>(m_data.size()),
+                          MPI_CXX_DOUBLE_COMPLEX,
+                          MPI_SUM,
+                          comm);
+        }
 
         // Optionally distribute terms to other processes
         if(!clear) {
-            for(int p = 0; p < static_cast<int>(parts.size()); ++p) {
-                parts[p].NonResonantTerms.broadcast(comm, job_map[p]);
-                parts[p].ResonantTerms.broadcast(comm, job_map[p]);
-                parts[p].setStatus(TwoParticleGFPart::Computed);
-            }
-            MPI_Barrier(comm);
+            std::vector<int> PartOwners(parts.size());
+            for(auto const& job : job_map)
+                PartOwners[job.first] = job.second;
+            shareTerms(PartOwners, comm);
         }
     }
 
     setStatus(Computed);
 
+    if(CompactTerms && !clear)
+        compactTerms();
+
     return m_data;
 }
 
+namespace {
+
+// Gather terms of the parts owned by different processes and unpack them into the term lists of the parts
+template <typename TermType>
+void share_term_lists(std::vector<FlatTermList<TermType>*> const& Lists,
+                      std::vector<int> const& PartOwners,
+                      MPI_Comm const& comm) {
+    int comm_rank = pMPI::rank(comm);
+    int comm_size = pMPI::size(comm);
+
+    // Numbers of terms in all parts
+    std::vector<long> NTerms(Lists.size(), 0);
+    for(std::size_t p = 0; p < Lists.size(); ++p) {
+        if(PartOwners[p] == comm_rank)
+            NTerms[p] = static_cast<long>(Lists[p]->size());
+    }
+    MPI_Allreduce(MPI_IN_PLACE, NTerms.data(), static_cast<int>(NTerms.size()), MPI_LONG, MPI_SUM, comm);
+
+    // The buffer contains terms of the parts sorted by owner, then by position in the list of parts
+    std::vector<std::size_t> Order(Lists.size());
+    std::iota(Order.begin(), Order.end(), 0);
+    std::stable_sort(Order.begin(), Order.end(), [&PartOwners](std::size_t p1, std::size_t p2) {
+        return PartOwners[p1] < PartOwners[p2];
+    });
+
+    std::vector<int> RecvCounts(comm_size, 0), Displs(comm_size, 0);
+    for(std::size_t p = 0; p < Lists.size(); ++p)
+        RecvCounts[PartOwners[p]] += static_cast<int>(NTerms[p]);
+    std::partial_sum(RecvCounts.begin(), RecvCounts.end() - 1, Displs.begin() + 1);
+
+    std::vector<TermType> SendBuffer;
+    SendBuffer.reserve(RecvCounts[comm_rank]);
+    for(std::size_t p : Order) {
+        if(PartOwners[p] == comm_rank) {
+            auto const& terms = Lists[p]->as_vector();
+            SendBuffer.insert(SendBuffer.end(), terms.begin(), terms.end());
+        }
+    }
+
+    std::vector<TermType> RecvBuffer(Displs.back() + RecvCounts.back());
+    MPI_Allgatherv(SendBuffer.data(),
+                   static_cast<int>(SendBuffer.size()),
+                   TermType::mpi_datatype(),
+                   RecvBuffer.data(),
+                   RecvCounts.data(),
+                   Displs.data(),
+                   TermType::mpi_datatype(),
+                   comm);
+    std::vector<TermType>().swap(SendBuffer);
+
+    auto it = RecvBuffer.cbegin();
+    for(std::size_t p : Order) {
+        if(PartOwners[p] != comm_rank)
+            Lists[p]->assign_sorted(it, it + NTerms[p]);
+        it += NTerms[p];
+    }
+}
+
+} // namespace
+
+void TwoParticleGF::shareTerms(std::vector<int> const& PartOwners, MPI_Comm const& comm) {
+    std::vector<FlatTermList<TwoParticleGFPart::NonResonantTerm>*> NonResonantLists;
+    std::vector<FlatTermList<TwoParticleGFPart::ResonantTerm>*> ResonantLists;
+    NonResonantLists.reserve(parts.size());
+    ResonantLists.reserve(parts.size());
+    for(auto& part : parts) {
+        NonResonantLists.push_back(&part.NonResonantTerms);
+        ResonantLists.push_back(&part.ResonantTerms);
+    }
+
+    share_term_lists(NonResonantLists, PartOwners, comm);
+    share_term_lists(ResonantLists, PartOwners, comm);
+
+    // The terms are final now, store them in the form used by evaluate()
+    for(auto& part : parts) {
+        part.setStatus(TwoParticleGFPart::Computed);
+        part.freeze();
+    }
+}
+
+void TwoParticleGF::compactTerms() {
+    if(getStatus() < Computed)
+        throw StatusMismatch("TwoParticleGF is not computed yet.");
+
+    for(auto& part : parts) {
+        if(part.getStatus() == TwoParticleGFPart::Computed) {
+            part.SinglePrecisionPoles = SinglePrecisionPoles;
+            part.compact();
+        }
+    }
+}
+
+RealType TwoParticleGF::getPoleError() const {
+    return std::accumulate(parts.begin(), parts.end(), RealType(0), [](RealType e, TwoParticleGFPart const& p) {
+        return std::max(e, p.getPoleError());
+    });
+}
+
+double TwoParticleGF::estimateCost() const {
+    if(getStatus() < Prepared)
+        throw StatusMismatch("TwoParticleGF is not prepared yet.");
+
+    return std::accumulate(parts.begin(), parts.end(), 0.0, [](double s, TwoParticleGFPart const& p) {
+        return s + p.estimateCost();
+    });
+}
+
+std::pair<std::size_t, std::size_t> TwoParticleGF::getOutputSlice(std::size_t NFreqs, int Rank, int Size) {
+    return std::make_pair(NFreqs * Rank / Size, NFreqs * (Rank + 1) / Size);
+}
+
+constexpr std::size_t TwoParticleGF::OutputChunkSize;
+
+std::vector<ComplexType> TwoParticleGF::reduceDistributed(FreqVec const& freqs,
+                                                          std::map<pMPI::JobId, pMPI::WorkerId> const& job_map,
+                                                          std::vector<ComplexType> const& LocalValues,
+                                                          MPI_Comm const& comm) const {
+    int comm_rank = pMPI::rank(comm);
+    int comm_size = pMPI::size(comm);
+
+    auto slice = getOutputSlice(freqs.size(), comm_rank, comm_size);
+    std::vector<ComplexType> out(slice.second - slice.first, 0);
+
+    std::vector<TwoParticleGFPart const*> LocalParts;
+    for(auto const& job : job_map) {
+        if(job.second == comm_rank)
+            LocalParts.push_back(&parts[job.first]);
+    }
+
+    // Two buffers: one is being reduced while the other one is being filled
+    std::array<std::vector<ComplexType>, 2> Buffers;
+    std::array<MPI_Request, 2> Requests = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    std::size_t chunk = 0;
+    for(int owner = 0; owner < comm_size; ++owner) {
+        auto owner_slice = getOutputSlice(freqs.size(), owner, comm_size);
+        for(std::size_t begin = owner_slice.first; begin < owner_slice.second; begin += OutputChunkSize, ++chunk) {
+            std::size_t end = std::min(begin + OutputChunkSize, owner_slice.second);
+
+            auto& Buffer = Buffers[chunk % 2];
+            auto& Request = Requests[chunk % 2];
+            MPI_Wait(&Request, MPI_STATUS_IGNORE);
+            Buffer.assign(end - begin, 0);
+
+            if(!LocalValues.empty()) {
+                std::copy(LocalValues.begin() + begin, LocalValues.begin() + end, Buffer.begin());
+            } else if(!LocalParts.empty()) {
+                FreqVec ChunkFreqs(freqs.begin() + begin, freqs.begin() + end);
+                // Parts sharing the same permutation of operators also share the permuted frequencies
+                for(auto const& perm : permutations3) {
+                    std::unique_ptr<FreqArrays> z;
+                    for(auto const* part : LocalParts) {
+                        if(part->getPermutation() != perm)
+                            continue;
+                        if(!z)
+                            z.reset(new FreqArrays(ChunkFreqs, perm));
+                        part->evaluate(*z, Buffer);
+                    }
+                }
+            }
+
+            ComplexType* Result = owner == comm_rank ? out.data() + (begin - owner_slice.first) : nullptr;
+            MPI_Ireduce(Buffer.data(),
+                        Result,
+                        static_cast<int>(end - begin),
+                        MPI_CXX_DOUBLE_COMPLEX,
+                        MPI_SUM,
+                        owner,
+                        comm,
+                        &Request);
+        }
+    }
+    MPI_Waitall(2, Requests.data(), MPI_STATUSES_IGNORE);
+
+    return out;
+}
+
+std::vector<ComplexType> TwoParticleGF::evaluate(FreqVec const& freqs) const {
+    std::vector<ComplexType> out(freqs.size(), 0);
+    if(Vanishing)
+        return out;
+    if(getStatus() < Computed)
+        throw StatusMismatch("TwoParticleGF: Terms have not been computed or are kept by another process.");
+
+    // Parts sharing the same permutation of operators also share the permuted frequencies
+    for(auto const& perm : permutations3) {
+        std::unique_ptr<FreqArrays> z;
+        for(auto const& part : parts) {
+            if(part.getPermutation() != perm)
+                continue;
+            if(!z)
+                z.reset(new FreqArrays(freqs, perm));
+            part.evaluate(*z, out);
+        }
+    }
+    return out;
+}
+
+void TwoParticleGF::saveTerms(BinaryOutputArchive& ar) const {
+    writeTerms(ar, {std::make_pair(IndexCombination4(getIndex(0), getIndex(1), getIndex(2), getIndex(3)), 0)});
+}
+
+void TwoParticleGF::writeTerms(BinaryOutputArchive& ar,
+                               std::vector<std::pair<IndexCombination4, std::size_t>> const& Aliases) const {
+    if(getStatus() < Computed)
+        throw StatusMismatch("TwoParticleGF is not computed yet.");
+    for(auto const& part : parts) {
+        if(part.getStatus() < TwoParticleGFPart::Computed)
+            throw StatusMismatch("TwoParticleGF: Terms have been cleared or are kept by another process.");
+    }
+
+    ar.beginSection("2PGF");
+    ar.write(beta);
+    std::vector<std::uint64_t> AliasArray;
+    AliasArray.reserve(5 * Aliases.size());
+    for(auto const& Alias : Aliases) {
+        IndexCombination4 const& Indices = Alias.first;
+        AliasArray.insert(AliasArray.end(), {Indices.Index1, Indices.Index2, Indices.Index3, Indices.Index4});
+        AliasArray.push_back(Alias.second);
+    }
+    ar.writeArray(AliasArray.data(), AliasArray.size());
+
+    ar.write(std::uint64_t(Vanishing ? 0 : parts.size()));
+    if(Vanishing)
+        return;
+    for(auto const& part : parts) {
+        ar.write(std::uint64_t(std::find(permutations3.begin(), permutations3.end(), part.getPermutation()) -
+                               permutations3.begin()));
+        ar.write(part.ReduceResonanceTolerance);
+        if(part.Frozen) {
+            part.FrozenNonResonant.save(ar);
+            part.FrozenResonant.save(ar);
+        } else {
+            FrozenNonResonantTerms::save(ar, part.NonResonantTerms.as_vector());
+            FrozenResonantTerms::save(ar, part.ResonantTerms.as_vector());
+        }
+    }
+}
+
 ParticleIndex TwoParticleGF::getIndex(std::size_t Position) const {
     switch(Position) {
     case 0: return C1.getIndex();
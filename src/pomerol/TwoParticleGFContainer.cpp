@@ -15,13 +15,40 @@
 
 #include "pomerol/TwoParticleGFContainer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
 
 namespace Pomerol {
 
 void TwoParticleGFContainer::prepareAll(std::set<IndexCombination4> const& InitialIndices) {
-    fill(InitialIndices);
+    std::set<ParticleIndex> OperatorIndices = Operators.getIndices();
+    auto HasOperators = [&OperatorIndices](IndexCombination4 const& ic) {
+        return OperatorIndices.count(ic.Index1) && OperatorIndices.count(ic.Index2) &&
+               OperatorIndices.count(ic.Index3) && OperatorIndices.count(ic.Index4);
+    };
+
+    // Skip identically vanishing elements. Combinations without stored operators are
+    // passed through, so that the element creation reports them.
+    std::set<IndexCombination4> NonVanishing = findNonVanishing();
+    std::set<IndexCombination4> Indices;
+    for(auto const& ic : InitialIndices.empty() ? enumerateIndices() : InitialIndices) {
+        if(NonVanishing.count(ic) || !HasOperators(ic))
+            Indices.insert(ic);
+    }
+    INFO("TwoParticleGFContainer: " << Indices.size() << " non-vanishing index combinations");
+
+    if(Indices.empty())
+        ElementsMap.clear();
+    else
+        fill(Indices);
     for(auto& el : ElementsMap) {
         auto& g = static_cast<TwoParticleGF&>(el.second);
         g.ReduceResonanceTolerance = ReduceResonanceTolerance;
@@ -31,12 +58,110 @@ void TwoParticleGFContainer::prepareAll(std::set<IndexCombination4> const& Initi
     }
 }
 
+std::set<IndexCombination4> TwoParticleGFContainer::findNonVanishing() const {
+    std::vector<ParticleIndex> Indices;
+    for(ParticleIndex i : Operators.getIndices())
+        Indices.push_back(i);
+    std::size_t NIndices = Indices.size();
+    BlockNumber NBlocks = S.getNumberOfBlocks();
+
+    // Connections between subspaces established by the annihilation (Type = 0)
+    // and creation (Type = 1) operators.
+    // Right[Type][x][L] = R and Left[Type][x][R] = L for each block <L|O_x|R>.
+    using BlockMap = std::vector<BlockNumber>;
+    std::array<std::vector<BlockMap>, 2> Right, Left;
+    // Positions x of the operators connecting a pair of subspaces (L, R)
+    std::array<std::map<std::pair<BlockNumber, BlockNumber>, std::vector<std::size_t>>, 2> Connecting;
+    for(int Type = 0; Type < 2; ++Type) {
+        Right[Type].assign(NIndices, BlockMap(NBlocks, INVALID_BLOCK_NUMBER));
+        Left[Type].assign(NIndices, BlockMap(NBlocks, INVALID_BLOCK_NUMBER));
+        for(std::size_t x = 0; x < NIndices; ++x) {
+            MonomialOperator const& Op = Type == 0 ?
+                                             static_cast<MonomialOperator const&>(
+                                                 Operators.getAnnihilationOperator(Indices[x])) :
+                                             static_cast<MonomialOperator const&>(
+                                                 Operators.getCreationOperator(Indices[x]));
+            for(auto const& LR : Op.getBlockMapping().left) {
+                Right[Type][x][LR.first] = LR.second;
+                Left[Type][x][LR.second] = LR.first;
+                Connecting[Type][std::make_pair(LR.first, LR.second)].push_back(x);
+            }
+        }
+    }
+
+    // Follow the sequences of subspaces <B0|O1|B1><B1|O2|B2><B2|O3|B3><B3|CX4|B0>
+    // for all 6 permutations (O1, O2, O3) of (c_i, c_j, c^+_k)
+    std::set<IndexCombination4> NonVanishing;
+    for(std::size_t l = 0; l < NIndices; ++l) {
+        for(BlockNumber B0 = 0; B0 < NBlocks; ++B0) {
+            BlockNumber B3 = Left[1][l][B0];
+            if(B3 == INVALID_BLOCK_NUMBER)
+                continue;
+            for(auto const& Permutation : permutations3) {
+                // Operator c^+_k (position 2 in the original order) is a creation operator
+                std::array<int, 3> Types = {};
+                for(std::size_t pos = 0; pos < 3; ++pos)
+                    Types[pos] = Permutation.perm[pos] == 2 ? 1 : 0;
+
+                for(std::size_t x3 = 0; x3 < NIndices; ++x3) {
+                    BlockNumber B2 = Left[Types[2]][x3][B3];
+                    if(B2 == INVALID_BLOCK_NUMBER)
+                        continue;
+                    for(std::size_t x1 = 0; x1 < NIndices; ++x1) {
+                        BlockNumber B1 = Right[Types[0]][x1][B0];
+                        if(B1 == INVALID_BLOCK_NUMBER)
+                            continue;
+                        if(!DM.isRetained(B0) && !DM.isRetained(B1) && !DM.isRetained(B2) && !DM.isRetained(B3))
+                            continue;
+                        auto Connected = Connecting[Types[1]].find(std::make_pair(B1, B2));
+                        if(Connected == Connecting[Types[1]].end())
+                            continue;
+                        for(std::size_t x2 : Connected->second) {
+                            std::array<std::size_t, 3> x = {};
+                            x[Permutation.perm[0]] = x1;
+                            x[Permutation.perm[1]] = x2;
+                            x[Permutation.perm[2]] = x3;
+                            NonVanishing.emplace(Indices[x[0]], Indices[x[1]], Indices[x[2]], Indices[l]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return NonVanishing;
+}
+
 std::map<IndexCombination4, std::vector<ComplexType>>
 TwoParticleGFContainer::computeAll(bool clearTerms, FreqVec const& freqs, MPI_Comm const& comm, bool split) {
-    if(split)
-        return computeAll_split(clearTerms, freqs, comm);
-    else
-        return computeAll_nosplit(clearTerms, freqs, comm);
+    for(auto& el : ElementsMap) {
+        auto& g = static_cast<TwoParticleGF&>(el.second);
+        g.DistributedOutput = DistributedOutput;
+        g.SinglePrecisionPoles = SinglePrecisionPoles;
+        g.StreamingBatchSize = StreamingBatchSize;
+    }
+    TermOwners.clear();
+
+    auto out = split ? computeAll_split(clearTerms, freqs, comm) : computeAll_nosplit(clearTerms, freqs, comm);
+
+    if(CompactTerms && !clearTerms) {
+        for(auto const& el : NonTrivialElements) {
+            if(el.second->getStatus() >= TwoParticleGF::Computed)
+                el.second->compactTerms();
+        }
+    }
+
+    // Index combinations related to the computed elements by the symmetries share their values
+    std::map<TwoParticleGF const*, IndexCombination4> Representatives;
+    for(auto const& el : NonTrivialElements)
+        Representatives.emplace(el.second.get(), el.first);
+    for(auto const& el : ElementsMap) {
+        if(out.count(el.first) || el.second.FrequenciesPermutation != permutations4[0])
+            continue;
+        auto r = Representatives.find(el.second.pElement.get());
+        if(r != Representatives.end() && out.count(r->second))
+            out[el.first] = out[r->second];
+    }
+    return out;
 }
 
 std::map<IndexCombination4, std::vector<ComplexType>>
@@ -49,6 +174,103 @@ TwoParticleGFContainer::computeAll_nosplit(bool clearTerms, FreqVec const& freqs
     return out;
 }
 
+namespace Detail {
+
+std::vector<int> proportional_counts(std::vector<double> Weights, int NProcs) {
+    std::size_t NGroups = Weights.size();
+    if(static_cast<std::size_t>(NProcs) < NGroups)
+        throw std::runtime_error("proportional_counts: Fewer processes than groups");
+    double TotalWeight = std::accumulate(Weights.begin(), Weights.end(), 0.0);
+    if(!(TotalWeight > 0)) {
+        std::fill(Weights.begin(), Weights.end(), 1.0);
+        TotalWeight = static_cast<double>(NGroups);
+    }
+
+    std::vector<double> Ideal(NGroups);
+    std::vector<int> Counts(NGroups);
+    for(std::size_t g = 0; g < NGroups; ++g) {
+        Ideal[g] = Weights[g] / TotalWeight * NProcs;
+        Counts[g] = std::max(1, static_cast<int>(Ideal[g]));
+    }
+
+    // Largest remainder method
+    int Sum = std::accumulate(Counts.begin(), Counts.end(), 0);
+    for(; Sum < NProcs; ++Sum) {
+        std::size_t g = 0;
+        for(std::size_t h = 1; h < NGroups; ++h) {
+            if(Ideal[h] - Counts[h] > Ideal[g] - Counts[g])
+                g = h;
+        }
+        ++Counts[g];
+    }
+    for(; Sum > NProcs; --Sum) {
+        std::size_t g = NGroups;
+        for(std::size_t h = 0; h < NGroups; ++h) {
+            if(Counts[h] > 1 && (g == NGroups || Counts[h] - Ideal[h] > Counts[g] - Ideal[g]))
+                g = h;
+        }
+        assert(g < NGroups);
+        --Counts[g];
+    }
+    return Counts;
+}
+
+std::vector<int> place_groups(std::vector<int> const& Counts, MPI_Comm const& comm) {
+    int comm_rank = pMPI::rank(comm);
+    int comm_size = pMPI::size(comm);
+
+    // Identify nodes by the lowest rank of the processes running on them
+    MPI_Comm node_comm = nullptr;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, comm_rank, MPI_INFO_NULL, &node_comm);
+    int node_id = comm_rank;
+    MPI_Bcast(&node_id, 1, MPI_INT, 0, node_comm);
+    MPI_Comm_free(&node_comm);
+    std::vector<int> node_ids(comm_size);
+    MPI_Allgather(&node_id, 1, MPI_INT, node_ids.data(), 1, MPI_INT, comm);
+
+    std::map<int, std::vector<int>> NodeProcs;
+    for(int p = 0; p < comm_size; ++p)
+        NodeProcs[node_ids[p]].push_back(p);
+    std::vector<std::vector<int>> FreeProcs;
+    for(auto& node : NodeProcs) {
+        std::reverse(node.second.begin(), node.second.end()); // Take processes from the back
+        FreeProcs.emplace_back(std::move(node.second));
+    }
+
+    std::vector<int> Order(Counts.size());
+    std::iota(Order.begin(), Order.end(), 0);
+    std::stable_sort(Order.begin(), Order.end(), [&Counts](int g1, int g2) { return Counts[g1] > Counts[g2]; });
+
+    std::vector<int> ProcGroups(comm_size, -1);
+    for(int g : Order) {
+        // The fullest node that can host the whole group
+        auto Fits = [&Counts, g](std::vector<int> const& Node) {
+            return Node.size() >= static_cast<std::size_t>(Counts[g]);
+        };
+        auto BestFit = FreeProcs.end();
+        for(auto it = FreeProcs.begin(); it != FreeProcs.end(); ++it) {
+            if(Fits(*it) && (BestFit == FreeProcs.end() || it->size() < BestFit->size()))
+                BestFit = it;
+        }
+
+        for(int n = 0; n < Counts[g]; ++n) {
+            auto Node = BestFit;
+            if(Node == FreeProcs.end()) { // The group spans several nodes, take the emptiest one first
+                Node = std::max_element(FreeProcs.begin(),
+                                        FreeProcs.end(),
+                                        [](std::vector<int> const& n1, std::vector<int> const& n2) {
+                                            return n1.size() < n2.size();
+                                        });
+            }
+            ProcGroups[Node->back()] = g;
+            Node->pop_back();
+        }
+    }
+    return ProcGroups;
+}
+
+} // namespace Detail
+
 std::map<IndexCombination4, std::vector<ComplexType>>
 TwoParticleGFContainer::computeAll_split(bool clearTerms, FreqVec const& freqs, MPI_Comm const& comm) {
     std::map<IndexCombination4, std::vector<ComplexType>> out;
@@ -57,69 +279,138 @@ TwoParticleGFContainer::computeAll_split(bool clearTerms, FreqVec const& freqs,
     int comm_size = pMPI::size(comm);
     int comm_rank = pMPI::rank(comm);
 
+    std::vector<std::pair<IndexCombination4, TwoParticleGF*>> Elements;
+    for(auto const& el : NonTrivialElements)
+        Elements.emplace_back(el.first, el.second.get());
+
     // split communicator
-    int ncomponents = static_cast<int>(NonTrivialElements.size());
-    int ncolors = std::min(comm_size, int(NonTrivialElements.size()));
-    RealType color_size = 1.0 * comm_size / static_cast<RealType>(ncolors);
+    int ncomponents = static_cast<int>(Elements.size());
+    if(ncomponents == 0)
+        return out;
+    int ncolors = std::min(comm_size, ncomponents);
     std::map<int, int> proc_colors;
     std::map<int, int> elem_colors;
     std::map<int, int> color_roots;
-    for(int p = 0; p < comm_size; ++p) {
-        int color = int(1.0 * p / color_size);
-        proc_colors[p] = color;
-        color_roots[color] = p;
-    }
-    for(int i = 0; i < ncomponents; ++i) {
-        int color = i * ncolors / ncomponents;
-        elem_colors[i] = color;
+    // Components that are not assigned to a color in advance
+    std::vector<pMPI::JobId> dynamic_components;
+
+    if(BalancedSplit) {
+        // The ncolors most expensive components are computed by separate colors,
+        // the rest are claimed by the colors that finish first.
+        std::vector<double> Costs(ncomponents);
+        for(int i = 0; i < ncomponents; ++i)
+            Costs[i] = Elements[i].second->estimateCost();
+        std::vector<int> Order(ncomponents);
+        std::iota(Order.begin(), Order.end(), 0);
+        std::stable_sort(Order.begin(), Order.end(), [&Costs](int i1, int i2) { return Costs[i1] > Costs[i2]; });
+
+        double TailCost = 0;
+        for(int k = ncolors; k < ncomponents; ++k) {
+            TailCost += Costs[Order[k]];
+            dynamic_components.push_back(Order[k]);
+        }
+        std::vector<double> Weights(ncolors);
+        for(int color = 0; color < ncolors; ++color) {
+            elem_colors[Order[color]] = color;
+            Weights[color] = Costs[Order[color]] + TailCost / ncolors;
+        }
+
+        std::vector<int> ProcColors = Detail::place_groups(Detail::proportional_counts(Weights, comm_size), comm);
+        for(int p = 0; p < comm_size; ++p)
+            proc_colors[p] = ProcColors[p];
+    } else {
+        RealType color_size = 1.0 * comm_size / static_cast<RealType>(ncolors);
+        for(int p = 0; p < comm_size; ++p)
+            proc_colors[p] = int(1.0 * p / color_size);
+        for(int i = 0; i < ncomponents; ++i)
+            elem_colors[i] = i * ncolors / ncomponents;
     }
+    for(int p = comm_size - 1; p >= 0; --p)
+        color_roots[proc_colors[p]] = p;
 
     if(!comm_rank) {
         INFO("Splitting " << ncomponents << " components in " << ncolors << " communicators");
-        for(std::size_t i = 0; i < ncomponents; ++i)
-            INFO("2pgf " << i << " color: " << elem_colors[i] << " color_root: " << color_roots[elem_colors[i]]);
+        for(auto const& ec : elem_colors)
+            INFO("2pgf " << ec.first << " color: " << ec.second << " color_root: " << color_roots[ec.second]);
+        if(!dynamic_components.empty())
+            INFO(dynamic_components.size() << " components will be claimed by the colors that finish first");
     }
     MPI_Barrier(comm);
-    int comp = 0;
 
+    int color = proc_colors[comm_rank];
     MPI_Comm comm_split = nullptr;
-    MPI_Comm_split(comm, proc_colors[comm_rank], comm_rank, &comm_split);
+    MPI_Comm_split(comm, color, comm_rank, &comm_split);
+    int split_rank = pMPI::rank(comm_split);
+
+    auto compute_component = [&](int comp) {
+        INFO("C" << color << "p" << comm_rank << ": computing 2PGF for " << Elements[comp].first);
+        storage[Elements[comp].first] = Elements[comp].second->compute(clearTerms, freqs, comm_split);
+    };
 
-    for(auto iter = NonTrivialElements.begin(); iter != NonTrivialElements.end(); iter++, comp++) {
-        if(elem_colors[comp] == proc_colors[comm_rank]) {
-            INFO("C" << elem_colors[comp] << "p" << comm_rank << ": computing 2PGF for " << iter->first);
-            storage[iter->first] = static_cast<TwoParticleGF&>(*(iter->second)).compute(clearTerms, freqs, comm_split);
+    {
+        // Must be created before any computation starts, as the constructor is collective
+        pMPI::MPIJobCounter counter(comm, dynamic_components);
+
+        for(int comp = 0; comp < ncomponents; ++comp) {
+            auto ec = elem_colors.find(comp);
+            if(ec != elem_colors.end() && ec->second == color)
+                compute_component(comp);
+        }
+
+        // The root of each color claims the remaining components for its group
+        while(!dynamic_components.empty()) {
+            pMPI::JobId comp = -1;
+            if(split_rank == 0 && !counter.claim(comp))
+                comp = -1;
+            MPI_Bcast(&comp, 1, MPI_INT, 0, comm_split);
+            if(comp < 0)
+                break;
+            compute_component(comp);
         }
+
+        for(auto const& job : counter.gather_dispatch_map())
+            elem_colors[job.first] = proc_colors[job.second];
     }
+    MPI_Comm_free(&comm_split);
+
     MPI_Barrier(comm);
     // distribute data
     if(!comm_rank)
         INFO_NONEWLINE("Distributing 2PGF container...");
-    comp = 0;
-    for(auto iter = NonTrivialElements.begin(); iter != NonTrivialElements.end(); iter++, comp++) {
+    for(int comp = 0; comp < ncomponents; ++comp) {
         int sender = color_roots[elem_colors[comp]];
-        TwoParticleGF& chi = *((iter)->second);
-        for(std::size_t p = 0; p < chi.parts.size(); p++) {
-            chi.parts[p].NonResonantTerms.broadcast(comm, sender);
-            chi.parts[p].ResonantTerms.broadcast(comm, sender);
-            std::vector<ComplexType> freq_data;
-            int freq_data_size = {};
-            if(comm_rank == sender) {
-                freq_data = storage[iter->first];
-                freq_data_size = static_cast<int>(freq_data.size());
-                MPI_Bcast(&freq_data_size, 1, MPI_LONG, sender, comm);
-                MPI_Bcast(freq_data.data(), freq_data_size, MPI_CXX_DOUBLE_COMPLEX, sender, comm);
-            } else {
-                MPI_Bcast(&freq_data_size, 1, MPI_LONG, sender, comm);
-                freq_data.resize(freq_data_size);
-                MPI_Bcast(freq_data.data(), freq_data_size, MPI_CXX_DOUBLE_COMPLEX, sender, comm);
-            }
-            out[iter->first] = freq_data;
+        TwoParticleGF& chi = *Elements[comp].second;
+        IndexCombination4 const& Indices = Elements[comp].first;
+        if(!clearTerms) {
+            if(DistributedTerms)
+                TermOwners[&chi] = sender;
+            else
+                chi.shareTerms(std::vector<int>(chi.parts.size(), sender), comm);
+        }
+        // Elements whose terms are kept by other processes must not be evaluated locally
+        bool terms_elsewhere = DistributedTerms && !clearTerms;
+        if(comm_rank != sender && !terms_elsewhere) {
+            chi.setStatus(TwoParticleGF::Computed);
+        }
 
-            if(comm_rank != sender) {
-                chi.setStatus(TwoParticleGF::Computed);
-            }
+        if(DistributedOutput && !freqs.empty()) {
+            out[Indices] = redistributeOutput(storage[Indices], freqs.size(), elem_colors[comp], proc_colors, comm);
+            continue;
         }
+
+        std::vector<ComplexType> freq_data;
+        long freq_data_size = {};
+        if(comm_rank == sender) {
+            freq_data = storage[Indices];
+            freq_data_size = static_cast<long>(freq_data.size());
+            MPI_Bcast(&freq_data_size, 1, MPI_LONG, sender, comm);
+            MPI_Bcast(freq_data.data(), static_cast<int>(freq_data_size), MPI_CXX_DOUBLE_COMPLEX, sender, comm);
+        } else {
+            MPI_Bcast(&freq_data_size, 1, MPI_LONG, sender, comm);
+            freq_data.resize(freq_data_size);
+            MPI_Bcast(freq_data.data(), static_cast<int>(freq_data_size), MPI_CXX_DOUBLE_COMPLEX, sender, comm);
+        }
+        out[Indices] = freq_data;
     }
     MPI_Barrier(comm);
     if(!comm_rank)
@@ -127,6 +418,110 @@ TwoParticleGFContainer::computeAll_split(bool clearTerms, FreqVec const& freqs,
     return out;
 }
 
+std::vector<ComplexType> TwoParticleGFContainer::redistributeOutput(std::vector<ComplexType> const& data,
+                                                                   std::size_t NFreqs,
+                                                                   int color,
+                                                                   std::map<int, int> const& proc_colors,
+                                                                   MPI_Comm const& comm) {
+    int comm_size = pMPI::size(comm);
+    int comm_rank = pMPI::rank(comm);
+
+    // Processes of the computing group in the order of their ranks within the group
+    std::vector<int> group;
+    for(auto const& pc : proc_colors) {
+        if(pc.second == color)
+            group.push_back(pc.first);
+    }
+    int group_size = static_cast<int>(group.size());
+    auto group_it = std::find(group.begin(), group.end(), comm_rank);
+    int group_rank = group_it != group.end() ? static_cast<int>(group_it - group.begin()) : -1;
+
+    // Intersection of two ranges of positions
+    auto overlap = [](std::pair<std::size_t, std::size_t> a, std::pair<std::size_t, std::size_t> b) {
+        std::size_t first = std::max(a.first, b.first);
+        return std::make_pair(first, std::max(first, std::min(a.second, b.second)));
+    };
+
+    auto target = TwoParticleGF::getOutputSlice(NFreqs, comm_rank, comm_size);
+    std::vector<int> sendcounts(comm_size, 0), sdispls(comm_size, 0), recvcounts(comm_size, 0), rdispls(comm_size, 0);
+    if(group_rank >= 0) {
+        auto source = TwoParticleGF::getOutputSlice(NFreqs, group_rank, group_size);
+        for(int p = 0; p < comm_size; ++p) {
+            auto o = overlap(source, TwoParticleGF::getOutputSlice(NFreqs, p, comm_size));
+            sendcounts[p] = static_cast<int>(o.second - o.first);
+            sdispls[p] = static_cast<int>(o.first - source.first);
+        }
+    }
+    for(int g = 0; g < group_size; ++g) {
+        auto o = overlap(TwoParticleGF::getOutputSlice(NFreqs, g, group_size), target);
+        recvcounts[group[g]] = static_cast<int>(o.second - o.first);
+        rdispls[group[g]] = static_cast<int>(o.first - target.first);
+    }
+
+    std::vector<ComplexType> out(target.second - target.first);
+    MPI_Alltoallv(data.data(),
+                  sendcounts.data(),
+                  sdispls.data(),
+                  MPI_CXX_DOUBLE_COMPLEX,
+                  out.data(),
+                  recvcounts.data(),
+                  rdispls.data(),
+                  MPI_CXX_DOUBLE_COMPLEX,
+                  comm);
+    return out;
+}
+
+std::vector<ComplexType>
+TwoParticleGFContainer::evaluate(IndexCombination4 const& Indices, FreqVec const& freqs, MPI_Comm const& comm) const {
+    auto iter = ElementsMap.find(Indices);
+    if(iter == ElementsMap.end())
+        throw std::runtime_error("TwoParticleGFContainer: Requested element is not in the container");
+
+    // Frequencies of the stored element
+    Permutation4 const& FrequenciesPermutation = iter->second.FrequenciesPermutation;
+    FreqVec PermutedFreqs;
+    PermutedFreqs.reserve(freqs.size());
+    for(auto const& f : freqs) {
+        std::array<ComplexType, 4> z = {
+            std::get<0>(f), std::get<1>(f), std::get<2>(f), std::get<0>(f) + std::get<1>(f) - std::get<2>(f)};
+        PermutedFreqs.emplace_back(z[FrequenciesPermutation.perm[0]],
+                                   z[FrequenciesPermutation.perm[1]],
+                                   z[FrequenciesPermutation.perm[2]]);
+    }
+
+    TwoParticleGF const& chi = *iter->second.pElement;
+    std::vector<ComplexType> out;
+    auto owner = TermOwners.find(&chi);
+    if(owner == TermOwners.end()) {
+        out = chi.evaluate(PermutedFreqs);
+    } else {
+        if(pMPI::rank(comm) == owner->second)
+            out = chi.evaluate(PermutedFreqs);
+        else
+            out.resize(freqs.size());
+        MPI_Bcast(out.data(), static_cast<int>(out.size()), MPI_CXX_DOUBLE_COMPLEX, owner->second, comm);
+    }
+
+    for(auto& v : out)
+        v *= RealType(FrequenciesPermutation.sign);
+    return out;
+}
+
+void TwoParticleGFContainer::saveTerms(BinaryOutputArchive& ar) const {
+    std::map<TwoParticleGF const*, std::vector<std::pair<IndexCombination4, std::size_t>>> Aliases;
+    for(auto const& el : ElementsMap) {
+        std::size_t PermutationNumber =
+            std::find(permutations4.begin(), permutations4.end(), el.second.FrequenciesPermutation) -
+            permutations4.begin();
+        Aliases[el.second.pElement.get()].emplace_back(el.first, PermutationNumber);
+    }
+
+    ar.beginSection("2PGFLIST");
+    ar.write(std::uint64_t(NonTrivialElements.size()));
+    for(auto const& el : NonTrivialElements)
+        el.second->writeTerms(ar, Aliases[el.second.get()]);
+}
+
 std::shared_ptr<TwoParticleGF> TwoParticleGFContainer::createElement(IndexCombination4 const& Indices) const {
     AnnihilationOperator const& C1 = Operators.getAnnihilationOperator(Indices.Index1);
     AnnihilationOperator const& C2 = Operators.getAnnihilationOperator(Indices.Index2);
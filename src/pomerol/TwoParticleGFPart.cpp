@@ -15,7 +15,12 @@
 
 #include "pomerol/TwoParticleGFPart.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <mutex>
 #include <stdexcept>
 #include <utility>
@@ -48,15 +53,20 @@ inline bool chaseIndices(typename RowMajorMatrixType<Complex>::InnerIterator& in
     return false;
 }
 
+// Combined weight of two terms, saturated at the largest value of TwoParticleGFPart::*Term::Weight
+inline std::uint32_t saturate_weight(std::uint64_t combinedWeight) {
+    return std::uint32_t(std::min<std::uint64_t>(combinedWeight, std::numeric_limits<std::uint32_t>::max()));
+}
+
 //
 // TwoParticleGFPart::NonResonantTerm
 //
 TwoParticleGFPart::NonResonantTerm& TwoParticleGFPart::NonResonantTerm::operator+=(NonResonantTerm const& AnotherTerm) {
-    long combinedWeight = Weight + AnotherTerm.Weight;
+    std::uint64_t combinedWeight = std::uint64_t(Weight) + AnotherTerm.Weight;
     for(unsigned short p = 0; p < 3; ++p)
         // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
-        Poles[p] = (Weight * Poles[p] + AnotherTerm.Weight * AnotherTerm.Poles[p]) / combinedWeight;
-    Weight = combinedWeight;
+        Poles[p] = (Weight * Poles[p] + AnotherTerm.Weight * AnotherTerm.Poles[p]) / RealType(combinedWeight);
+    Weight = saturate_weight(combinedWeight);
     Coeff += AnotherTerm.Coeff;
     return *this;
 }
@@ -90,7 +100,7 @@ MPI_Datatype TwoParticleGFPart::NonResonantTerm::mpi_datatype() {
             MPI_CXX_DOUBLE_COMPLEX, // ComplexType Coeff
             MPI_DOUBLE,             // RealType Poles[3]
             MPI_CXX_BOOL,           // bool isz4
-            MPI_LONG                // long Weight
+            MPI_UINT32_T            // std::uint32_t Weight
         };
         MPI_Type_create_struct(4, blocklengths, displacements, types, &dt);
         MPI_Type_commit(&dt);
@@ -103,11 +113,11 @@ MPI_Datatype TwoParticleGFPart::NonResonantTerm::mpi_datatype() {
 // TwoParticleGFPart::ResonantTerm
 //
 TwoParticleGFPart::ResonantTerm& TwoParticleGFPart::ResonantTerm::operator+=(ResonantTerm const& AnotherTerm) {
-    long combinedWeight = Weight + AnotherTerm.Weight;
+    std::uint64_t combinedWeight = std::uint64_t(Weight) + AnotherTerm.Weight;
     for(unsigned short p = 0; p < 3; ++p)
         // NOLINTNEXTLINE(cppcoreguidelines-narrowing-conversions)
-        Poles[p] = (Weight * Poles[p] + AnotherTerm.Weight * AnotherTerm.Poles[p]) / combinedWeight;
-    Weight = combinedWeight;
+        Poles[p] = (Weight * Poles[p] + AnotherTerm.Weight * AnotherTerm.Poles[p]) / RealType(combinedWeight);
+    Weight = saturate_weight(combinedWeight);
     ResCoeff += AnotherTerm.ResCoeff;
     NonResCoeff += AnotherTerm.NonResCoeff;
     return *this;
@@ -144,7 +154,7 @@ MPI_Datatype TwoParticleGFPart::ResonantTerm::mpi_datatype() {
             MPI_CXX_DOUBLE_COMPLEX, // ComplexType NonResCoeff
             MPI_DOUBLE,             // RealType Poles[3]
             MPI_CXX_BOOL,           // bool isz1z2
-            MPI_LONG                // long Weight
+            MPI_UINT32_T            // std::uint32_t Weight
         };
         MPI_Type_create_struct(5, blocklengths, displacements, types, &dt);
         MPI_Type_commit(&dt);
@@ -191,15 +201,79 @@ void TwoParticleGFPart::compute() {
     if(getStatus() >= Computed)
         return;
 
+    auto Start = std::chrono::steady_clock::now();
+
     if(O1.isComplex() || O2.isComplex() || O3.isComplex() || CX4.isComplex())
         computeImpl<true>();
     else
         computeImpl<false>();
+
+    ComputeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+double TwoParticleGFPart::estimateCost() const {
+    double N1 = Hpart1.getNumberOfEigenstates();
+    double N2 = Hpart2.getNumberOfEigenstates();
+    double N3 = Hpart3.getNumberOfEigenstates();
+    double N4 = Hpart4.getNumberOfEigenstates();
+
+    double NNZ1 = O1.getNumberOfNonZeros();
+    double NNZ2 = O2.getNumberOfNonZeros();
+    double NNZ3 = O3.getNumberOfNonZeros();
+    double NNZ4 = CX4.getNumberOfNonZeros();
+
+    // For each pair (index1, index3), row index1 of O1, column index3 of O2,
+    // row index3 of O3 and column index1 of CX4 are traversed
+    double Visited = N3 * NNZ1 + N1 * NNZ2 + N1 * NNZ3 + N3 * NNZ4;
+
+    double N = N1 * N2 * N3 * N4;
+    double Multiterms = N > 0 ? (NNZ1 * NNZ2) * (NNZ3 * NNZ4) / N : 0;
+
+    return Visited + MultitermCost * Multiterms;
+}
+
+void TwoParticleGFPart::computeStreaming(FreqArrays const& z, std::vector<ComplexType>& data, std::size_t BatchSize) {
+    if(BatchSize == 0)
+        throw std::runtime_error("2PGFPart: The batch size must be positive.");
+    assert(data.size() == z.size());
+
+    clear();
+
+    auto Start = std::chrono::steady_clock::now();
+
+    if(O1.isComplex() || O2.isComplex() || O3.isComplex() || CX4.isComplex())
+        computeImpl<true>(&z, &data, BatchSize);
+    else
+        computeImpl<false>(&z, &data, BatchSize);
+
+    ComputeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+void TwoParticleGFPart::evaluateBatch(FlatTermList<NonResonantTerm>& NonResonantList,
+                                      FlatTermList<ResonantTerm>& ResonantList,
+                                      FreqArrays const& z,
+                                      std::vector<ComplexType>& data) const {
+    NonResonantList.flush();
+    ResonantList.flush();
+
+    FrozenNonResonantTerms NonResonant;
+    NonResonant.assign(NonResonantList.as_vector());
+    NonResonantList.clear();
+    FrozenResonantTerms Resonant;
+    Resonant.assign(ResonantList.as_vector());
+    ResonantList.clear();
+
+    // Batches are evaluated by the threads that have computed them
+    EvaluateFrozenTermsSerial(NonResonant, Resonant, ReduceResonanceTolerance, z, data);
 }
 
-template <bool Complex> void TwoParticleGFPart::computeImpl() {
+template <bool Complex>
+void TwoParticleGFPart::computeImpl(FreqArrays const* z, std::vector<ComplexType>* data, std::size_t BatchSize) {
     NonResonantTerms.clear();
     ResonantTerms.clear();
+    FrozenNonResonant.clear();
+    FrozenResonant.clear();
+    Frozen = false;
 
     RealType beta = DMpart1.beta;
     // I don't have any pen now, so I'm writing here:
@@ -215,57 +289,145 @@ template <bool Complex> void TwoParticleGFPart::computeImpl() {
         CX4matrix.outerSize(); // One can not make a cutoff in external index for evaluating 2PGF
     InnerQuantumState index3Max = O2matrix.outerSize();
 
-    std::vector<InnerQuantumState> Index4List;
-    Index4List.reserve(index1Max * index3Max);
-
-    for(InnerQuantumState index1 = 0; index1 < index1Max; ++index1)
-        for(InnerQuantumState index3 = 0; index3 < index3Max; ++index3) {
-            typename ColMajorMatrixType<Complex>::InnerIterator index4bra_iter(CX4matrix, index1);
-            typename RowMajorMatrixType<Complex>::InnerIterator index4ket_iter(O3matrix, index3);
-            Index4List.clear();
-            while(index4bra_iter && index4ket_iter) {
-                if(chaseIndices<Complex>(index4ket_iter, index4bra_iter)) {
-                    Index4List.push_back(index4bra_iter.index());
-                    ++index4bra_iter;
-                    ++index4ket_iter;
-                }
-            };
-
-            if(!Index4List.empty()) {
-                RealType E1 = Hpart1.getEigenValue(index1);
-                RealType E3 = Hpart3.getEigenValue(index3);
-                RealType weight1 = DMpart1.getWeight(index1);
-                RealType weight3 = DMpart3.getWeight(index3);
-
-                typename ColMajorMatrixType<Complex>::InnerIterator index2bra_iter(O2matrix, index3);
-                typename RowMajorMatrixType<Complex>::InnerIterator index2ket_iter(O1matrix, index1);
-                while(index2bra_iter && index2ket_iter) {
-                    if(chaseIndices<Complex>(index2ket_iter, index2bra_iter)) {
-
-                        InnerQuantumState index2 = index2ket_iter.index();
-                        RealType E2 = Hpart2.getEigenValue(index2);
-                        RealType weight2 = DMpart2.getWeight(index2);
-
-                        for(unsigned long index4 : Index4List) {
-                            RealType E4 = Hpart4.getEigenValue(index4);
-                            RealType weight4 = DMpart4.getWeight(index4);
-                            if(weight1 + weight2 + weight3 + weight4 >= CoefficientTolerance) {
-                                ComplexType MatrixElement = index2ket_iter.value() * index2bra_iter.value() *
-                                                            O3matrix.coeff(index3, index4) *
-                                                            CX4matrix.coeff(index4, index1);
-
-                                MatrixElement *= Permutation.sign;
-
-                                addMultiterm(MatrixElement, beta, E1, E2, E3, E4, weight1, weight2, weight3, weight4);
+    // The (index1, index3) space is split into square tiles, which are distributed among threads.
+    long NTiles1 = static_cast<long>((index1Max + ComputeTileSize - 1) / ComputeTileSize);
+    long NTiles3 = static_cast<long>((index3Max + ComputeTileSize - 1) / ComputeTileSize);
+    long NTiles = NTiles1 * NTiles3;
+
+    // Each thread accumulates terms in its own lists. In the streaming mode, it also evaluates
+    // batches of its terms into its own buffer. The results of the threads are combined in the order
+    // of thread numbers, and the tiles are assigned to the threads statically, so that the result
+    // does not depend on the timing of the threads.
+    int NThreads = 1;
+#ifdef POMEROL_USE_OPENMP
+    NThreads = NTiles > 1 ? omp_get_max_threads() : 1;
+#endif
+    std::vector<FlatTermList<NonResonantTerm>> NonResonantTermsPerThread(
+        NThreads,
+        FlatTermList<NonResonantTerm>(NonResonantTerms.get_compare(), NonResonantTerms.get_is_negligible()));
+    std::vector<FlatTermList<ResonantTerm>> ResonantTermsPerThread(
+        NThreads,
+        FlatTermList<ResonantTerm>(ResonantTerms.get_compare(), ResonantTerms.get_is_negligible()));
+    std::vector<std::vector<ComplexType>> DataPerThread(z ? NThreads : 0, std::vector<ComplexType>(z ? z->size() : 0));
+
+#ifdef POMEROL_USE_OPENMP
+#pragma omp parallel num_threads(NThreads)
+#endif
+    {
+        int Thread = 0;
+#ifdef POMEROL_USE_OPENMP
+        Thread = omp_get_thread_num();
+#endif
+        FlatTermList<NonResonantTerm>& NonResonantTermsLocal = NonResonantTermsPerThread[Thread];
+        FlatTermList<ResonantTerm>& ResonantTermsLocal = ResonantTermsPerThread[Thread];
+
+        // Pairs (index4, <3|O3|4><4|CX4|1>)
+        std::vector<std::pair<InnerQuantumState, MelemType<Complex>>> Index4List;
+
+#ifdef POMEROL_USE_OPENMP
+#pragma omp for schedule(static, 1)
+#endif
+        for(long tile = 0; tile < NTiles; ++tile) {
+            InnerQuantumState index1Begin = (tile / NTiles3) * ComputeTileSize;
+            InnerQuantumState index1End = std::min(index1Begin + ComputeTileSize, index1Max);
+            InnerQuantumState index3Begin = (tile % NTiles3) * ComputeTileSize;
+            InnerQuantumState index3End = std::min(index3Begin + ComputeTileSize, index3Max);
+
+            for(InnerQuantumState index1 = index1Begin; index1 < index1End; ++index1)
+                for(InnerQuantumState index3 = index3Begin; index3 < index3End; ++index3) {
+                    typename ColMajorMatrixType<Complex>::InnerIterator index4bra_iter(CX4matrix, index1);
+                    typename RowMajorMatrixType<Complex>::InnerIterator index4ket_iter(O3matrix, index3);
+                    Index4List.clear();
+                    while(index4bra_iter && index4ket_iter) {
+                        if(chaseIndices<Complex>(index4ket_iter, index4bra_iter)) {
+                            Index4List.emplace_back(index4bra_iter.index(),
+                                                    index4ket_iter.value() * index4bra_iter.value());
+                            ++index4bra_iter;
+                            ++index4ket_iter;
+                        }
+                    };
+
+                    if(Index4List.empty())
+                        continue;
+
+                    RealType E1 = Hpart1.getEigenValue(index1);
+                    RealType E3 = Hpart3.getEigenValue(index3);
+                    RealType weight1 = DMpart1.getWeight(index1);
+                    RealType weight3 = DMpart3.getWeight(index3);
+
+                    typename ColMajorMatrixType<Complex>::InnerIterator index2bra_iter(O2matrix, index3);
+                    typename RowMajorMatrixType<Complex>::InnerIterator index2ket_iter(O1matrix, index1);
+                    while(index2bra_iter && index2ket_iter) {
+                        if(chaseIndices<Complex>(index2ket_iter, index2bra_iter)) {
+
+                            InnerQuantumState index2 = index2ket_iter.index();
+                            RealType E2 = Hpart2.getEigenValue(index2);
+                            RealType weight2 = DMpart2.getWeight(index2);
+                            MelemType<Complex> Element12 = index2ket_iter.value() * index2bra_iter.value();
+
+                            for(auto const& index4_elem : Index4List) {
+                                InnerQuantumState index4 = index4_elem.first;
+                                RealType E4 = Hpart4.getEigenValue(index4);
+                                RealType weight4 = DMpart4.getWeight(index4);
+                                if(weight1 + weight2 + weight3 + weight4 >= CoefficientTolerance) {
+                                    ComplexType MatrixElement = Element12 * index4_elem.second;
+
+                                    MatrixElement *= Permutation.sign;
+
+                                    addMultiterm(MatrixElement,
+                                                 beta,
+                                                 E1,
+                                                 E2,
+                                                 E3,
+                                                 E4,
+                                                 weight1,
+                                                 weight2,
+                                                 weight3,
+                                                 weight4,
+                                                 NonResonantTermsLocal,
+                                                 ResonantTermsLocal);
+                                }
                             }
+                            ++index2bra_iter;
+                            ++index2ket_iter;
                         }
-                        ++index2bra_iter;
-                        ++index2ket_iter;
                     }
+
+                    if(z && NonResonantTermsLocal.stored_size() + ResonantTermsLocal.stored_size() >= BatchSize)
+                        evaluateBatch(NonResonantTermsLocal, ResonantTermsLocal, *z, DataPerThread[Thread]);
                 }
-            }
         }
 
+        if(z)
+            evaluateBatch(NonResonantTermsLocal, ResonantTermsLocal, *z, DataPerThread[Thread]);
+        else {
+            NonResonantTermsLocal.flush();
+            ResonantTermsLocal.flush();
+        }
+    }
+
+    // Nothing is stored in the streaming mode
+    if(z) {
+        for(auto const& DataLocal : DataPerThread) {
+            for(std::size_t w = 0; w < DataLocal.size(); ++w)
+                (*data)[w] += DataLocal[w];
+        }
+        return;
+    }
+
+    // Merge the thread-local lists
+    for(int Thread = 0; Thread < NThreads; ++Thread) {
+        for(auto const& t : NonResonantTermsPerThread[Thread].as_vector())
+            NonResonantTerms.add_term(t);
+        NonResonantTermsPerThread[Thread].clear();
+        for(auto const& t : ResonantTermsPerThread[Thread].as_vector())
+            ResonantTerms.add_term(t);
+        ResonantTermsPerThread[Thread].clear();
+    }
+
+    NonResonantTerms.flush();
+    ResonantTerms.flush();
+
     INFO("Total " << NonResonantTerms.size() << "+" << ResonantTerms.size() << "="
                   << NonResonantTerms.size() + ResonantTerms.size() << " terms");
 
@@ -284,7 +446,9 @@ inline void TwoParticleGFPart::addMultiterm(ComplexType Coeff,
                                             RealType Wi,
                                             RealType Wj,
                                             RealType Wk,
-                                            RealType Wl) {
+                                            RealType Wl,
+                                            FlatTermList<NonResonantTerm>& NonResonantList,
+                                            FlatTermList<ResonantTerm>& ResonantList) const {
     RealType P1 = Ej - Ei;
     RealType P2 = Ek - Ej;
     RealType P3 = El - Ek;
@@ -292,20 +456,20 @@ inline void TwoParticleGFPart::addMultiterm(ComplexType Coeff,
     // Non-resonant part of the multiterm
     ComplexType CoeffZ2 = -Coeff * (Wj + Wk);
     if(std::abs(CoeffZ2) > CoefficientTolerance)
-        NonResonantTerms.add_term(NonResonantTerm(CoeffZ2, P1, P2, P3, false));
+        NonResonantList.add_term(NonResonantTerm(CoeffZ2, P1, P2, P3, false));
     ComplexType CoeffZ4 = Coeff * (Wi + Wl);
     if(std::abs(CoeffZ4) > CoefficientTolerance)
-        NonResonantTerms.add_term(NonResonantTerm(CoeffZ4, P1, P2, P3, true));
+        NonResonantList.add_term(NonResonantTerm(CoeffZ4, P1, P2, P3, true));
 
     // Resonant part of the multiterm
     ComplexType CoeffZ1Z2Res = Coeff * beta * Wi;
     ComplexType CoeffZ1Z2NonRes = Coeff * (Wk - Wi);
     if(std::abs(CoeffZ1Z2Res) > CoefficientTolerance || abs(CoeffZ1Z2NonRes) > CoefficientTolerance)
-        ResonantTerms.add_term(ResonantTerm(CoeffZ1Z2Res, CoeffZ1Z2NonRes, P1, P2, P3, true));
+        ResonantList.add_term(ResonantTerm(CoeffZ1Z2Res, CoeffZ1Z2NonRes, P1, P2, P3, true));
     ComplexType CoeffZ2Z3Res = -Coeff * beta * Wj;
     ComplexType CoeffZ2Z3NonRes = Coeff * (Wj - Wl);
     if(std::abs(CoeffZ2Z3Res) > CoefficientTolerance || abs(CoeffZ2Z3NonRes) > CoefficientTolerance)
-        ResonantTerms.add_term(ResonantTerm(CoeffZ2Z3Res, CoeffZ2Z3NonRes, P1, P2, P3, false));
+        ResonantList.add_term(ResonantTerm(CoeffZ2Z3Res, CoeffZ2Z3NonRes, P1, P2, P3, false));
 }
 
 ComplexType TwoParticleGFPart::operator()(long MatsubaraNumber1, long MatsubaraNumber2, long MatsubaraNumber3) const {
@@ -318,6 +482,13 @@ ComplexType TwoParticleGFPart::operator()(long MatsubaraNumber1, long MatsubaraN
 }
 
 ComplexType TwoParticleGFPart::operator()(ComplexType z1, ComplexType z2, ComplexType z3) const {
+    // The term lists of a compact part are gone, use the frozen terms instead
+    if(Compact) {
+        std::vector<ComplexType> Value(1, 0);
+        evaluate(FreqVec{FreqTuple(z1, z2, z3)}, Value);
+        return Value[0];
+    }
+
     std::array<ComplexType, 3> Frequencies = {z1, z2, -z3};
 
     z1 = Frequencies[Permutation.perm[0]];
@@ -335,7 +506,63 @@ ComplexType TwoParticleGFPart::operator()(ComplexType z1, ComplexType z2, Comple
 void TwoParticleGFPart::clear() {
     NonResonantTerms.clear();
     ResonantTerms.clear();
+    FrozenNonResonant.clear();
+    FrozenResonant.clear();
+    Frozen = false;
+    Compact = false;
     setStatus(Constructed);
 }
 
+constexpr InnerQuantumState TwoParticleGFPart::ComputeTileSize;
+constexpr double TwoParticleGFPart::MultitermCost;
+
+void TwoParticleGFPart::freeze() {
+    if(getStatus() != Computed)
+        throw StatusMismatch("2PGFPart: Cannot freeze terms of an uncomputed container.");
+    if(Compact)
+        return;
+
+    FrozenNonResonant.assign(NonResonantTerms.as_vector(), SinglePrecisionPoles);
+    FrozenResonant.assign(ResonantTerms.as_vector(), SinglePrecisionPoles);
+    Frozen = true;
+}
+
+void TwoParticleGFPart::compact() {
+    if(Compact)
+        return;
+    if(!Frozen || FrozenNonResonant.hasSinglePrecisionPoles() != SinglePrecisionPoles)
+        freeze();
+
+    NonResonantTerms.clear();
+    ResonantTerms.clear();
+    Compact = true;
+}
+
+RealType TwoParticleGFPart::getPoleError() const {
+    return std::max(FrozenNonResonant.getPoleError(), FrozenResonant.getPoleError());
+}
+
+void TwoParticleGFPart::evaluate(FreqVec const& freqs, std::vector<ComplexType>& data) const {
+    evaluate(FreqArrays(freqs, Permutation), data);
+}
+
+void TwoParticleGFPart::evaluate(FreqArrays const& z, std::vector<ComplexType>& data) const {
+    if(getStatus() != Computed) {
+        throw StatusMismatch(
+            "2PGFPart: Calling evaluate() on uncomputed container. Did you purge all the terms when called compute()?");
+    }
+    assert(data.size() == z.size());
+
+    FrozenNonResonantTerms NonResonantOnTheFly;
+    FrozenResonantTerms ResonantOnTheFly;
+    if(!Frozen) {
+        NonResonantOnTheFly.assign(NonResonantTerms.as_vector());
+        ResonantOnTheFly.assign(ResonantTerms.as_vector());
+    }
+    FrozenNonResonantTerms const& NonResonant = Frozen ? FrozenNonResonant : NonResonantOnTheFly;
+    FrozenResonantTerms const& Resonant = Frozen ? FrozenResonant : ResonantOnTheFly;
+
+    EvaluateFrozenTerms(NonResonant, Resonant, ReduceResonanceTolerance, z, data);
+}
+
 } // namespace Pomerol
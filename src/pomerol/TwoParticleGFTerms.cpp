@@ -0,0 +1,112 @@
+//
+// This file is part of pomerol, an exact diagonalization library aimed at
+// solving condensed matter models of interacting fermions.
+//
+// Copyright (C) 2016-2021 A. Antipov, I. Krivenko and contributors
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// \file src/pomerol/TwoParticleGFTerms.cpp
+/// \brief Terms of a fermionic two-particle Green's function read from a checkpoint file (implementation).
+/// \author Igor Krivenko (igor.s.krivenko@gmail.com)
+
+#include "pomerol/TwoParticleGFTerms.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace Pomerol {
+
+RealType TwoParticleGFTerms::readHeader(BinaryInputArchive& ar) {
+    ar.beginSection("2PGF");
+    return ar.read<RealType>();
+}
+
+TwoParticleGFTerms::TwoParticleGFTerms(BinaryInputArchive& ar) : Thermal(readHeader(ar)) {
+    auto AliasArray = ar.readVector<std::uint64_t>();
+    if(AliasArray.size() % 5 != 0)
+        throw std::runtime_error("TwoParticleGFTerms: Invalid list of index combinations");
+    for(std::size_t n = 0; n < AliasArray.size(); n += 5) {
+        if(AliasArray[n + 4] >= permutations4.size())
+            throw std::runtime_error("TwoParticleGFTerms: Invalid frequency permutation");
+        Aliases.emplace(IndexCombination4(static_cast<ParticleIndex>(AliasArray[n]),
+                                          static_cast<ParticleIndex>(AliasArray[n + 1]),
+                                          static_cast<ParticleIndex>(AliasArray[n + 2]),
+                                          static_cast<ParticleIndex>(AliasArray[n + 3])),
+                        static_cast<std::size_t>(AliasArray[n + 4]));
+    }
+
+    auto NParts = ar.read<std::uint64_t>();
+    parts.resize(NParts);
+    for(auto& part : parts) {
+        part.PermutationNumber = ar.read<std::uint64_t>();
+        if(part.PermutationNumber >= permutations3.size())
+            throw std::runtime_error("TwoParticleGFTerms: Invalid permutation of operators");
+        part.DeltaTolerance = ar.read<RealType>();
+        part.NonResonant.load(ar);
+        part.Resonant.load(ar);
+    }
+}
+
+std::size_t TwoParticleGFTerms::readNumberOfElements(BinaryInputArchive& ar) {
+    ar.beginSection("2PGFLIST");
+    return ar.read<std::uint64_t>();
+}
+
+std::vector<IndexCombination4> TwoParticleGFTerms::getIndices() const {
+    std::vector<IndexCombination4> Indices;
+    Indices.reserve(Aliases.size());
+    for(auto const& Alias : Aliases)
+        Indices.push_back(Alias.first);
+    return Indices;
+}
+
+std::size_t TwoParticleGFTerms::getNumTerms() const {
+    std::size_t NTerms = 0;
+    for(auto const& part : parts)
+        NTerms += part.NonResonant.size() + part.Resonant.size();
+    return NTerms;
+}
+
+std::vector<ComplexType> TwoParticleGFTerms::evaluate(IndexCombination4 const& Indices, FreqVec const& freqs) const {
+    auto Alias = Aliases.find(Indices);
+    if(Alias == Aliases.end())
+        throw std::runtime_error("TwoParticleGFTerms: Requested element is not stored");
+
+    // Frequencies of the stored element
+    Permutation4 const& FrequenciesPermutation = permutations4[Alias->second];
+    FreqVec PermutedFreqs;
+    PermutedFreqs.reserve(freqs.size());
+    for(auto const& f : freqs) {
+        std::array<ComplexType, 4> z = {
+            std::get<0>(f), std::get<1>(f), std::get<2>(f), std::get<0>(f) + std::get<1>(f) - std::get<2>(f)};
+        PermutedFreqs.emplace_back(z[FrequenciesPermutation.perm[0]],
+                                   z[FrequenciesPermutation.perm[1]],
+                                   z[FrequenciesPermutation.perm[2]]);
+    }
+
+    std::vector<ComplexType> out(freqs.size(), 0);
+    // Parts sharing the same permutation of operators also share the permuted frequencies
+    for(std::size_t p = 0; p < permutations3.size(); ++p) {
+        std::unique_ptr<FreqArrays> z;
+        for(auto const& part : parts) {
+            if(part.PermutationNumber != p)
+                continue;
+            if(!z)
+                z.reset(new FreqArrays(PermutedFreqs, permutations3[p]));
+            EvaluateFrozenTerms(part.NonResonant, part.Resonant, part.DeltaTolerance, *z, out);
+        }
+    }
+
+    for(auto& v : out)
+        v *= RealType(FrequenciesPermutation.sign);
+    return out;
+}
+
+} // namespace Pomerol
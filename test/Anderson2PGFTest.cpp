@@ -13,6 +13,7 @@
 /// \author Andrey Antipov (andrey.e.antipov@gmail.com)
 /// \author Igor Krivenko (igor.s.krivenko@gmail.com)
 
+#include <pomerol/BinaryArchive.hpp>
 #include <pomerol/DensityMatrix.hpp>
 #include <pomerol/FieldOperatorContainer.hpp>
 #include <pomerol/Hamiltonian.hpp>
@@ -20,11 +21,17 @@
 #include <pomerol/IndexClassification.hpp>
 #include <pomerol/LatticePresets.hpp>
 #include <pomerol/Misc.hpp>
+#include <pomerol/MonomialOperator.hpp>
+#include <pomerol/MonomialOperatorPart.hpp>
 #include <pomerol/StatesClassification.hpp>
 #include <pomerol/TwoParticleGFContainer.hpp>
+#include <pomerol/TwoParticleGFPart.hpp>
+#include <pomerol/TwoParticleGFTerms.hpp>
 
 #include "catch2/catch-pomerol.hpp"
 
+#include <cstddef>
+#include <cstdio>
 #include <set>
 #include <string>
 #include <tuple>
@@ -124,6 +131,290 @@ TEST_CASE("Two-particle GF of the Anderson model", "[Anderson2PGF]") {
         }
     }
 
+    SECTION("Cost estimates of parts") {
+        // Operators with matrices that can be modified
+        AnnihilationOperator C(IndexInfo, HS, S, H, u0);
+        C.prepare(HS);
+        C.compute();
+        CreationOperator CX(IndexInfo, HS, S, H, u0);
+        CX.prepare(HS);
+        CX.compute();
+
+        // Find a chain of blocks B0 -> B1 -> B2 -> B1 -> B0 connected by c, c, c^+, c^+
+        BlockNumber B0 = 0, B1 = INVALID_BLOCK_NUMBER, B2 = INVALID_BLOCK_NUMBER;
+        for(; B0 < S.getNumberOfBlocks(); ++B0) {
+            B1 = C.getRightIndex(B0);
+            B2 = B1 == INVALID_BLOCK_NUMBER ? INVALID_BLOCK_NUMBER : C.getRightIndex(B1);
+            if(B2 != INVALID_BLOCK_NUMBER)
+                break;
+        }
+        REQUIRE(B2 != INVALID_BLOCK_NUMBER);
+
+        std::vector<MonomialOperatorPart*> Ops = {&C.getPartFromLeftIndex(B0),
+                                                  &C.getPartFromLeftIndex(B1),
+                                                  &CX.getPartFromLeftIndex(B2),
+                                                  &CX.getPartFromLeftIndex(B1)};
+        TwoParticleGFPart part(*Ops[0],
+                               *Ops[1],
+                               *Ops[2],
+                               *Ops[3],
+                               H.getPart(B0),
+                               H.getPart(B1),
+                               H.getPart(B2),
+                               H.getPart(B1),
+                               rho.getPart(B0),
+                               rho.getPart(B1),
+                               rho.getPart(B2),
+                               rho.getPart(B1),
+                               permutations3[0]);
+
+        // Removing the matrix elements of the operators one by one reduces the cost down to zero
+        double Cost = part.estimateCost();
+        REQUIRE(Cost > 0);
+        for(auto* Op : Ops) {
+            REQUIRE(Op->getNumberOfNonZeros() > 0);
+            Op->getRowMajorValue<false>().setZero();
+            Op->releaseConversions();
+            REQUIRE(part.estimateCost() < Cost);
+            Cost = part.estimateCost();
+        }
+        REQUIRE(Cost == 0);
+
+        part.compute();
+        REQUIRE(part.getNumNonResonantTerms() == 0);
+        REQUIRE(part.getNumResonantTerms() == 0);
+    }
+
+    SECTION("TwoParticleGF::evaluate()") {
+        Chi4.computeAll(false, freqs, MPI_COMM_WORLD, true);
+
+        freqs.resize(chi_ref.size());
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            ComplexType w_p = I * (2. * i + 1.) * M_PI / beta;
+            freqs[i] = std::make_tuple(omega + Omega, w_p, omega);
+        }
+
+        TwoParticleGF const& chi_uuuu_gf = Chi4(IndexCombination4(u0, u0, u0, u0));
+        TwoParticleGF const& chi_dddd_gf = Chi4(IndexCombination4(d0, d0, d0, d0));
+
+        // Frozen terms of each part agree with the term lists
+        for(auto const& part : chi_uuuu_gf.getParts()) {
+            REQUIRE(part.isFrozen());
+            std::vector<ComplexType> values(freqs.size(), 0);
+            part.evaluate(freqs, values);
+            for(int i = 0; i < chi_ref.size(); ++i) {
+                INFO("i = " << i);
+                auto const& f = freqs[i];
+                REQUIRE_THAT(values[i], IsCloseTo(part(std::get<0>(f), std::get<1>(f), std::get<2>(f)), 1e-12));
+            }
+        }
+
+        auto chi_uuuu = chi_uuuu_gf.evaluate(freqs);
+        auto chi_dddd = chi_dddd_gf.evaluate(freqs);
+
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            INFO("i = " << i);
+            auto ref = chi_ref[i];
+            REQUIRE_THAT(chi_uuuu[i], IsCloseTo(ref, 1e-6));
+            REQUIRE_THAT(chi_dddd[i], IsCloseTo(ref, 1e-6));
+        }
+    }
+
+    SECTION("TwoParticleGFContainer::evaluate() with distributed terms") {
+        Chi4.DistributedTerms = true;
+        Chi4.computeAll(false, freqs, MPI_COMM_WORLD, true);
+
+        freqs.resize(chi_ref.size());
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            ComplexType w_p = I * (2. * i + 1.) * M_PI / beta;
+            freqs[i] = std::make_tuple(omega + Omega, w_p, omega);
+        }
+
+        auto chi_uuuu = Chi4.evaluate(IndexCombination4(u0, u0, u0, u0), freqs);
+        auto chi_dddd = Chi4.evaluate(IndexCombination4(d0, d0, d0, d0), freqs);
+
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            INFO("i = " << i);
+            auto ref = chi_ref[i];
+            REQUIRE_THAT(chi_uuuu[i], IsCloseTo(ref, 1e-6));
+            REQUIRE_THAT(chi_dddd[i], IsCloseTo(ref, 1e-6));
+        }
+    }
+
+    SECTION("Streaming evaluation") {
+        freqs.resize(chi_ref.size());
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            ComplexType w_p = I * (2. * i + 1.) * M_PI / beta;
+            freqs[i] = std::make_tuple(omega + Omega, w_p, omega);
+        }
+
+        // Terms stored by compute() and evaluated afterwards
+        Chi4.computeAll(false, freqs, MPI_COMM_WORLD, true);
+
+        // Single-term batches, several batches per part and a single batch per part
+        for(std::size_t BatchSize : {std::size_t(1), std::size_t(16), std::size_t(1) << 20}) {
+            INFO("Batch size " << BatchSize);
+
+            TwoParticleGFContainer Chi4_streaming(IndexInfo, S, H, rho, Operators);
+            Chi4_streaming.ReduceResonanceTolerance = reduce_tol;
+            Chi4_streaming.CoefficientTolerance = coeff_tol;
+            Chi4_streaming.MultiTermCoefficientTolerance = 1e-6;
+            Chi4_streaming.StreamingBatchSize = BatchSize;
+            Chi4_streaming.prepareAll(indices4);
+            auto out = Chi4_streaming.computeAll(true, freqs, MPI_COMM_WORLD, true);
+
+            for(auto const& ic : indices4) {
+                INFO("Indices " << ic);
+                auto const& chi = out.at(ic);
+                REQUIRE(chi.size() == freqs.size());
+                auto computed = Chi4.evaluate(ic, freqs);
+                for(int i = 0; i < chi_ref.size(); ++i) {
+                    INFO("i = " << i);
+                    REQUIRE_THAT(chi[i], IsCloseTo(computed[i], 1e-12));
+                    if(ic == IndexCombination4(u0, u0, u0, u0) || ic == IndexCombination4(d0, d0, d0, d0))
+                        REQUIRE_THAT(chi[i], IsCloseTo(chi_ref[i], 1e-6));
+                }
+            }
+        }
+    }
+
+    SECTION("Compact terms") {
+        Chi4.CompactTerms = true;
+        Chi4.SinglePrecisionPoles = true;
+        Chi4.computeAll(false, freqs, MPI_COMM_WORLD, true);
+
+        freqs.resize(chi_ref.size());
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            ComplexType w_p = I * (2. * i + 1.) * M_PI / beta;
+            freqs[i] = std::make_tuple(omega + Omega, w_p, omega);
+        }
+
+        TwoParticleGF const& chi_uuuu_gf = Chi4(IndexCombination4(u0, u0, u0, u0));
+        for(auto const& part : chi_uuuu_gf.getParts()) {
+            REQUIRE(part.isCompact());
+            REQUIRE_THROWS_AS(part.getNonResonantTerms(), ComputableObject::StatusMismatch);
+            REQUIRE_THROWS_AS(part.getResonantTerms(), ComputableObject::StatusMismatch);
+        }
+        REQUIRE(chi_uuuu_gf.getPoleError() < 1e-6);
+
+        auto chi_uuuu = chi_uuuu_gf.evaluate(freqs);
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            INFO("i = " << i);
+            auto ref = chi_ref[i];
+            REQUIRE_THAT(chi_uuuu[i], IsCloseTo(ref, 1e-4));
+            REQUIRE_THAT(chi_uuuu_gf(std::get<0>(freqs[i]), std::get<1>(freqs[i]), std::get<2>(freqs[i])),
+                         IsCloseTo(ref, 1e-4));
+        }
+    }
+
+    SECTION("Stored terms") {
+        Chi4.computeAll(false, freqs, MPI_COMM_WORLD, true);
+
+        freqs.resize(chi_ref.size());
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            ComplexType w_p = I * (2. * i + 1.) * M_PI / beta;
+            freqs[i] = std::make_tuple(omega + Omega, w_p, omega);
+        }
+
+        std::string FileName = TempFileName("Anderson2PGF_terms", MPI_COMM_WORLD);
+        if(pMPI::rank(MPI_COMM_WORLD) == 0) {
+            BinaryOutputArchive ar(FileName);
+            Chi4.saveTerms(ar);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+
+        BinaryInputArchive ar(FileName);
+        std::size_t NElements = TwoParticleGFTerms::readNumberOfElements(ar);
+        std::set<IndexCombination4> StoredIndices;
+        for(std::size_t n = 0; n < NElements; ++n) {
+            TwoParticleGFTerms Terms(ar);
+            REQUIRE(Terms.beta == beta);
+            for(auto const& ic : Terms.getIndices()) {
+                INFO("Indices " << ic);
+                StoredIndices.insert(ic);
+                auto stored = Terms.evaluate(ic, freqs);
+                auto computed = Chi4.evaluate(ic, freqs);
+                for(int i = 0; i < chi_ref.size(); ++i)
+                    REQUIRE_THAT(stored[i], IsCloseTo(computed[i], 1e-12));
+                if(ic == IndexCombination4(u0, u0, u0, u0) || ic == IndexCombination4(d0, d0, d0, d0)) {
+                    for(int i = 0; i < chi_ref.size(); ++i)
+                        REQUIRE_THAT(stored[i], IsCloseTo(chi_ref[i], 1e-6));
+                }
+            }
+        }
+        for(auto const& ic : indices4)
+            REQUIRE(StoredIndices.count(ic) == 1);
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        if(pMPI::rank(MPI_COMM_WORLD) == 0)
+            std::remove(FileName.c_str());
+    }
+
+    SECTION("Index symmetries") {
+        auto Symmetries = FindIndexSymmetries(HExpr, IndexInfo);
+        REQUIRE(Symmetries.size() == 1); // Spin flip
+        REQUIRE(Symmetries[0][u0] == d0);
+        REQUIRE(Symmetries[0][d0] == u0);
+        REQUIRE(IsIndexSymmetry(HExpr, IndexInfo, Symmetries[0]));
+
+        TwoParticleGFContainer Chi4Sym(IndexInfo, S, H, rho, Operators);
+        Chi4Sym.ReduceResonanceTolerance = reduce_tol;
+        Chi4Sym.CoefficientTolerance = coeff_tol;
+        Chi4Sym.MultiTermCoefficientTolerance = 1e-6;
+        Chi4Sym.addSymmetry(Symmetries[0]);
+        Chi4Sym.prepareAll(indices4);
+
+        TwoParticleGF const& chi_uuuu_gf = Chi4Sym(IndexCombination4(u0, u0, u0, u0));
+        TwoParticleGF const& chi_dddd_gf = Chi4Sym(IndexCombination4(d0, d0, d0, d0));
+        REQUIRE(&chi_uuuu_gf == &chi_dddd_gf);
+
+        freqs.resize(chi_ref.size());
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            ComplexType w_p = I * (2. * i + 1.) * M_PI / beta;
+            freqs[i] = std::make_tuple(omega + Omega, w_p, omega);
+        }
+
+        auto computed_data = Chi4Sym.computeAll(true, freqs, MPI_COMM_WORLD, true);
+        auto chi_uuuu = computed_data[IndexCombination4(u0, u0, u0, u0)];
+        auto chi_dddd = computed_data[IndexCombination4(d0, d0, d0, d0)];
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            INFO("i = " << i);
+            auto ref = chi_ref[i];
+            REQUIRE_THAT(chi_uuuu[i], IsCloseTo(ref, 1e-6));
+            REQUIRE_THAT(chi_dddd[i], IsCloseTo(ref, 1e-6));
+        }
+    }
+
+    SECTION("Prefiltering of vanishing elements") {
+        auto NonVanishing = Chi4.findNonVanishing();
+        REQUIRE(NonVanishing.count(IndexCombination4(u0, u0, u0, u0)) == 1);
+        REQUIRE(NonVanishing.count(IndexCombination4(u0, u0, u0, d0)) == 0);
+
+        for(ParticleIndex i : f) {
+            for(ParticleIndex j : f) {
+                for(ParticleIndex k : f) {
+                    for(ParticleIndex l : f) {
+                        IndexCombination4 ic(i, j, k, l);
+                        INFO("Indices " << ic);
+                        TwoParticleGF chi(S,
+                                          H,
+                                          Operators.getAnnihilationOperator(i),
+                                          Operators.getAnnihilationOperator(j),
+                                          Operators.getCreationOperator(k),
+                                          Operators.getCreationOperator(l),
+                                          rho);
+                        chi.prepare();
+                        REQUIRE(NonVanishing.count(ic) == (chi.isVanishing() ? 0 : 1));
+                    }
+                }
+            }
+        }
+
+        TwoParticleGFContainer Chi4Filtered(IndexInfo, S, H, rho, Operators);
+        Chi4Filtered.prepareAll({IndexCombination4(u0, u0, u0, d0)});
+        REQUIRE_FALSE(Chi4Filtered.isInContainer(IndexCombination4(u0, u0, u0, d0)));
+    }
+
     SECTION("Chi4.computeAll() with precomputation for specific frequencies") {
         freqs.resize(chi_ref.size());
         for(int i = 0; i < chi_ref.size(); ++i) {
@@ -145,4 +436,41 @@ TEST_CASE("Two-particle GF of the Anderson model", "[Anderson2PGF]") {
             REQUIRE_THAT(chi_dddd_val, IsCloseTo(ref, 1e-6));
         }
     }
+
+    SECTION("Chi4.computeAll() with distributed output") {
+        freqs.resize(chi_ref.size());
+        for(int i = 0; i < chi_ref.size(); ++i) {
+            ComplexType w_p = I * (2. * i + 1.) * M_PI / beta;
+            freqs[i] = std::make_tuple(omega + Omega, w_p, omega);
+        }
+
+        Chi4.DistributedOutput = true;
+        auto computed_data = Chi4.computeAll(true, freqs, MPI_COMM_WORLD, true);
+        auto chi_uuuu = computed_data[IndexCombination4(u0, u0, u0, u0)];
+        auto chi_dddd = computed_data[IndexCombination4(d0, d0, d0, d0)];
+
+        int comm_rank = pMPI::rank(MPI_COMM_WORLD);
+        int comm_size = pMPI::size(MPI_COMM_WORLD);
+        auto slice = TwoParticleGF::getOutputSlice(freqs.size(), comm_rank, comm_size);
+        REQUIRE(chi_uuuu.size() == slice.second - slice.first);
+        REQUIRE(chi_dddd.size() == slice.second - slice.first);
+        for(std::size_t i = slice.first; i < slice.second; ++i) {
+            INFO("i = " << i);
+            auto ref = chi_ref[i];
+            REQUIRE_THAT(chi_uuuu[i - slice.first], IsCloseTo(ref, 1e-6));
+            REQUIRE_THAT(chi_dddd[i - slice.first], IsCloseTo(ref, 1e-6));
+        }
+
+        // The parts are cleared as soon as they are evaluated
+        std::vector<ComplexType> values(freqs.size());
+        for(auto const& ic : indices4) {
+            INFO("Indices " << ic);
+            TwoParticleGF const& chi = Chi4(ic);
+            for(auto const& part : chi.getParts()) {
+                REQUIRE(part.getNumNonResonantTerms() == 0);
+                REQUIRE(part.getNumResonantTerms() == 0);
+                REQUIRE_THROWS_AS(part.evaluate(freqs, values), ComputableObject::StatusMismatch);
+            }
+        }
+    }
 }
@@ -108,4 +108,31 @@ TEST_CASE("broadcast() methods of various objects", "[broadcast]") {
         REQUIRE(tl.as_set().key_comp().Tolerance == tl_ref.as_set().key_comp().Tolerance);
         REQUIRE(tl.as_set() == tl_ref.as_set());
     }
+
+    SECTION("FlatTermList::broadcast()") {
+        FlatTermList<TwoParticleGFPart::NonResonantTerm> tl(
+            TwoParticleGFPart::NonResonantTerm::Compare(1.0 / 1024),
+            TwoParticleGFPart::NonResonantTerm::IsNegligible(1.0 / 1024));
+        tl.add_term(tnr_ref);
+
+        FlatTermList<TwoParticleGFPart::NonResonantTerm> tl_ref(
+            TwoParticleGFPart::NonResonantTerm::Compare(1.0 / 2048),
+            TwoParticleGFPart::NonResonantTerm::IsNegligible(1.0 / 2048));
+        tl_ref.add_term(TwoParticleGFPart::NonResonantTerm(ComplexType(1.0, 2.0), -0.1, 0.2, 0.4, true));
+        tl_ref.add_term(TwoParticleGFPart::NonResonantTerm(ComplexType(1.0, 8.0), -0.4, 0.2, 0.4, false));
+        tl_ref.add_term(TwoParticleGFPart::NonResonantTerm(ComplexType(7.0, 2.0), -0.6, 0.2, 0.4, true));
+        tl_ref.add_term(TwoParticleGFPart::NonResonantTerm(ComplexType(1.0, 1.0), -0.1, 0.2, 0.4, true));
+        tl_ref.flush();
+
+        if(rank == 0)
+            tl = tl_ref;
+
+        tl.broadcast(MPI_COMM_WORLD, 0);
+
+        REQUIRE(tl.get_is_negligible().Tolerance == tl_ref.get_is_negligible().Tolerance);
+        REQUIRE(tl.get_compare().Tolerance == tl_ref.get_compare().Tolerance);
+        REQUIRE(tl_ref.size() == 3);
+        REQUIRE(tl.as_vector() == tl_ref.as_vector());
+        REQUIRE(tl.check_terms());
+    }
 }
@@ -13,6 +13,7 @@
 /// \author Andrey Antipov (andrey.e.antipov@gmail.com)
 /// \author Igor Krivenko (igor.s.krivenko@gmail.com)
 
+#include <pomerol/BinaryArchive.hpp>
 #include <pomerol/DensityMatrix.hpp>
 #include <pomerol/FieldOperatorContainer.hpp>
 #include <pomerol/GFContainer.hpp>
@@ -26,7 +27,12 @@
 
 #include "catch2/catch-pomerol.hpp"
 
+#include <cstddef>
+#include <cstdio>
 #include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 using namespace Pomerol;
 
@@ -50,6 +56,21 @@ TEST_CASE("Green's function of a Hubbard atom", "[GF1site]") {
         return (w0 + w1) / (I * omega + mu) + (w1 + w2) / (I * omega + mu - U);
     };
 
+    // Reference Green's function at other temperatures and chemical potentials
+    auto G_ref_beta_mu = [U](RealType beta, RealType mu, int n) {
+        RealType omega = M_PI * (2 * n + 1) / beta;
+
+        RealType w0 = 1.0;
+        RealType w1 = exp(beta * mu);
+        RealType w2 = exp(-beta * (-2 * mu + U));
+        RealType Z = w0 + 2 * w1 + w2;
+        w0 /= Z;
+        w1 /= Z;
+        w2 /= Z;
+
+        return (w0 + w1) / (I * omega + mu) + (w1 + w2) / (I * omega + mu - U);
+    };
+
     using namespace LatticePresets;
 
     auto HExpr = CoulombS("A", U, -mu);
@@ -101,6 +122,136 @@ TEST_CASE("Green's function of a Hubbard atom", "[GF1site]") {
         REQUIRE_THAT(result, IsCloseTo(ref, 1e-14));
     }
 
+    SECTION("evaluate()") {
+        std::vector<long> MatsubaraNumbers;
+        for(long n = -100; n < 100; ++n)
+            MatsubaraNumbers.push_back(n);
+        auto result = GF.evaluate(MatsubaraNumbers);
+        REQUIRE(result.size() == MatsubaraNumbers.size());
+        for(std::size_t i = 0; i < MatsubaraNumbers.size(); ++i)
+            REQUIRE_THAT(result[i], IsCloseTo(G_ref(MatsubaraNumbers[i]), 1e-14));
+    }
+
+    SECTION("Multiple temperatures") {
+        std::vector<RealType> betas = {1.0, beta, 50.0};
+        auto rhos = ComputeDensityMatrices(S, H, betas);
+        REQUIRE(rhos.size() == betas.size());
+
+        GreensFunction GF_products(S,
+                                   H,
+                                   Operators.getAnnihilationOperator(down_index),
+                                   Operators.getCreationOperator(down_index),
+                                   rho);
+        GF_products.KeepMatrixElementProducts = true;
+        GF_products.prepare();
+        GF_products.compute();
+
+        for(std::size_t b = 0; b < betas.size(); ++b) {
+            INFO("beta = " << betas[b]);
+            REQUIRE(rhos[b].beta == betas[b]);
+            DensityMatrix rho_ref(S, H, betas[b]);
+            rho_ref.prepare();
+            rho_ref.compute();
+            for(QuantumState i = 0; i < S.getNumberOfStates(); ++i)
+                REQUIRE_THAT(rhos[b].getWeight(i), IsCloseTo(rho_ref.getWeight(i), 1e-14));
+
+            // Reuse matrix elements computed by GF_products
+            GreensFunction GF_b(GF_products, rhos[b]);
+            GF_b.prepare();
+            GF_b.compute();
+            for(int n = -100; n < 100; ++n)
+                REQUIRE_THAT(GF_b(n), IsCloseTo(G_ref_beta_mu(betas[b], mu, n), 1e-14));
+        }
+    }
+
+    SECTION("Chemical potential scan") {
+        // Values of the particle number operator within the blocks
+        auto N = ComputeBlockValues(Level("A", 1.0), HS, S);
+        REQUIRE(N.size() == static_cast<std::size_t>(S.getNumberOfBlocks()));
+        auto SpinFlip = Operators::c_dag(std::string("A"), (unsigned short)0, up) *
+                        Operators::c(std::string("A"), (unsigned short)0, down);
+        REQUIRE_THROWS_AS(ComputeBlockValues(SpinFlip, HS, S), std::runtime_error);
+
+        // Matrix elements do not depend on the chemical potential
+        GreensFunction GF_products(S,
+                                   H,
+                                   Operators.getAnnihilationOperator(down_index),
+                                   Operators.getCreationOperator(down_index),
+                                   rho);
+        GF_products.KeepMatrixElementProducts = true;
+        GF_products.prepare();
+        GF_products.compute();
+
+        for(RealType mu_scan : {-0.2, 0.1, 0.9}) {
+            INFO("mu = " << mu_scan);
+            std::vector<RealType> Shifts(N.size());
+            for(std::size_t b = 0; b < N.size(); ++b)
+                Shifts[b] = -(mu_scan - mu) * N[b];
+            H.setBlockShifts(Shifts);
+
+            DensityMatrix rho_mu(S, H, beta);
+            rho_mu.prepare();
+            rho_mu.compute();
+
+            GreensFunction GF_mu(GF_products, rho_mu);
+            GF_mu.prepare();
+            GF_mu.compute();
+            for(int n = -100; n < 100; ++n)
+                REQUIRE_THAT(GF_mu(n), IsCloseTo(G_ref_beta_mu(beta, mu_scan, n), 1e-14));
+        }
+    }
+
+    SECTION("Checkpoint") {
+        std::string FileName = TempFileName("GF1site_checkpoint", MPI_COMM_WORLD);
+        if(pMPI::rank(MPI_COMM_WORLD) == 0) {
+            BinaryOutputArchive ar(FileName);
+            S.save(ar);
+            H.save(ar);
+            Operators.saveAll(ar);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+
+        BinaryInputArchive ar(FileName);
+        StatesClassification S_loaded;
+        S_loaded.load(ar);
+        REQUIRE(S_loaded.getNumberOfBlocks() == S.getNumberOfBlocks());
+        for(BlockNumber b = 0; b < S.getNumberOfBlocks(); ++b)
+            REQUIRE(S_loaded.getFockStates(b) == S.getFockStates(b));
+
+        Hamiltonian H_loaded(S_loaded);
+        H_loaded.load(ar);
+        REQUIRE(H_loaded.getGroundEnergy() == H.getGroundEnergy());
+        for(BlockNumber b = 0; b < S.getNumberOfBlocks(); ++b) {
+            auto const& Part = H.getPart(b);
+            auto const& PartLoaded = H_loaded.getPart(b);
+            REQUIRE(PartLoaded.getEigenValues() == Part.getEigenValues());
+            REQUIRE(PartLoaded.getMatrix<false>() == Part.getMatrix<false>());
+        }
+
+        FieldOperatorContainer Operators_loaded(IndexInfo, HS, S_loaded, H_loaded);
+        Operators_loaded.prepareAll(HS);
+        Operators_loaded.loadAll(ar);
+        REQUIRE_THROWS_AS(ar.beginSection("FIELDOPS"), std::runtime_error);
+
+        DensityMatrix rho_loaded(S_loaded, H_loaded, beta);
+        rho_loaded.prepare();
+        rho_loaded.compute();
+
+        GreensFunction GF_loaded(S_loaded,
+                                 H_loaded,
+                                 Operators_loaded.getAnnihilationOperator(down_index),
+                                 Operators_loaded.getCreationOperator(down_index),
+                                 rho_loaded);
+        GF_loaded.prepare();
+        GF_loaded.compute();
+        for(int n = -100; n < 100; ++n)
+            REQUIRE_THAT(GF_loaded(n), IsCloseTo(G_ref(n), 1e-14));
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        if(pMPI::rank(MPI_COMM_WORLD) == 0)
+            std::remove(FileName.c_str());
+    }
+
     SECTION("GFContainer") {
         GFContainer G(IndexInfo, S, H, rho, Operators);
 
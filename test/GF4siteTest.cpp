@@ -22,6 +22,7 @@
 #include <pomerol/LatticePresets.hpp>
 #include <pomerol/Misc.hpp>
 #include <pomerol/StatesClassification.hpp>
+#include <pomerol/TwoParticleGF.hpp>
 
 #include "catch2/catch-pomerol.hpp"
 
@@ -105,4 +106,39 @@ TEST_CASE("Green's function of a Hubbard plaquette", "[GF4site]") {
         // some contributions to the GF.
         REQUIRE_THAT(result, IsCloseTo(ref, 1e-6));
     }
+
+    // Blocks of the plaquette span several tiles of TwoParticleGFPart::compute().
+    // Terms accumulated by multiple threads must not depend on the number of threads.
+    rho.truncateBlocks(1e-5, false);
+
+    auto const& C = Operators.getAnnihilationOperator(A_down_index);
+    auto const& CX = Operators.getCreationOperator(A_down_index);
+
+    auto compute_chi = [&](int NThreads) {
+#ifdef POMEROL_USE_OPENMP
+        int MaxThreads = omp_get_max_threads();
+        omp_set_num_threads(NThreads);
+#else
+        (void)NThreads;
+#endif
+        TwoParticleGF Chi(S, H, C, C, CX, CX, rho);
+        Chi.prepare();
+        Chi.compute(false, {}, MPI_COMM_SELF);
+#ifdef POMEROL_USE_OPENMP
+        omp_set_num_threads(MaxThreads);
+#endif
+        std::vector<ComplexType> values;
+        for(long n1 = -2; n1 < 2; ++n1)
+            for(long n2 = -2; n2 < 2; ++n2)
+                for(long n3 = -2; n3 < 2; ++n3)
+                    values.push_back(Chi(n1, n2, n3));
+        return values;
+    };
+
+    int NThreads = 4;
+    auto chi_serial = compute_chi(1);
+    auto chi_threaded = compute_chi(NThreads);
+    REQUIRE(compute_chi(NThreads) == chi_threaded);
+    for(std::size_t i = 0; i < chi_serial.size(); ++i)
+        REQUIRE_THAT(chi_threaded[i], IsCloseTo(chi_serial[i], 1e-12));
 }
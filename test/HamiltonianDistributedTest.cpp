@@ -0,0 +1,189 @@
+//
+// This file is part of pomerol, an exact diagonalization library aimed at
+// solving condensed matter models of interacting fermions.
+//
+// Copyright (C) 2016-2021 A. Antipov, I. Krivenko and contributors
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// \file test/HamiltonianDistributedTest.cpp
+/// \brief Test the distributed storage mode and the fused preparation/diagonalization of Hamiltonian,
+///        and the parallel computation of monomial operators.
+/// \author Igor Krivenko (igor.s.krivenko@gmail.com)
+
+#include <pomerol/FieldOperatorContainer.hpp>
+#include <pomerol/Hamiltonian.hpp>
+#include <pomerol/HamiltonianPart.hpp>
+#include <pomerol/HilbertSpace.hpp>
+#include <pomerol/IndexClassification.hpp>
+#include <pomerol/LatticePresets.hpp>
+#include <pomerol/Misc.hpp>
+#include <pomerol/MonomialOperator.hpp>
+#include <pomerol/StatesClassification.hpp>
+
+#include <mpi_dispatcher/misc.hpp>
+
+#include "catch2/catch-pomerol.hpp"
+
+using namespace Pomerol;
+
+TEST_CASE("Distributed storage of eigenvectors", "[hamiltonian]") {
+    using namespace LatticePresets;
+
+    auto HExpr = CoulombS("A", 1.0, -0.5);
+    HExpr += CoulombS("B", 2.0, -1.1);
+    HExpr += CoulombS("C", 3.0, -0.7);
+    HExpr += CoulombS("D", 4.0, -1.1);
+
+    HExpr += Hopping("A", "B", -1.3);
+    HExpr += Hopping("B", "C", -0.45);
+    HExpr += Hopping("C", "D", -0.127);
+    HExpr += Hopping("A", "D", -0.255);
+
+    auto IndexInfo = MakeIndexClassification(HExpr);
+    auto HS = MakeHilbertSpace(IndexInfo, HExpr);
+    HS.compute();
+    StatesClassification S;
+    S.compute(HS);
+
+    Hamiltonian HRef(S);
+    HRef.prepare(HExpr, HS, MPI_COMM_WORLD);
+    HRef.compute(MPI_COMM_WORLD);
+
+    Hamiltonian H(S);
+    H.DistributedStorage = true;
+    H.prepare(HExpr, HS, MPI_COMM_WORLD);
+    H.compute(MPI_COMM_WORLD);
+
+    SECTION("Eigenvalues and eigenvectors") {
+        REQUIRE_THAT(H.getGroundEnergy(), IsCloseTo(HRef.getGroundEnergy(), 1e-12));
+
+        long NumLocal = 0;
+        for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+            auto const& part = H.getPart(Block);
+            auto const& part_ref = HRef.getPart(Block);
+            if(part.isLocal())
+                ++NumLocal;
+
+            auto const& ev = part.getEigenValues();
+            auto const& ev_ref = part_ref.getEigenValues();
+            REQUIRE(ev.size() == ev_ref.size());
+            REQUIRE((ev - ev_ref).norm() < 1e-12);
+
+            auto U = part.fetchMatrix<false>();
+            auto const& U_ref = part_ref.getMatrix<false>();
+            REQUIRE(U->rows() == U_ref.rows());
+            REQUIRE(U->cols() == U_ref.cols());
+            REQUIRE((*U - U_ref).norm() < 1e-12);
+        }
+
+        // Every block is stored by exactly one process
+        MPI_Allreduce(MPI_IN_PLACE, &NumLocal, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+        REQUIRE(NumLocal == static_cast<long>(S.getNumberOfBlocks()));
+    }
+
+    SECTION("Fused preparation and diagonalization") {
+        for(bool Distributed : {false, true}) {
+            Hamiltonian HF(S);
+            HF.DistributedStorage = Distributed;
+            HF.prepareAndCompute(HExpr, HS, MPI_COMM_WORLD);
+
+            REQUIRE_THAT(HF.getGroundEnergy(), IsCloseTo(HRef.getGroundEnergy(), 1e-12));
+            for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+                auto const& part = HF.getPart(Block);
+                auto const& part_ref = HRef.getPart(Block);
+                REQUIRE((part.getEigenValues() - part_ref.getEigenValues()).norm() < 1e-12);
+                REQUIRE((*part.fetchMatrix<false>() - part_ref.getMatrix<false>()).norm() < 1e-12);
+            }
+        }
+    }
+
+    SECTION("Monomial operators") {
+        ParticleIndex Index = IndexInfo.getIndex("B", 0, up);
+
+        CreationOperator CX(IndexInfo, HS, S, H, Index);
+        CX.prepare(HS);
+        CX.compute();
+
+        CreationOperator CX_ref(IndexInfo, HS, S, HRef, Index);
+        CX_ref.prepare(HS);
+        CX_ref.compute();
+
+        for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+            if(CX_ref.getLeftIndex(Block) == INVALID_BLOCK_NUMBER)
+                continue;
+            auto const& M = CX.getPartFromRightIndex(Block).getRowMajorValue<false>();
+            auto const& M_ref = CX_ref.getPartFromRightIndex(Block).getRowMajorValue<false>();
+            auto diff = (M - M_ref).eval();
+            diff.prune(1e-12);
+            REQUIRE(diff.nonZeros() == 0);
+        }
+    }
+
+    SECTION("Monomial operators computed by threads") {
+        ParticleIndex Index = IndexInfo.getIndex("B", 0, up);
+
+        CreationOperator CX_ref(IndexInfo, HS, S, HRef, Index);
+        CX_ref.prepare(HS);
+        CX_ref.compute();
+
+        // Each process computes all parts on its own using OpenMP threads
+#ifdef POMEROL_USE_OPENMP
+        int MaxThreads = omp_get_max_threads();
+        omp_set_num_threads(4);
+#endif
+        CreationOperator CX(IndexInfo, HS, S, HRef, Index);
+        CX.prepare(HS);
+        CX.compute(MPI_COMM_SELF);
+#ifdef POMEROL_USE_OPENMP
+        omp_set_num_threads(MaxThreads);
+#endif
+
+        for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+            if(CX_ref.getLeftIndex(Block) == INVALID_BLOCK_NUMBER)
+                continue;
+            auto const& M = CX.getPartFromRightIndex(Block).getRowMajorValue<false>();
+            auto const& M_ref = CX_ref.getPartFromRightIndex(Block).getRowMajorValue<false>();
+            auto diff = (M - M_ref).eval();
+            diff.prune(1e-12);
+            REQUIRE(diff.nonZeros() == 0);
+        }
+    }
+
+    SECTION("Field operator container") {
+        FieldOperatorContainer Operators(IndexInfo, HS, S, HRef);
+        Operators.prepareAll(HS);
+        Operators.computeAll(MPI_COMM_WORLD);
+
+        for(ParticleIndex Index = 0; Index < IndexInfo.getIndexSize(); ++Index) {
+            // Converted matrices are made again on request
+            Operators.releaseConversions();
+
+            CreationOperator CX_ref(IndexInfo, HS, S, HRef, Index);
+            CX_ref.prepare(HS);
+            CX_ref.compute(MPI_COMM_SELF);
+
+            auto const& CX = Operators.getCreationOperator(Index);
+            auto const& C = Operators.getAnnihilationOperator(Index);
+            REQUIRE(CX.getStatus() == ComputableObject::Computed);
+            REQUIRE(C.getStatus() == ComputableObject::Computed);
+
+            for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+                BlockNumber LeftBlock = CX_ref.getLeftIndex(Block);
+                if(LeftBlock == INVALID_BLOCK_NUMBER)
+                    continue;
+                auto const& M_ref = CX_ref.getPartFromRightIndex(Block).getRowMajorValue<false>();
+
+                auto diff = (CX.getPartFromRightIndex(Block).getRowMajorValue<false>() - M_ref).eval();
+                diff.prune(1e-12);
+                REQUIRE(diff.nonZeros() == 0);
+
+                auto diff_adj = (C.getPartFromLeftIndex(Block).getColMajorValue<false>() - M_ref.adjoint()).eval();
+                diff_adj.prune(1e-12);
+                REQUIRE(diff_adj.nonZeros() == 0);
+            }
+        }
+    }
+}
@@ -105,3 +105,176 @@ TEST_CASE("Simple Hamiltonian test", "[hamiltonian]") {
         REQUIRE(diff2.nonZeros() == 0);
     }
 }
+
+TEST_CASE("Iterative eigensolver", "[hamiltonian]") {
+    using namespace LatticePresets;
+
+    auto HExpr = CoulombS("A", 1.0, -0.5);
+    HExpr += CoulombS("B", 2.0, -1.1);
+    HExpr += CoulombS("C", 3.0, -0.7);
+    HExpr += CoulombS("D", 4.0, -1.1);
+
+    HExpr += Hopping("A", "B", -1.3);
+    HExpr += Hopping("B", "C", -0.45);
+    HExpr += Hopping("C", "D", -0.127);
+    HExpr += Hopping("A", "D", -0.255);
+
+    auto IndexInfo = MakeIndexClassification(HExpr);
+    auto HS = MakeHilbertSpace(IndexInfo, HExpr);
+    HS.compute();
+    StatesClassification S;
+    S.compute(HS);
+
+    Hamiltonian HDense(S);
+    HDense.prepare(HExpr, HS, MPI_COMM_WORLD);
+
+    RealType EnergyWindow = 3.0;
+
+    Hamiltonian H(S);
+    H.Lanczos.MinBlockSize = 16;
+    H.Lanczos.EnergyWindow = EnergyWindow;
+    H.Lanczos.BlockSize = 2;
+    H.Lanczos.SubspaceSize = 8;
+    H.prepare(HExpr, HS, MPI_COMM_WORLD);
+
+    // Sparse assembly
+    for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+        auto const& part = H.getPart(Block);
+        REQUIRE(part.isSparse() == (S.getBlockSize(Block) >= H.Lanczos.MinBlockSize));
+        if(part.isSparse()) {
+            MatrixType<false> HMatrix(part.getSparseMatrix<false>());
+            REQUIRE((HMatrix - HDense.getPart(Block).getMatrix<false>()).norm() < 1e-14);
+        }
+    }
+
+    HDense.compute(MPI_COMM_WORLD);
+    H.compute(MPI_COMM_WORLD);
+
+    REQUIRE_THAT(H.getGroundEnergy(), IsCloseTo(HDense.getGroundEnergy(), 1e-10));
+
+    RealType Cutoff = HDense.getGroundEnergy() + EnergyWindow;
+    for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+        auto const& ev_ref = HDense.getEigenValues(Block);
+        auto const& ev = H.getEigenValues(Block);
+        auto const& U = H.getPart(Block).getMatrix<false>();
+
+        InnerQuantumState BlockSize = S.getBlockSize(Block);
+        Eigen::Index NumRetained = ev_ref.size();
+        if(BlockSize >= H.Lanczos.MinBlockSize)
+            NumRetained = (ev_ref.array() <= Cutoff).count();
+
+        REQUIRE(ev.size() == NumRetained);
+        REQUIRE(U.rows() == static_cast<Eigen::Index>(BlockSize));
+        REQUIRE(U.cols() == NumRetained);
+        for(Eigen::Index n = 0; n < NumRetained; ++n)
+            REQUIRE_THAT(ev(n), IsCloseTo(ev_ref(n), 1e-10));
+
+        // Eigenvectors must be orthonormal
+        MatrixType<false> Overlap = U.transpose() * U;
+        REQUIRE((Overlap - MatrixType<false>::Identity(NumRetained, NumRetained)).norm() < 1e-10);
+    }
+}
+
+TEST_CASE("Blocks diagonalized by multiple threads", "[hamiltonian]") {
+    using namespace LatticePresets;
+
+    auto HExpr = CoulombS("A", 1.0, -0.5);
+    HExpr += CoulombS("B", 2.0, -1.1);
+    HExpr += CoulombS("C", 3.0, -0.7);
+    HExpr += CoulombS("D", 4.0, -1.1);
+
+    HExpr += Hopping("A", "B", -1.3);
+    HExpr += Hopping("B", "C", -0.45);
+    HExpr += Hopping("C", "D", -0.127);
+    HExpr += Hopping("A", "D", -0.255);
+
+    auto IndexInfo = MakeIndexClassification(HExpr);
+    auto HS = MakeHilbertSpace(IndexInfo, HExpr);
+    HS.compute();
+    StatesClassification S;
+    S.compute(HS);
+
+    // A single process diagonalizes all blocks using OpenMP threads
+    auto compute_H = [&](Hamiltonian& H, int NThreads) {
+#ifdef POMEROL_USE_OPENMP
+        int MaxThreads = omp_get_max_threads();
+        omp_set_num_threads(NThreads);
+#else
+        (void)NThreads;
+#endif
+        H.prepare(HExpr, HS, MPI_COMM_SELF);
+        H.compute(MPI_COMM_SELF);
+#ifdef POMEROL_USE_OPENMP
+        omp_set_num_threads(MaxThreads);
+#endif
+    };
+
+    Hamiltonian HSerial(S);
+    compute_H(HSerial, 1);
+    Hamiltonian HThreaded(S);
+    compute_H(HThreaded, 4);
+
+    REQUIRE_THAT(HThreaded.getGroundEnergy(), IsCloseTo(HSerial.getGroundEnergy(), 1e-12));
+    for(BlockNumber Block = 0; Block < S.getNumberOfBlocks(); ++Block) {
+        auto const& ev_ref = HSerial.getEigenValues(Block);
+        auto const& ev = HThreaded.getEigenValues(Block);
+        REQUIRE((ev - ev_ref).norm() < 1e-12);
+
+        // Eigenvectors are compared via the spectral decomposition to be insensitive to their phases
+        auto const& U_ref = HSerial.getPart(Block).getMatrix<false>();
+        auto const& U = HThreaded.getPart(Block).getMatrix<false>();
+        MatrixType<false> H_ref = U_ref * ev_ref.asDiagonal() * U_ref.transpose();
+        MatrixType<false> H = U * ev.asDiagonal() * U.transpose();
+        REQUIRE((H - H_ref).norm() < 1e-12);
+    }
+}
+
+TEST_CASE("Tiled rotation of monomial operator parts", "[hamiltonian]") {
+    using namespace LatticePresets;
+
+    auto HExpr = CoulombS("A", 1.0, -0.5);
+    HExpr += CoulombS("B", 2.0, -1.1);
+    HExpr += CoulombS("C", 3.0, -0.7);
+    HExpr += CoulombS("D", 4.0, -1.1);
+
+    HExpr += Hopping("A", "B", -1.3);
+    HExpr += Hopping("B", "C", -0.45);
+    HExpr += Hopping("C", "D", -0.127);
+    HExpr += Hopping("A", "D", -0.255);
+
+    auto IndexInfo = MakeIndexClassification(HExpr);
+    auto HS = MakeHilbertSpace(IndexInfo, HExpr);
+    HS.compute();
+    StatesClassification S;
+    S.compute(HS);
+
+    Hamiltonian H(S);
+    H.prepare(HExpr, HS, MPI_COMM_SELF);
+    H.compute(MPI_COMM_SELF);
+
+    // Parts rotated in one tile are the reference
+    CreationOperator op(IndexInfo, HS, S, H, IndexInfo.getIndex("A", 0, down));
+    op.prepare(HS);
+    op.compute(MPI_COMM_SELF);
+
+    using LOperatorT = LOperatorType<RealType>;
+    auto cdag_op = LOperatorT(Operators::c_dag("A", (unsigned short)0, down), HS.getFullHilbertSpace());
+
+    // Tiles of a single row, and tiles of 7 rows that do not divide the block sizes evenly
+    for(Eigen::Index TileRows : {1, 7}) {
+        for(auto const& Conn : op.getBlockMapping().left) {
+            auto const& ref = op.getPartFromLeftIndex(Conn.first).getRowMajorValue<false>();
+
+            auto const& HFrom = H.getPart(Conn.second);
+            MonomialOperatorPart part(cdag_op, S, HFrom, H.getPart(Conn.first));
+            part.compute(TileRows * HFrom.getSize());
+            auto const& result = part.getRowMajorValue<false>();
+
+            INFO("Block " << Conn.second << " -> " << Conn.first << ", " << TileRows << " rows per tile");
+            REQUIRE(result.rows() == ref.rows());
+            REQUIRE(result.cols() == ref.cols());
+            REQUIRE(result.nonZeros() == ref.nonZeros());
+            REQUIRE((RowMajorMatrixType<false>(result - ref)).norm() < 1e-14);
+        }
+    }
+}
@@ -23,6 +23,7 @@
 #include <memory>
 #include <random>
 #include <thread>
+#include <vector>
 
 using namespace pMPI;
 
@@ -100,4 +101,28 @@ TEST_CASE("Test mpi_dispatcher", "[mpi_dispatcher]") {
         MPI_Allreduce(MPI_IN_PLACE, &dumb_task.counter, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
         REQUIRE(dumb_task.counter == ntasks);
     }
+
+    SECTION("With MPIJobCounter") {
+        std::uniform_real_distribution<double> dist(0, 0.01);
+
+        dumb_task_type dumb_task;
+        int ntasks = 45;
+        std::vector<JobId> task_numbers(ntasks);
+        for(int n = 0; n < ntasks; ++n)
+            task_numbers[n] = ntasks - 1 - n;
+
+        MPIJobCounter counter(MPI_COMM_WORLD, task_numbers, root);
+        std::vector<JobId> done;
+        for(JobId job; counter.claim(job);) {
+            dumb_task(dist(gen), job, comm_rank);
+            done.push_back(job);
+        }
+        auto const& dispatch_map = counter.gather_dispatch_map();
+
+        MPI_Allreduce(MPI_IN_PLACE, &dumb_task.counter, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        REQUIRE(dumb_task.counter == ntasks);
+        REQUIRE(dispatch_map.size() == ntasks);
+        for(JobId job : done)
+            REQUIRE(dispatch_map.at(job) == comm_rank);
+    }
 }
@@ -26,6 +26,9 @@
 #include "catch2/catch-pomerol.hpp"
 
 #include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
 
 using namespace Pomerol;
 
@@ -142,4 +145,61 @@ TEST_CASE("Susceptibilities of a single Hubbard atom", "[Susceptibility]") {
         for(int n = 0; n < n_iw; ++n)
             REQUIRE_THAT(Chi(n), IsCloseTo(ref(n), 1e-14));
     }
+
+    SECTION("evaluate()") {
+        std::vector<long> MatsubaraNumbers;
+        std::vector<ComplexType> z;
+        for(long n = -n_iw; n < n_iw; ++n) {
+            MatsubaraNumbers.push_back(n);
+            z.push_back(0.1 * RealType(n) + 0.05 * I);
+        }
+
+        for(auto ops : {std::make_pair(&s_plus, &s_minus), std::make_pair(&n_up, &n_dn)}) {
+            Susceptibility Chi(S, H, *ops.first, *ops.second, rho);
+            Chi.prepare();
+            Chi.compute();
+            Chi.subtractDisconnected();
+
+            auto result = Chi.evaluate(MatsubaraNumbers);
+            REQUIRE(result.size() == MatsubaraNumbers.size());
+            for(std::size_t i = 0; i < MatsubaraNumbers.size(); ++i) {
+                INFO("n = " << MatsubaraNumbers[i]);
+                REQUIRE_THAT(result[i], IsCloseTo(Chi(MatsubaraNumbers[i]), 1e-14));
+            }
+
+            result = Chi.evaluate(z);
+            REQUIRE(result.size() == z.size());
+            for(std::size_t i = 0; i < z.size(); ++i) {
+                INFO("z = " << z[i]);
+                REQUIRE_THAT(result[i], IsCloseTo(Chi(z[i]), 1e-14));
+            }
+        }
+    }
+
+    SECTION("Multiple temperatures") {
+        std::vector<RealType> betas = {1.0, beta, 50.0};
+        auto rhos = ComputeDensityMatrices(S, H, betas);
+
+        for(auto ops : {std::make_pair(&s_plus, &s_minus), std::make_pair(&n_up, &n_up)}) {
+            Susceptibility Chi(S, H, *ops.first, *ops.second, rho);
+            Chi.KeepMatrixElementProducts = true;
+            Chi.prepare();
+            Chi.compute();
+
+            for(std::size_t b = 0; b < betas.size(); ++b) {
+                INFO("beta = " << betas[b]);
+                // Reuse matrix elements computed by Chi
+                Susceptibility Chi_b(Chi, rhos[b]);
+                Chi_b.prepare();
+                Chi_b.compute();
+
+                Susceptibility Chi_ref(S, H, *ops.first, *ops.second, rhos[b]);
+                Chi_ref.prepare();
+                Chi_ref.compute();
+
+                for(int n = 0; n < n_iw; ++n)
+                    REQUIRE_THAT(Chi_b(n), IsCloseTo(Chi_ref(n), 1e-14));
+            }
+        }
+    }
 }
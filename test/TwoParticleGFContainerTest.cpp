@@ -0,0 +1,190 @@
+//
+// This file is part of pomerol, an exact diagonalization library aimed at
+// solving condensed matter models of interacting fermions.
+//
+// Copyright (C) 2016-2021 A. Antipov, I. Krivenko and contributors
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+/// \file test/TwoParticleGFContainerTest.cpp
+/// \brief Splitting of the MPI communicator among elements of TwoParticleGFContainer.
+/// \author Igor Krivenko (igor.s.krivenko@gmail.com)
+
+#include <pomerol/DensityMatrix.hpp>
+#include <pomerol/FieldOperatorContainer.hpp>
+#include <pomerol/Hamiltonian.hpp>
+#include <pomerol/HilbertSpace.hpp>
+#include <pomerol/IndexClassification.hpp>
+#include <pomerol/LatticePresets.hpp>
+#include <pomerol/Misc.hpp>
+#include <pomerol/StatesClassification.hpp>
+#include <pomerol/TwoParticleGFContainer.hpp>
+
+#include <mpi_dispatcher/misc.hpp>
+
+#include "catch2/catch-pomerol.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Pomerol;
+
+TEST_CASE("Splitting of the communicator by TwoParticleGFContainer", "[2PGFContainer]") {
+    RealType U = 0.5;
+    RealType mu = 0.25;
+    std::vector<RealType> levels = {1.02036910873357, -1.02036910873357};
+    std::vector<RealType> hoppings = {0.296439333614347, 0.296439333614347};
+    RealType beta = 26;
+
+    using namespace LatticePresets;
+
+    auto HExpr = CoulombS("C", U, -mu);
+    for(std::size_t i = 0; i < levels.size(); ++i) {
+        auto bath_name = "b" + std::to_string(i);
+        HExpr += Level(bath_name, levels[i]);
+        HExpr += Hopping("C", bath_name, hoppings[i]);
+    }
+
+    auto IndexInfo = MakeIndexClassification(HExpr);
+    auto HS = MakeHilbertSpace(IndexInfo, HExpr);
+    HS.compute();
+    StatesClassification S;
+    S.compute(HS);
+
+    Hamiltonian H(S);
+    H.prepare(HExpr, HS, MPI_COMM_WORLD);
+    H.compute(MPI_COMM_WORLD);
+
+    DensityMatrix rho(S, H, beta);
+    rho.prepare();
+    rho.compute();
+
+    ParticleIndex d0 = IndexInfo.getIndex("C", 0, down);
+    ParticleIndex u0 = IndexInfo.getIndex("C", 0, up);
+
+    std::set<ParticleIndex> f = {u0, d0};
+    FieldOperatorContainer Operators(IndexInfo, HS, S, H, f);
+    Operators.prepareAll(HS);
+    Operators.computeAll();
+
+    FreqVec freqs;
+    for(long n1 = -1; n1 < 1; ++n1) {
+        for(long n2 = -1; n2 < 1; ++n2) {
+            ComplexType z1 = I * M_PI * (2. * n1 + 1.) / beta;
+            ComplexType z2 = I * M_PI * (2. * n2 + 1.) / beta;
+            freqs.emplace_back(z1, z2, z1);
+        }
+    }
+
+    // Compute all non-vanishing elements in a new container
+    auto compute_chi = [&](std::set<IndexCombination4> const& Indices, bool Balanced, MPI_Comm comm, bool split) {
+        TwoParticleGFContainer Chi4(IndexInfo, S, H, rho, Operators);
+        Chi4.ReduceResonanceTolerance = 1e-5;
+        Chi4.CoefficientTolerance = 1e-8;
+        Chi4.MultiTermCoefficientTolerance = 1e-6;
+        Chi4.BalancedSplit = Balanced;
+        Chi4.prepareAll(Indices);
+        return Chi4.computeAll(true, freqs, comm, split);
+    };
+
+    auto chi_ref = compute_chi({}, true, MPI_COMM_WORLD, false);
+    REQUIRE(chi_ref.size() > 2);
+
+    auto check = [&chi_ref](std::map<IndexCombination4, std::vector<ComplexType>> const& chi) {
+        REQUIRE(!chi.empty());
+        for(auto const& el : chi) {
+            INFO("Element " << el.first);
+            auto const& values_ref = chi_ref.at(el.first);
+            REQUIRE(el.second.size() == values_ref.size());
+            for(std::size_t n = 0; n < values_ref.size(); ++n)
+                REQUIRE_THAT(el.second[n], IsCloseTo(values_ref[n], 1e-10));
+        }
+    };
+
+    SECTION("Balanced split") { check(compute_chi({}, true, MPI_COMM_WORLD, true)); }
+
+    SECTION("Equal split") { check(compute_chi({}, false, MPI_COMM_WORLD, true)); }
+
+    SECTION("Components claimed dynamically") {
+        // A single process computes the most expensive component first and claims all the others
+        check(compute_chi({}, true, MPI_COMM_SELF, true));
+    }
+
+    SECTION("Placement of groups") {
+        int comm_size = pMPI::size(MPI_COMM_WORLD);
+
+        std::vector<double> Weights = {3.0, 1.0};
+        auto Counts = Detail::proportional_counts(Weights, comm_size);
+        REQUIRE(Counts.size() == Weights.size());
+        REQUIRE(std::accumulate(Counts.begin(), Counts.end(), 0) == comm_size);
+        REQUIRE(Counts[0] >= Counts[1]);
+        REQUIRE(Counts[1] >= 1);
+
+        // Groups of equal size if all weights vanish
+        auto EqualCounts = Detail::proportional_counts({0, 0}, comm_size);
+        REQUIRE(std::abs(EqualCounts[0] - EqualCounts[1]) <= 1);
+
+        // One process per group if there are as many groups as processes
+        auto SingleCounts = Detail::proportional_counts(std::vector<double>(comm_size, 1.0), comm_size);
+        REQUIRE(SingleCounts == std::vector<int>(comm_size, 1));
+        std::vector<double> SkewedWeights(comm_size, 1.0);
+        SkewedWeights[0] = 1e6;
+        REQUIRE(Detail::proportional_counts(SkewedWeights, comm_size) == std::vector<int>(comm_size, 1));
+
+        // Not enough processes to give each group one
+        REQUIRE_THROWS_AS(Detail::proportional_counts(std::vector<double>(comm_size + 1, 1.0), comm_size),
+                          std::runtime_error);
+
+        auto Groups = Detail::place_groups(Counts, MPI_COMM_WORLD);
+        REQUIRE(Groups.size() == static_cast<std::size_t>(comm_size));
+        for(int g = 0; g < static_cast<int>(Counts.size()); ++g)
+            REQUIRE(std::count(Groups.begin(), Groups.end(), g) == Counts[g]);
+
+        // All processes agree on the placement
+        std::vector<int> RootGroups = Groups;
+        MPI_Bcast(RootGroups.data(), comm_size, MPI_INT, 0, MPI_COMM_WORLD);
+        REQUIRE(Groups == RootGroups);
+    }
+
+    SECTION("Terms kept by the computing processes") {
+        TwoParticleGFContainer Chi4(IndexInfo, S, H, rho, Operators);
+        Chi4.ReduceResonanceTolerance = 1e-5;
+        Chi4.CoefficientTolerance = 1e-8;
+        Chi4.MultiTermCoefficientTolerance = 1e-6;
+        Chi4.DistributedTerms = true;
+        Chi4.prepareAll();
+        Chi4.computeAll(false, {}, MPI_COMM_WORLD, true);
+
+        for(auto const& el : chi_ref) {
+            INFO("Element " << el.first);
+            auto values = Chi4.evaluate(el.first, freqs);
+            for(std::size_t n = 0; n < freqs.size(); ++n)
+                REQUIRE_THAT(values[n], IsCloseTo(el.second[n], 1e-10));
+
+            // Local evaluation is possible only where the terms are kept
+            TwoParticleGF const& chi = Chi4(el.first);
+            if(chi.getStatus() >= TwoParticleGF::Computed) {
+                auto local_values = chi.evaluate(freqs);
+                for(std::size_t n = 0; n < freqs.size(); ++n)
+                    REQUIRE_THAT(local_values[n], IsCloseTo(el.second[n], 1e-10));
+            } else {
+                REQUIRE_THROWS_AS(chi.evaluate(freqs), TwoParticleGF::StatusMismatch);
+                REQUIRE_THROWS_AS(chi(0, 0, 0), TwoParticleGF::StatusMismatch);
+            }
+        }
+    }
+
+    SECTION("Empty container") {
+        // Spin is conserved, so that this element vanishes identically and is not prepared
+        auto chi = compute_chi({IndexCombination4(u0, u0, u0, d0)}, true, MPI_COMM_WORLD, true);
+        REQUIRE(chi.empty());
+    }
+}
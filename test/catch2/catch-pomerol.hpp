@@ -23,10 +23,17 @@
 
 #include "catch.hpp"
 
+#include <mpi.h>
+#include <unistd.h>
+
 #include <cmath>
 #include <complex>
+#include <cstdlib>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 #include <utility>
+#include <vector>
 
 /// Catch2 matcher class that checks proximity of two complex numbers
 class IsCloseToMatcher : public Catch::MatcherBase<std::complex<double>> {
@@ -52,4 +59,31 @@ inline IsCloseToMatcher IsCloseTo(std::complex<double> const& ref, double tol =
     return IsCloseToMatcher(ref, tol);
 }
 
+/// Create a uniquely named empty file in the temporary directory and return its name.
+/// The file is created by rank 0 of the communicator, and its name is broadcast to all other ranks.
+/// \param[in] Prefix Prefix of the file name.
+/// \param[in] comm MPI communicator shared by the processes that will access the file.
+inline std::string TempFileName(std::string const& Prefix, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    std::vector<char> Name;
+    if(rank == 0) {
+        char const* TmpDir = std::getenv("TMPDIR");
+        std::string Template = std::string(TmpDir && *TmpDir ? TmpDir : "/tmp") + "/" + Prefix + "_XXXXXX";
+        Name.assign(Template.begin(), Template.end());
+        Name.push_back('\0');
+        int fd = mkstemp(Name.data());
+        if(fd == -1)
+            throw std::runtime_error("Could not create a temporary file " + Template);
+        close(fd);
+    }
+
+    int Size = static_cast<int>(Name.size());
+    MPI_Bcast(&Size, 1, MPI_INT, 0, comm);
+    Name.resize(Size);
+    MPI_Bcast(Name.data(), Size, MPI_CHAR, 0, comm);
+    return std::string(Name.data());
+}
+
 #endif // #ifndef POMEROL_TEST_CATCH2_CATCH_POMEROL_HPP